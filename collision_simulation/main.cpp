@@ -1,59 +1,39 @@
 #include <iostream>
+#include <set>
 #include <string>
 #include <memory>
+#include "asset_cache.h"
 #include "renderer.h"
+#include "scene.h"
 #include "collision_object.h"
 #include "simulation.h"
+#include "simulation_thread.h"
 
-int main(int argc, char* argv[]) {
-    int resolution = 32; // Lower resolution for faster computation
-    
-    if (argc > 1) {
-        resolution = std::atoi(argv[1]);
-        if (resolution <= 0) {
-            std::cerr << "Invalid resolution: " << argv[1] << std::endl;
-            return 1;
-        }
-    }
-    
-    std::cout << "Mesh Collision Simulation" << std::endl;
-    std::cout << "Resolution: " << resolution << "x" << resolution << "x" << resolution << std::endl;
-
-    // Initialize renderer
-    Renderer renderer(800, 600);
-    if (!renderer.initialize()) {
-        std::cerr << "Failed to initialize renderer" << std::endl;
-        return 1;
-    }
-    
+// The built-in scene: two dynamic bunnies on a collision course and a flattened static one
+static bool setupDefaultScene(Simulation& simulation, AssetCache& assets, int resolution) {
     // First, create collision objects to analyze their sizes
     // Create first collision object
-    auto obj1 = std::make_unique<CollisionObject>();
-    if (!obj1->loadFromOBJ("../../data/bunny.obj", resolution)) {
+    auto obj1 = assets.instantiate(CollisionObject::makeAssetKey("../../data/bunny.obj", resolution));
+    if (!obj1) {
         std::cerr << "Failed to load first collision object" << std::endl;
-        return 1;
+        return false;
     }
     
-    // Create second collision object  
+    // Create second and third collision objects sharing the first one's mesh, SDF and LODs
     auto obj2 = std::make_unique<CollisionObject>();
-    if (!obj2->loadFromOBJ("../../data/bunny.obj", resolution)) {
-        std::cerr << "Failed to load second collision object" << std::endl;
-        return 1;
-    }
+    obj2->shareGeometry(*obj1);
     
-    // Create third collision object (static)
     auto obj3 = std::make_unique<CollisionObject>();
-    if (!obj3->loadFromOBJ("../../data/bunny.obj", resolution)) {
-        std::cerr << "Failed to load third collision object" << std::endl;
-        return 1;
-    }
-      // Calculate object sizes and determine simulation bounds
+    obj3->shareGeometry(*obj1);
+    
+    // Calculate object sizes and determine simulation bounds
     glm::vec3 objSize = obj1->getMesh().getMax() - obj1->getMesh().getMin();
     float maxDimension = glm::max(glm::max(objSize.x, objSize.y), objSize.z);
     
     std::cout << "Object size: (" << objSize.x << ", " << objSize.y << ", " << objSize.z << ")" << std::endl;
     std::cout << "Max dimension: " << maxDimension << std::endl;
-      // Set simulation bounds based on object size
+    
+    // Set simulation bounds based on object size
     // Make the simulation area smaller - only 5x larger than the largest object
     float simSize = maxDimension * 2.5f;
     glm::vec3 boundsMin(-simSize, -simSize * 0.6f, -simSize);
@@ -62,9 +42,12 @@ int main(int argc, char* argv[]) {
     std::cout << "Simulation bounds: Min(" << boundsMin.x << ", " << boundsMin.y << ", " << boundsMin.z << ")" << std::endl;
     std::cout << "                   Max(" << boundsMax.x << ", " << boundsMax.y << ", " << boundsMax.z << ")" << std::endl;
     
-    // Initialize simulation with calculated bounds
-    Simulation simulation(boundsMin, boundsMax);
-    // We don't need particles for this demo, so skip particle initialization    // Configure objects - simpler setup with only 2 dynamic objects for testing
+    // Apply the calculated bounds
+    simulation.setBounds(boundsMin, boundsMax);
+    
+    // We don't need particles for this demo, so skip particle initialization
+    
+    // Configure objects - simpler setup with only 2 dynamic objects for testing
     float spacing = maxDimension * 1.5f; // Closer spacing for guaranteed collision
     
     obj1->setMass(10.0f);
@@ -90,42 +73,108 @@ int main(int argc, char* argv[]) {
     std::cout << "Starting mesh collision simulation..." << std::endl;
     std::cout << "Objects: 2 dynamic (masses " << objects[0]->getMass() << ", " << objects[1]->getMass() << "), 1 static platform" << std::endl;
     std::cout << "Spacing: " << spacing << ", Max dimension: " << maxDimension << std::endl;
+    return true;
+}
+
+// Prints the surface LODs of each asset once, however many objects share it
+static void printSurfaceLods(const Simulation& simulation) {
+    std::set<std::string> printed;
+    for (const auto& obj : simulation.getCollisionObjects()) {
+        if (!obj || !printed.insert(obj->getAssetKey()).second) {
+            continue;
+        }
+        for (int level = 0; level < obj->getSurfaceLodCount(); ++level) {
+            const SurfaceExtractionStats& stats = obj->getSurfaceLodStats(level);
+            std::cout << "Surface LOD " << level << " of " << obj->getAssetKey() << ": " << stats.triangles
+                      << " triangles, " << stats.vertices << " vertices (" << stats.gridPoints << "^3 grid, "
+                      << stats.timeMs << " ms)" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int resolution = 32; // Lower resolution for faster computation
+    std::string scenePath;
+    
+    // Usage: collision_simulation [resolution] [--scene file]
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--scene" && i + 1 < argc) {
+            scenePath = argv[++i];
+        } else {
+            resolution = std::atoi(argv[i]);
+            if (resolution <= 0) {
+                std::cerr << "Invalid resolution: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+    }
+    
+    std::cout << "Mesh Collision Simulation" << std::endl;
+    std::cout << "Resolution: " << resolution << "x" << resolution << "x" << resolution << std::endl;
+
+    // Initialize renderer
+    Renderer renderer(800, 600);
+    if (!renderer.initialize()) {
+        std::cerr << "Failed to initialize renderer" << std::endl;
+        return 1;
+    }
+    
+    AssetCache assets;
+    Simulation simulation(glm::vec3(-1.0f), glm::vec3(1.0f));
+    float stepRate = 60.0f;
+    bool adaptive = true;
+    if (!scenePath.empty()) {
+        SceneDescription scene;
+        SceneLoadStats sceneStats;
+        if (!loadScene(scenePath, simulation, assets, scene, &sceneStats)) {
+            std::cerr << "Failed to load scene " << scenePath << std::endl;
+            return 1;
+        }
+        std::cout << "Scene " << scenePath << ": " << sceneStats.objects << " objects sharing " << sceneStats.assets
+                  << " assets (bake " << sceneStats.bakeMs << " ms, instantiate " << sceneStats.instantiateMs << " ms)" << std::endl;
+        if (scene.stepRate > 0.0f) {
+            stepRate = scene.stepRate;
+        }
+        adaptive = scene.adaptive;
+    } else if (!setupDefaultScene(simulation, assets, resolution)) {
+        return 1;
+    }
+    printSurfaceLods(simulation);
     
-    // Timing for simulation updates
-    auto lastTime = glfwGetTime();
+    // Subdivide steps only while objects move fast relative to their SDF cells,
+    // instead of running every step at a fixed 8 ms
+    simulation.setAdaptiveSubstepping(adaptive);
+    
+    // Run the simulation on its own thread; the loop below only renders published snapshots
+    SimulationThread simulationThread(simulation);
+    simulationThread.setStepRate(stepRate);
+    simulationThread.start();
+    
+    // Render state interpolated between the last two simulation steps
+    SimulationSnapshot interpolated;
     
     // Main rendering loop
-    while (!renderer.shouldClose()) {        // Calculate delta time
-        auto currentTime = glfwGetTime();
-        float deltaTime = static_cast<float>(currentTime - lastTime);
-        lastTime = currentTime;
-        
-        // Limit delta time to prevent large jumps and ensure smooth physics
-        deltaTime = glm::min(deltaTime, 0.008f);  // Cap at ~120 FPS for smoother collisions
-        
+    while (!renderer.shouldClose()) {
         // Handle ESC key
         if (glfwGetKey(renderer.getWindow(), GLFW_KEY_ESCAPE) == GLFW_PRESS) {
             glfwSetWindowShouldClose(renderer.getWindow(), true);
         }
         
-        // Update simulation with smaller time steps for stability
-        simulation.update(deltaTime);
+        const SimulationSnapshot& snapshot = simulationThread.acquireSnapshot();
+        interpolateSnapshot(snapshot, SimulationThread::computeInterpolationAlpha(snapshot), interpolated);
         
         renderer.beginFrame();
         
-        // Draw wireframe box (simulation bounds)
-        renderer.drawWireframeBox(simulation.getBoundsMin(), simulation.getBoundsMax());
-          // Draw all collision objects
-        const auto& collisionObjects = simulation.getCollisionObjects();
-        for (const auto& obj : collisionObjects) {
-            if (obj && obj->isValid()) {
-                renderer.drawMesh(obj->getMesh(), obj->getTransformMatrix());
-            }
-        }
+        // Draw simulation bounds and all collision objects, batched by shared mesh
+        renderer.drawSnapshot(interpolated);
         
         renderer.endFrame();
     }
     
+    simulationThread.stop();
+    std::cout << "Dropped simulation steps: " << simulationThread.getDroppedSteps() << std::endl;
+    
     std::cout << "Simulation complete." << std::endl;
     
     return 0;
@@ -1,35 +1,23 @@
+#include <algorithm>
 #include <iostream>
+#include <set>
 #include <string>
+#include "asset_cache.h"
+#include "checkpoint.h"
 #include "renderer.h"
+#include "scene.h"
 #include "simulation.h"
+#include "simulation_thread.h"
 
-int main(int argc, char* argv[]) {
-    int resolution = 64; // default
-    
-    if (argc > 1) {
-        resolution = std::atoi(argv[1]);
-        if (resolution <= 0) {
-            std::cerr << "Invalid resolution: " << argv[1] << std::endl;
-            return 1;
-        }
-    }
-    
-    std::cout << "SDF Collision Simulation" << std::endl;
-    std::cout << "Resolution: " << resolution << "x" << resolution << "x" << resolution << std::endl;
-
-    // Initialize renderer FIRST to setup OpenGL context
-    Renderer renderer(800, 600);
-    if (!renderer.initialize()) {
-        std::cerr << "Failed to initialize renderer" << std::endl;
-        return 1;
-    }
-    
-    // Create collision object AFTER renderer initialization
-    auto collisionObject = std::make_unique<CollisionObject>();
-    if (!collisionObject->loadFromOBJ("../../data/bunny.obj", resolution)) {
+// The built-in scene: one dynamic bunny centered in a box with particles around it
+static bool setupDefaultScene(Simulation& simulation, AssetCache& assets, int resolution, int numParticles) {
+    // Geometry comes from the asset cache, so a restored checkpoint finds the bunny already baked
+    auto collisionObject = assets.instantiate(CollisionObject::makeAssetKey("../../data/bunny.obj", resolution));
+    if (!collisionObject) {
         std::cerr << "Failed to load collision object" << std::endl;
-        return 1;
-    }    std::cout << "Collision object loaded. Calculating bounds from SDF..." << std::endl;
+        return false;
+    }
+    std::cout << "Collision object loaded. Calculating bounds from SDF..." << std::endl;
     std::cout << "Is collisionObject valid before move? " << (collisionObject && collisionObject->isValid() ? "Yes" : "No") << std::endl;
     
     // Calculate simulation bounds based on SDF size FIRST
@@ -55,13 +43,14 @@ int main(int argc, char* argv[]) {
     std::cout << "Collision object initial position: (" << center.x << ", " << center.y << ", " << center.z << ")" << std::endl;
     std::cout << "Collision object is static: " << (collisionObject->isStatic() ? "Yes" : "No") << std::endl;
     std::cout << "Collision object velocity: (" << collisionObject->getVelocity().x << ", " 
-              << collisionObject->getVelocity().y << ", " << collisionObject->getVelocity().z << ")" << std::endl;    std::cout << "Mass-based collision response: " << (collisionObject->isStatic() ? "Simple reflection" : "Momentum conservation") << std::endl;
+              << collisionObject->getVelocity().y << ", " << collisionObject->getVelocity().z << ")" << std::endl;
+    std::cout << "Mass-based collision response: " << (collisionObject->isStatic() ? "Simple reflection" : "Momentum conservation") << std::endl;
     
     std::cout << "Simulation bounds: (" << boxMin.x << "," << boxMin.y << "," << boxMin.z 
               << ") to (" << boxMax.x << "," << boxMax.y << "," << boxMax.z << ")" << std::endl;
     
-    // Create simulation with calculated bounds
-    Simulation simulation(boxMin, boxMax);
+    // Apply the calculated bounds
+    simulation.setBounds(boxMin, boxMax);
     
     // Add the collision object to the simulation
     simulation.addCollisionObject(std::move(collisionObject));
@@ -78,43 +67,294 @@ int main(int argc, char* argv[]) {
     std::cout << "Starting simulation..." << std::endl;
     
     // Initialize particles
-    simulation.initialize(100, particleSpeed, particleSize);  // 100 particles
+    simulation.initialize(numParticles, particleSpeed, particleSize);
+    return true;
+}
+
+// Prints the surface LODs of each asset once, however many objects share it
+static void printSurfaceLods(const Simulation& simulation) {
+    std::set<std::string> printed;
+    for (const auto& obj : simulation.getCollisionObjects()) {
+        if (!obj || !printed.insert(obj->getAssetKey()).second) {
+            continue;
+        }
+        for (int level = 0; level < obj->getSurfaceLodCount(); ++level) {
+            const SurfaceExtractionStats& stats = obj->getSurfaceLodStats(level);
+            std::cout << "Surface LOD " << level << " of " << obj->getAssetKey() << ": " << stats.triangles
+                      << " triangles, " << stats.vertices << " vertices (" << stats.gridPoints << "^3 grid, "
+                      << stats.timeMs << " ms)" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int resolution = 64; // default
+    int numParticles = 100;
+    bool instancing = true;
+    float stepRate = 120.0f;
+    bool adaptive = false;
+    bool offscreen = false;
+    bool showSdf = false;
+    std::string captureDirectory;
+    int maxFrames = 0;  // 0 = run until the window is closed
+    std::string trajectoryPath;
+    float recordPrecision = 0.0f;  // 0 = raw floats
+    std::string checkpointPath;
+    double checkpointInterval = 0.0;  // Seconds between checkpoints; 0 = only at exit
+    std::string restorePath;
+    std::string bakeDirectory;
+    std::string scenePath;
+    
+    // Usage: particle_simulation [resolution] [numParticles] [--no-instancing] [--step-rate hz] [--adaptive]
+    //                            [--offscreen] [--capture directory] [--frames count] [--show-sdf]
+    //                            [--record file] [--record-precision step]
+    //                            [--checkpoint file] [--checkpoint-interval seconds] [--restore file] [--bake-cache directory]
+    //                            [--scene file]
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--no-instancing") {
+            instancing = false;
+        } else if (arg == "--adaptive") {
+            adaptive = true;
+        } else if (arg == "--show-sdf") {
+            showSdf = true;
+        } else if (arg == "--offscreen") {
+            offscreen = true;
+        } else if (arg == "--capture" && i + 1 < argc) {
+            captureDirectory = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            trajectoryPath = argv[++i];
+        } else if (arg == "--record-precision" && i + 1 < argc) {
+            recordPrecision = static_cast<float>(std::atof(argv[++i]));
+            if (recordPrecision < 0.0f) {
+                std::cerr << "Invalid record precision: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpointPath = argv[++i];
+        } else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+            checkpointInterval = std::atof(argv[++i]);
+            if (checkpointInterval <= 0.0) {
+                std::cerr << "Invalid checkpoint interval: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--restore" && i + 1 < argc) {
+            restorePath = argv[++i];
+        } else if (arg == "--scene" && i + 1 < argc) {
+            scenePath = argv[++i];
+        } else if (arg == "--bake-cache" && i + 1 < argc) {
+            bakeDirectory = argv[++i];
+        } else if (arg == "--frames" && i + 1 < argc) {
+            maxFrames = std::atoi(argv[++i]);
+            if (maxFrames <= 0) {
+                std::cerr << "Invalid frame count: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--step-rate" && i + 1 < argc) {
+            stepRate = static_cast<float>(std::atof(argv[++i]));
+            if (stepRate <= 0.0f) {
+                std::cerr << "Invalid step rate: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (positional == 0) {
+            resolution = std::atoi(argv[i]);
+            if (resolution <= 0) {
+                std::cerr << "Invalid resolution: " << argv[i] << std::endl;
+                return 1;
+            }
+            positional++;
+        } else if (positional == 1) {
+            numParticles = std::atoi(argv[i]);
+            if (numParticles <= 0) {
+                std::cerr << "Invalid particle count: " << argv[i] << std::endl;
+                return 1;
+            }
+            positional++;
+        }
+    }
+    
+    // Nothing can close a hidden window, so headless runs need a frame budget
+    if (offscreen && maxFrames == 0) {
+        maxFrames = 300;
+    }
+    
+    std::cout << "SDF Collision Simulation" << std::endl;
+    std::cout << "Resolution: " << resolution << "x" << resolution << "x" << resolution << std::endl;
+    std::cout << "Particles: " << numParticles << (instancing ? " (instanced)" : " (one draw call per particle)") << std::endl;
+
+    // Initialize renderer FIRST to setup OpenGL context
+    Renderer renderer(800, 600);
+    renderer.setOffscreen(offscreen);
+    if (!renderer.initialize()) {
+        std::cerr << "Failed to initialize renderer" << std::endl;
+        return 1;
+    }
+    renderer.setParticleInstancing(instancing);
+    renderer.setShowSdfSurface(showSdf);
+    if (!captureDirectory.empty() && !renderer.startCapture(captureDirectory)) {
+        return 1;
+    }
+    
+    // Create collision objects AFTER renderer initialization
+    AssetCache assets;
+    assets.setBakeDirectory(bakeDirectory);
+    Simulation simulation(glm::vec3(-1.0f), glm::vec3(1.0f));
+    if (!scenePath.empty()) {
+        SceneDescription scene;
+        SceneLoadStats sceneStats;
+        if (!loadScene(scenePath, simulation, assets, scene, &sceneStats)) {
+            std::cerr << "Failed to load scene " << scenePath << std::endl;
+            return 1;
+        }
+        std::cout << "Scene " << scenePath << ": " << sceneStats.objects << " objects sharing " << sceneStats.assets
+                  << " assets, " << sceneStats.particles << " particles (parse " << sceneStats.parseMs << " ms, bake "
+                  << sceneStats.bakeMs << " ms, instantiate " << sceneStats.instantiateMs << " ms)" << std::endl;
+        if (scene.stepRate > 0.0f) {
+            stepRate = scene.stepRate;
+        }
+        adaptive = adaptive || scene.adaptive;
+    } else if (!setupDefaultScene(simulation, assets, resolution, numParticles)) {
+        return 1;
+    }
+    simulation.setAdaptiveSubstepping(adaptive);
+    
+    // Resume from a checkpoint instead of the freshly initialized state
+    if (!restorePath.empty()) {
+        auto restoreStart = glfwGetTime();
+        if (!loadCheckpoint(restorePath, simulation, assets)) {
+            std::cerr << "Failed to restore " << restorePath << std::endl;
+            return 1;
+        }
+        std::cout << "Restored " << restorePath << " at step " << simulation.getStepCount() << " ("
+                  << simulation.getParticles().size() << " particles, " << simulation.getCollisionObjectCount()
+                  << " objects) in " << (glfwGetTime() - restoreStart) * 1000.0 << " ms" << std::endl;
+    }
+    printSurfaceLods(simulation);
 
-    // Timing for simulation updates
-    auto lastTime = glfwGetTime();
+    // Run the simulation on its own thread; the loop below only renders published snapshots
+    SimulationThread simulationThread(simulation);
+    simulationThread.setStepRate(stepRate);
+    
+    // Stream every published step to disk from a background writer
+    TrajectoryRecorder recorder;
+    if (!trajectoryPath.empty()) {
+        TrajectoryOptions recordOptions;
+        recordOptions.positionPrecision = recordPrecision;
+        if (!recorder.open(trajectoryPath, simulation.getBoundsMin(), recordOptions)) {
+            return 1;
+        }
+        simulationThread.setTrajectoryRecorder(&recorder);
+    }
+    CheckpointWriter checkpointWriter;
+    if (!checkpointPath.empty()) {
+        simulationThread.setCheckpointWriter(&checkpointWriter, checkpointPath);
+    }
+    simulationThread.start();
+    
+    // Render state interpolated between the last two simulation steps
+    SimulationSnapshot interpolated;
+    
+    auto lastStatsTime = glfwGetTime();
+    auto lastCheckpointTime = lastStatsTime;
+    int framesSinceStats = 0;
+    int frameCount = 0;
     
     // Main rendering loop
-    while (!renderer.shouldClose()) {
-        // Calculate delta time
+    while (!renderer.shouldClose() && (maxFrames == 0 || frameCount < maxFrames)) {
         auto currentTime = glfwGetTime();
-        float deltaTime = static_cast<float>(currentTime - lastTime);
-        lastTime = currentTime;
         
         // Handle ESC key
         if (glfwGetKey(renderer.getWindow(), GLFW_KEY_ESCAPE) == GLFW_PRESS) {
             glfwSetWindowShouldClose(renderer.getWindow(), true);
         }
         
-        // Update simulation (particles + collisions)
-        simulation.update(deltaTime);
+        if (!checkpointPath.empty() && checkpointInterval > 0.0 && currentTime - lastCheckpointTime >= checkpointInterval) {
+            simulationThread.requestCheckpoint();
+            lastCheckpointTime = currentTime;
+        }
+        
+        const SimulationSnapshot& snapshot = simulationThread.acquireSnapshot();
+        interpolateSnapshot(snapshot, SimulationThread::computeInterpolationAlpha(snapshot), interpolated);
         
         renderer.beginFrame();
         
-        // Draw wireframe box (get bounds from simulation)
-        renderer.drawWireframeBox(simulation.getBoundsMin(), simulation.getBoundsMax());
+        // Draw bounds, collision objects (batched by shared mesh) and particles
+        renderer.drawSnapshot(interpolated);
         
-        // Draw all collision objects
-        const auto& collisionObjects = simulation.getCollisionObjects();
-        for (const auto& obj : collisionObjects) {
-            if (obj && obj->isValid()) {
-                renderer.drawMesh(obj->getMesh(), obj->getPosition());
+        // Report render statistics once per second
+        const RenderStats& stats = renderer.getStats();
+        framesSinceStats++;
+        if (currentTime - lastStatsTime >= 1.0) {
+            double fps = framesSinceStats / (currentTime - lastStatsTime);
+            std::cout << "FPS: " << fps
+                      << ", particles: " << snapshot.particles.size() << " (" << snapshot.sleepingParticles << " asleep)"
+                      << ", simulation steps/s: " << simulationThread.getMeasuredStepRate()
+                      << " (target " << simulationThread.getStepRate()
+                      << ", dropped " << simulationThread.getDroppedSteps() << ")"
+                      << ", substeps: avg " << snapshot.substeps.averageParticleSubsteps
+                      << " max " << snapshot.substeps.maxParticleSubsteps
+                      << " (" << snapshot.substeps.particlesSubstepped << " particles)"
+                      << ", contacts: " << snapshot.contacts.particleContacts << " particle ("
+                      << snapshot.contacts.dynamicParticleContacts << " dynamic), "
+                      << snapshot.contacts.objectContacts << " object ("
+                      << snapshot.contacts.warmStartedContacts << " warm-started)"
+                      << ", draw calls: " << stats.drawCalls
+                      << ", instances: " << stats.instancesDrawn
+                      << ", mesh triangles: " << stats.meshTrianglesDrawn
+                      << ", instance upload: " << stats.instanceBytesUploaded << " bytes/frame ("
+                      << stats.instanceBytesUploaded * fps / (1024.0 * 1024.0) << " MB/s)"
+                      << ", upload wait: " << stats.uploadWaitTimeMs << " ms"
+                      << ", culled: " << stats.particlesCulled << " particles / " << stats.objectsCulled << " objects"
+                      << ", LODs: " << stats.particlesPerLod[0] << "/" << stats.particlesPerLod[1]
+                      << "/" << stats.particlesPerLod[2] << "/" << stats.particlesPerLod[3];
+            if (renderer.isCapturing()) {
+                FrameCaptureStats captureStats = renderer.getCaptureStats();
+                std::cout << ", captured: " << captureStats.framesWritten << " written / "
+                          << captureStats.framesDropped << " dropped";
             }
+            if (recorder.isOpen()) {
+                TrajectoryStats recordStats = recorder.getStats();
+                std::cout << ", recorded: " << recordStats.framesRecorded << " frames / "
+                          << recordStats.framesDropped << " dropped, " << recordStats.lastFrameBytes << " bytes/frame";
+            }
+            std::cout << std::endl;
+            lastStatsTime = currentTime;
+            framesSinceStats = 0;
         }
         
-        // Draw particles
-        renderer.drawParticles(simulation.getParticles());
-        
         renderer.endFrame();
+        frameCount++;
+    }
+    
+    simulationThread.stop();
+    
+    // Final checkpoint of the stopped simulation
+    if (!checkpointPath.empty()) {
+        checkpointWriter.wait();
+        if (checkpointWriter.save(simulation, checkpointPath) && checkpointWriter.wait()) {
+            const CheckpointStats& checkpointStats = checkpointWriter.getStats();
+            std::cout << "Checkpoint written to " << checkpointPath << " at step " << simulation.getStepCount()
+                      << ": " << checkpointStats.bytes << " bytes, copy " << checkpointStats.captureMs
+                      << " ms, write " << checkpointStats.writeMs << " ms" << std::endl;
+        }
+    }
+    
+    if (recorder.isOpen()) {
+        recorder.close();
+        TrajectoryStats recordStats = recorder.getStats();
+        std::cout << "Recorded " << recordStats.framesRecorded << " frames to " << trajectoryPath
+                  << " (" << recordStats.framesDropped << " dropped): " << recordStats.bytesWritten << " bytes, "
+                  << recordStats.bytesWritten / std::max<uint64_t>(recordStats.framesRecorded, 1) << " bytes/frame, "
+                  << (recordStats.rawBytes > 0 ? 100.0 * recordStats.bytesWritten / recordStats.rawBytes : 100.0)
+                  << "% of raw size" << std::endl;
+    }
+    
+    if (renderer.isCapturing()) {
+        renderer.stopCapture();
+        FrameCaptureStats captureStats = renderer.getCaptureStats();
+        std::cout << "Captured " << captureStats.framesWritten << " frames to " << captureDirectory
+                  << " (" << captureStats.framesDropped << " dropped)" << std::endl;
     }
     
     std::cout << "Simulation complete." << std::endl;
@@ -0,0 +1,753 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "asset_cache.h"
+#include "mesh_generator.h"
+#include "parallel.h"
+#include "scene.h"
+#include "simulation.h"
+#include "spatial_sort.h"
+
+// Microbenchmarks for the SDF, BVH and collision kernels. Results are CSV (or JSON) on
+// stdout; a CSV from an earlier run can be passed as a baseline to flag regressions.
+
+struct BenchmarkResult {
+    std::string name;
+    size_t items;          // Work items (queries, triangles, voxels, particles) per repetition
+    int repetitions;
+    double medianMs;
+    double minMs;
+    double nsPerItem;      // From the median repetition
+    // Filled in when comparing against a baseline
+    bool hasBaseline = false;
+    double baselineNsPerItem = 0.0;
+    std::string status;
+};
+
+struct BenchmarkOptions {
+    std::string filter;
+    double minTimeMs = 200.0;
+    int minRepetitions = 3;
+};
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Keeps the library's progress output (mesh loading, SDF generation) out of the results on stdout
+class QuietScope {
+public:
+    QuietScope() : original(std::cout.rdbuf(nullptr)) {}
+    ~QuietScope() { std::cout.rdbuf(original); }
+
+private:
+    std::streambuf* original;
+};
+
+class BenchmarkRunner {
+public:
+    BenchmarkRunner(const BenchmarkOptions& options) : options(options) {}
+    
+    bool isSelected(const std::string& name) const {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+    
+    // Lets a group skip its setup when none of its benchmarks will run
+    bool isAnySelected(const std::vector<std::string>& names) const {
+        return std::any_of(names.begin(), names.end(), [this](const std::string& name) { return isSelected(name); });
+    }
+    
+    // Runs 'body' once to warm up, then repeatedly until both the minimum time and the
+    // minimum repetition count are reached. 'setup' runs untimed before every repetition.
+    void run(const std::string& name, size_t items, const std::function<void()>& body,
+             const std::function<void()>& setup = nullptr) {
+        if (!isSelected(name)) {
+            return;
+        }
+        std::vector<double> times;
+        double totalMs = 0.0;
+        if (setup) {
+            setup();
+        }
+        body();
+        while (totalMs < options.minTimeMs || static_cast<int>(times.size()) < options.minRepetitions) {
+            if (setup) {
+                setup();
+            }
+            auto start = std::chrono::steady_clock::now();
+            body();
+            times.push_back(elapsedMs(start));
+            totalMs += times.back();
+        }
+        std::sort(times.begin(), times.end());
+        
+        BenchmarkResult result;
+        result.name = name;
+        result.items = items;
+        result.repetitions = static_cast<int>(times.size());
+        result.medianMs = (times[(times.size() - 1) / 2] + times[times.size() / 2]) * 0.5;
+        result.minMs = times.front();
+        result.nsPerItem = result.medianMs * 1e6 / std::max<size_t>(items, 1);
+        results.push_back(result);
+        std::cerr << name << ": " << result.nsPerItem << " ns/item (" << result.repetitions << " reps)" << std::endl;
+    }
+    
+    std::vector<BenchmarkResult>& getResults() { return results; }
+
+private:
+    BenchmarkOptions options;
+    std::vector<BenchmarkResult> results;
+};
+
+// Accumulated so the optimizer cannot drop the queries
+static volatile float benchmarkSink;
+
+static std::vector<glm::vec3> makeQueryPoints(size_t count, const glm::vec3& minBounds, const glm::vec3& maxBounds, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+    std::vector<glm::vec3> points(count);
+    for (auto& point : points) {
+        point = minBounds + (maxBounds - minBounds) * glm::vec3(dis(rng), dis(rng), dis(rng));
+    }
+    return points;
+}
+
+static std::vector<glm::vec3> makeDirections(size_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dis(0.0f, 1.0f);
+    std::vector<glm::vec3> directions(count);
+    for (auto& direction : directions) {
+        direction = glm::normalize(glm::vec3(dis(rng), dis(rng), dis(rng)) + glm::vec3(1e-4f));
+    }
+    return directions;
+}
+
+static Mesh makeBlob(size_t targetTriangles) {
+    Mesh mesh;
+    generateProceduralMesh(ProceduralShape::Blob, getTessellationForTriangles(ProceduralShape::Blob, targetTriangles), mesh);
+    return mesh;
+}
+
+static void benchmarkSdfQueries(BenchmarkRunner& runner) {
+    Mesh mesh = makeBlob(10000);
+    for (int resolution : {32, 64, 128}) {
+        std::string suffix = "/res" + std::to_string(resolution);
+        if (!runner.isAnySelected({"sdf/sample" + suffix, "sdf/gradient" + suffix, "sdf/sample_parallel" + suffix})) {
+            continue;
+        }
+        SDF sdf(resolution);
+        sdf.generateFromMesh(mesh);
+        // Slightly beyond the grid so the clamped out-of-bounds path is exercised too
+        glm::vec3 margin = (sdf.getMax() - sdf.getMin()) * 0.05f;
+        std::vector<glm::vec3> points = makeQueryPoints(1 << 20, sdf.getMin() - margin, sdf.getMax() + margin, 1);
+        
+        runner.run("sdf/sample" + suffix, points.size(), [&]() {
+            float sum = 0.0f;
+            for (const auto& point : points) {
+                sum += sdf.sample(point);
+            }
+            benchmarkSink = sum;
+        });
+        runner.run("sdf/gradient" + suffix, points.size(), [&]() {
+            float sum = 0.0f;
+            for (const auto& point : points) {
+                sum += sdf.gradient(point).x;
+            }
+            benchmarkSink = sum;
+        });
+        runner.run("sdf/sample_parallel" + suffix, points.size(), [&]() {
+            std::vector<float> sums(points.size() / 4096 + 1, 0.0f);
+            parallelFor(points.size(), 4096, [&](size_t begin, size_t end) {
+                float sum = 0.0f;
+                for (size_t i = begin; i < end; ++i) {
+                    sum += sdf.sample(points[i]);
+                }
+                sums[begin / 4096] = sum;
+            });
+            benchmarkSink = sums[0];
+        });
+    }
+}
+
+static void benchmarkBvh(BenchmarkRunner& runner) {
+    for (size_t targetTriangles : {1000, 10000, 100000}) {
+        std::string suffix = "/tri" + std::to_string(targetTriangles);
+        if (!runner.isAnySelected({"bvh/build" + suffix, "bvh/closest" + suffix, "bvh/intersections" + suffix,
+                                   "bvh/closest_brute" + suffix, "bvh/intersections_brute" + suffix})) {
+            continue;
+        }
+        Mesh mesh = makeBlob(targetTriangles);
+        const std::vector<Triangle>& triangles = mesh.getTriangles();
+        glm::vec3 margin = (mesh.getMax() - mesh.getMin()) * 0.25f;
+        std::vector<glm::vec3> points = makeQueryPoints(4096, mesh.getMin() - margin, mesh.getMax() + margin, 2);
+        std::vector<glm::vec3> directions = makeDirections(points.size(), 3);
+        
+        BVH bvh;
+        runner.run("bvh/build" + suffix, triangles.size(), [&]() {
+            bvh = BVH();
+            bvh.build(triangles);
+        });
+        bvh.build(triangles);
+        
+        runner.run("bvh/closest" + suffix, points.size(), [&]() {
+            float sum = 0.0f;
+            for (const auto& point : points) {
+                sum += bvh.findClosestDistance(point, triangles);
+            }
+            benchmarkSink = sum;
+        });
+        runner.run("bvh/intersections" + suffix, points.size(), [&]() {
+            int sum = 0;
+            for (size_t i = 0; i < points.size(); ++i) {
+                sum += bvh.countIntersections(points[i], directions[i], triangles);
+            }
+            benchmarkSink = static_cast<float>(sum);
+        });
+        
+        // Brute force costs O(triangles) per query, so it uses fewer queries on large meshes
+        size_t bruteQueries = std::min(points.size(), std::max<size_t>(64, 4000000 / triangles.size()));
+        runner.run("bvh/closest_brute" + suffix, bruteQueries, [&]() {
+            float sum = 0.0f;
+            for (size_t i = 0; i < bruteQueries; ++i) {
+                sum += bruteForceClosestDistance(points[i], triangles);
+            }
+            benchmarkSink = sum;
+        });
+        runner.run("bvh/intersections_brute" + suffix, bruteQueries, [&]() {
+            int sum = 0;
+            for (size_t i = 0; i < bruteQueries; ++i) {
+                sum += bruteForceCountIntersections(points[i], directions[i], triangles);
+            }
+            benchmarkSink = static_cast<float>(sum);
+        });
+    }
+}
+
+static void benchmarkBake(BenchmarkRunner& runner) {
+    const int resolutions[] = {16, 32, 64};
+    std::vector<std::string> names;
+    for (int resolution : resolutions) {
+        names.push_back("sdf/bake/res" + std::to_string(resolution));
+    }
+    if (!runner.isAnySelected(names)) {
+        return;
+    }
+    Mesh mesh = makeBlob(10000);
+    for (size_t i = 0; i < names.size(); ++i) {
+        int resolution = resolutions[i];
+        size_t voxels = static_cast<size_t>(resolution) * resolution * resolution;
+        runner.run(names[i], voxels, [&]() {
+            SDF sdf(resolution);
+            sdf.generateFromMesh(mesh);
+        });
+    }
+}
+
+static void benchmarkSignedDistance(BenchmarkRunner& runner, AssetCache& assets) {
+    const std::string name = "collision/signed_distance";
+    if (!runner.isSelected(name)) {
+        return;
+    }
+    auto object = assets.instantiate(CollisionObject::makeAssetKey(makeProceduralMeshPath(ProceduralShape::Blob, 29), 64));
+    if (!object) {
+        return;
+    }
+    object->setPosition(glm::vec3(0.3f, -0.2f, 0.1f));
+    object->setRotation(glm::angleAxis(0.7f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f))));
+    object->setScale(glm::vec3(1.5f));
+    glm::vec3 margin = (object->getWorldMax() - object->getWorldMin()) * 0.25f;
+    std::vector<glm::vec3> points = makeQueryPoints(1 << 18, object->getWorldMin() - margin, object->getWorldMax() + margin, 4);
+    runner.run(name, points.size(), [&]() {
+        float sum = 0.0f;
+        for (const auto& point : points) {
+            sum += object->getSignedDistance(point);
+        }
+        benchmarkSink = sum;
+    });
+}
+
+static void benchmarkSimulationUpdate(BenchmarkRunner& runner, AssetCache& assets) {
+    const std::string assetKey = CollisionObject::makeAssetKey(makeProceduralMeshPath(ProceduralShape::Blob, 29), 64);
+    for (int objects : {1, 8, 64}) {
+        for (int particles : {1000, 10000, 100000}) {
+            for (bool sorted : {false, true}) {
+                // The sorted variant starts from particles reordered by Morton code
+                if (sorted && particles < 100000) {
+                    continue;
+                }
+                std::string name = "simulation/update/o" + std::to_string(objects) + "_p" + std::to_string(particles) +
+                                   (sorted ? "_sorted" : "");
+                if (!runner.isSelected(name)) {
+                    continue;
+                }
+                // Objects on a cubic lattice of unit cells, each cell holding one blob
+                int perAxis = 1;
+                while (perAxis * perAxis * perAxis < objects) {
+                    perAxis++;
+                }
+                glm::vec3 boundsMax(perAxis * 1.0f);
+                std::unique_ptr<Simulation> simulation;
+                
+                // Every repetition starts from the same state so the steps stay comparable
+                auto setup = [&]() {
+                    simulation = std::make_unique<Simulation>(glm::vec3(0.0f), boundsMax);
+                    simulation->setRandomSeed(42);
+                    for (int i = 0; i < objects; ++i) {
+                        auto object = assets.instantiate(assetKey);
+                        object->setPosition(glm::vec3(i % perAxis, (i / perAxis) % perAxis, i / (perAxis * perAxis)) + glm::vec3(0.5f));
+                        object->setScale(glm::vec3(0.6f));
+                        object->setMass(1.0f);
+                        object->setVelocity(glm::vec3(0.3f, 0.1f, -0.2f));
+                        simulation->addCollisionObject(std::move(object));
+                    }
+                    simulation->initialize(particles, 1.0f, 0.01f);
+                    if (sorted) {
+                        simulation->setSpatialReorderInterval(1);
+                        simulation->update(1.0f / 60.0f);
+                        simulation->setSpatialReorderInterval(0);
+                    }
+                };
+                runner.run(name, particles, [&]() {
+                    simulation->update(1.0f / 60.0f);
+                }, setup);
+            }
+        }
+    }
+}
+
+// A settled pile with one object moving through it, with and without particle sleeping
+static void benchmarkRestingParticles(BenchmarkRunner& runner, AssetCache& assets) {
+    const std::string assetKey = CollisionObject::makeAssetKey(makeProceduralMeshPath(ProceduralShape::Blob, 29), 64);
+    const int particles = 100000;
+    for (bool sleeping : {false, true}) {
+        std::string name = "simulation/resting/p" + std::to_string(particles) + (sleeping ? "_sleep" : "");
+        if (!runner.isSelected(name)) {
+            continue;
+        }
+        std::unique_ptr<Simulation> simulation;
+        auto setup = [&]() {
+            simulation = std::make_unique<Simulation>(glm::vec3(-2.0f, -1.0f, -1.0f), glm::vec3(2.0f, 1.0f, 1.0f));
+            simulation->setRandomSeed(42);
+            simulation->setParticleSleeping(sleeping);
+            simulation->setSleepThreshold(0.01f, 10);
+            auto object = assets.instantiate(assetKey);
+            object->setPosition(glm::vec3(-1.5f, 0.0f, 0.0f));
+            object->setScale(glm::vec3(0.5f));
+            object->setMass(100.0f);
+            object->setVelocity(glm::vec3(0.5f, 0.0f, 0.0f));
+            simulation->addCollisionObject(std::move(object));
+            simulation->initialize(particles, 0.0f, 0.01f);
+            for (int step = 0; step < 20; ++step) {
+                simulation->update(1.0f / 60.0f);
+            }
+        };
+        runner.run(name, particles, [&]() {
+            simulation->update(1.0f / 60.0f);
+        }, setup);
+    }
+}
+
+static void benchmarkParticleSpawn(BenchmarkRunner& runner) {
+    for (int particles : {100000, 1000000}) {
+        std::string name = "particles/spawn/p" + std::to_string(particles);
+        if (!runner.isSelected(name)) {
+            continue;
+        }
+        // initialize() reuses the storage, so repetitions after the first measure no allocation
+        ParticleSystem system(particles);
+        runner.run(name, particles, [&]() {
+            system.setSeed(42);
+            system.initialize(glm::vec3(-1.0f), glm::vec3(1.0f), 2.0f, 0.01f);
+        });
+    }
+}
+
+// Morton codes of random points sorted together with their indices, as in a particle reorder
+static void benchmarkMortonSort(BenchmarkRunner& runner) {
+    for (int count : {100000, 1000000}) {
+        std::string name = "particles/morton_sort/p" + std::to_string(count);
+        if (!runner.isSelected(name)) {
+            continue;
+        }
+        std::vector<glm::vec3> points = makeQueryPoints(count, glm::vec3(-1.0f), glm::vec3(1.0f), 5);
+        std::vector<uint32_t> keys, values;
+        RadixSortScratch scratch;
+        runner.run(name, count, [&]() {
+            keys.resize(points.size());
+            values.resize(points.size());
+            for (size_t i = 0; i < points.size(); ++i) {
+                keys[i] = mortonCode(points[i], glm::vec3(-1.0f), glm::vec3(1.0f));
+                values[i] = static_cast<uint32_t>(i);
+            }
+            radixSortPairs(keys, values, 30, scratch);
+        });
+    }
+}
+
+// FNV-1a, enough to tell whether two runs produced the same bytes
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Hash of a bake and of short runs with static and dynamic objects (fixed step, adaptive, and
+// resting particles that sleep and are woken), using the current thread count
+static uint64_t runDeterminismScenario(AssetCache& assets) {
+    Mesh mesh = makeBlob(10000);
+    SDF sdf(48);
+    sdf.generateFromMesh(mesh);
+    const std::vector<float>& grid = sdf.getGridData();
+    uint64_t hash = hashBytes(grid.data(), grid.size() * sizeof(float));
+    
+    const std::string assetKey = CollisionObject::makeAssetKey(makeProceduralMeshPath(ProceduralShape::Blob, 29), 32);
+    for (int variant = 0; variant < 3; ++variant) {
+        bool sleeping = variant == 2;
+        Simulation simulation(glm::vec3(0.0f), glm::vec3(2.0f));
+        simulation.setAdaptiveSubstepping(variant == 1);
+        simulation.setParticleSleeping(sleeping);
+        simulation.setSleepThreshold(0.05f, 5);
+        simulation.setRandomSeed(7);
+        for (int i = 0; i < 8; ++i) {
+            auto object = assets.instantiate(assetKey);
+            object->setPosition(glm::vec3(i % 2, (i / 2) % 2, i / 4) + glm::vec3(0.5f));
+            object->setScale(glm::vec3(0.6f));
+            // Every other object is static, so both response paths are covered
+            if (i % 2 == 0) {
+                object->setMass(2.0f);
+                object->setVelocity(glm::vec3(0.4f, -0.3f, 0.2f) * float(i + 1));
+            }
+            simulation.addCollisionObject(std::move(object));
+        }
+        simulation.initialize(50000, sleeping ? 0.0f : 3.0f, 0.01f);
+        for (int step = 0; step < 30; ++step) {
+            simulation.update(1.0f / 60.0f);
+        }
+        const std::vector<Particle>& particles = simulation.getParticles();
+        hash = hashBytes(particles.data(), particles.size() * sizeof(Particle), hash);
+        for (const auto& object : simulation.getCollisionObjects()) {
+            glm::vec3 position = object->getPosition(), velocity = object->getVelocity();
+            hash = hashBytes(&position, sizeof(position), hash);
+            hash = hashBytes(&velocity, sizeof(velocity), hash);
+        }
+    }
+    return hash;
+}
+
+// Runs the scenario with 1 to maxThreads threads; returns false if any result differs from 1 thread
+static bool checkDeterminism(int maxThreads) {
+    AssetCache assets;
+    assets.setSurfaceLodCount(0);
+    uint64_t reference = 0;
+    bool identical = true;
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        setParallelThreadCount(threads);
+        uint64_t hash;
+        {
+            QuietScope quiet;
+            hash = runDeterminismScenario(assets);
+        }
+        if (threads == 1) {
+            reference = hash;
+        }
+        bool same = hash == reference;
+        identical = identical && same;
+        std::printf("threads %2d: %016llx %s\n", threads, static_cast<unsigned long long>(hash), same ? "ok" : "MISMATCH");
+    }
+    return identical;
+}
+
+// Runs a stacking scene until it settles. 'worstGap' is the largest distance between a
+// dynamic object's bottom and the top of the object it rests on, either way; 'maxSpeed' is
+// the fastest object over the last second.
+static bool settleStack(const std::string& path, AssetCache& assets, int iterations, bool warmStarting,
+                        float& worstGap, float& maxSpeed) {
+    Simulation simulation(glm::vec3(-1.0f), glm::vec3(1.0f));
+    SceneDescription scene;
+    if (!loadScene(path, simulation, assets, scene)) {
+        return false;
+    }
+    if (iterations > 0) {
+        simulation.setSolverIterations(iterations);
+    }
+    simulation.setWarmStarting(warmStarting);
+    float deltaTime = 1.0f / (scene.stepRate > 0.0f ? scene.stepRate : 60.0f);
+    int settleSteps = static_cast<int>(5.0f / deltaTime);
+    int measureSteps = static_cast<int>(1.0f / deltaTime);
+    maxSpeed = 0.0f;
+    for (int step = 0; step < settleSteps + measureSteps; ++step) {
+        simulation.update(deltaTime);
+        if (step < settleSteps) {
+            continue;
+        }
+        for (const auto& object : simulation.getCollisionObjects()) {
+            maxSpeed = std::max(maxSpeed, object->isStatic() ? 0.0f : glm::length(object->getVelocity()));
+        }
+    }
+    
+    // The support of an object is the highest object below its center that overlaps it
+    // horizontally
+    worstGap = 0.0f;
+    const auto& objects = simulation.getCollisionObjects();
+    for (const auto& object : objects) {
+        if (object->isStatic()) {
+            continue;
+        }
+        glm::vec3 low = object->getWorldMin(), high = object->getWorldMax();
+        bool supported = false;
+        float supportTop = 0.0f;
+        for (const auto& other : objects) {
+            glm::vec3 otherLow = other->getWorldMin(), otherHigh = other->getWorldMax();
+            bool below = other != object && otherHigh.y <= object->getPosition().y &&
+                         otherLow.x < high.x && otherHigh.x > low.x && otherLow.z < high.z && otherHigh.z > low.z;
+            if (below && (!supported || otherHigh.y > supportTop)) {
+                supported = true;
+                supportTop = otherHigh.y;
+            }
+        }
+        if (supported) {
+            worstGap = std::max(worstGap, glm::abs(low.y - supportTop));
+        }
+    }
+    return true;
+}
+
+// Settles the scene with its own solver iterations and with a single one, both warm
+// started, and fails if any object rests further than 'tolerance' from its support or
+// still moves. A single cold-started iteration is reported for comparison only.
+static bool checkStack(const std::string& path, float tolerance) {
+    struct Configuration {
+        int iterations;  // 0 = the scene's
+        bool warmStarting;
+        bool required;
+    };
+    const Configuration configurations[] = {{0, true, true}, {1, true, true}, {1, false, false}};
+    AssetCache assets;
+    assets.setSurfaceLodCount(0);
+    bool resting = true;
+    for (const Configuration& configuration : configurations) {
+        float worstGap = 0.0f, maxSpeed = 0.0f;
+        bool loaded;
+        {
+            QuietScope quiet;
+            loaded = settleStack(path, assets, configuration.iterations, configuration.warmStarting, worstGap, maxSpeed);
+        }
+        if (!loaded) {
+            return false;
+        }
+        bool ok = worstGap <= tolerance && maxSpeed <= 1e-3f;
+        if (configuration.required) {
+            resting = resting && ok;
+        }
+        std::string iterations = configuration.iterations > 0 ? std::to_string(configuration.iterations) : "scene";
+        std::printf("iterations %-5s warm start %-3s: worst gap %.1f mm, max speed %.4f %s\n", iterations.c_str(),
+                    configuration.warmStarting ? "on" : "off", worstGap * 1000.0f, maxSpeed,
+                    !configuration.required ? "(reference)" : ok ? "ok" : "FAIL");
+    }
+    return resting;
+}
+
+static void writeCsv(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    out << "name,items,repetitions,median_ms,min_ms,ns_per_item,baseline_ns_per_item,change_percent,status\n";
+    for (const auto& result : results) {
+        out << result.name << "," << result.items << "," << result.repetitions << ","
+            << result.medianMs << "," << result.minMs << "," << result.nsPerItem << ",";
+        if (result.hasBaseline) {
+            out << result.baselineNsPerItem << "," << (result.nsPerItem / result.baselineNsPerItem - 1.0) * 100.0;
+        } else {
+            out << ",";
+        }
+        out << "," << result.status << "\n";
+    }
+}
+
+static void writeJson(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    out << "{\n  \"threads\": " << getParallelThreadCount() << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"items\": " << result.items
+            << ", \"repetitions\": " << result.repetitions << ", \"median_ms\": " << result.medianMs
+            << ", \"min_ms\": " << result.minMs << ", \"ns_per_item\": " << result.nsPerItem;
+        if (result.hasBaseline) {
+            out << ", \"baseline_ns_per_item\": " << result.baselineNsPerItem
+                << ", \"change_percent\": " << (result.nsPerItem / result.baselineNsPerItem - 1.0) * 100.0;
+        }
+        if (!result.status.empty()) {
+            out << ", \"status\": \"" << result.status << "\"";
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// Reads name -> ns_per_item from a CSV written by an earlier run
+static bool readBaseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Cannot open baseline " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    std::getline(file, line);  // Header
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields;
+        std::istringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() >= 6) {
+            baseline[fields[0]] = std::atof(fields[5].c_str());
+        }
+    }
+    return true;
+}
+
+// Marks results slower than the baseline by more than 'thresholdPercent'; returns the count
+static int compareWithBaseline(std::vector<BenchmarkResult>& results, const std::map<std::string, double>& baseline, double thresholdPercent) {
+    int regressions = 0;
+    for (auto& result : results) {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0.0) {
+            result.status = "new";
+            continue;
+        }
+        result.hasBaseline = true;
+        result.baselineNsPerItem = it->second;
+        double change = (result.nsPerItem / it->second - 1.0) * 100.0;
+        if (change > thresholdPercent) {
+            result.status = "regressed";
+            regressions++;
+            std::cerr << "REGRESSION " << result.name << ": " << it->second << " -> " << result.nsPerItem
+                      << " ns/item (+" << change << "%)" << std::endl;
+        } else if (change < -thresholdPercent) {
+            result.status = "improved";
+        } else {
+            result.status = "ok";
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    std::string format = "csv";
+    std::string outputPath;
+    std::string baselinePath;
+    double thresholdPercent = 10.0;
+    int threads = 0;  // 0 = keep the pool default
+    int determinismThreads = 0;  // > 0: only run the determinism check up to this many threads
+    std::string stackScene;  // Non-empty: only run the stack check on this scene
+    bool pinThreads = false;
+    
+    // Usage: sdf_benchmark [--filter text] [--format csv|json] [--output file] [--baseline file.csv]
+    //                      [--threshold percent] [--min-time ms] [--repetitions n] [--threads n] [--pin-threads]
+    //        sdf_benchmark --check-determinism [max threads]
+    //        sdf_benchmark --check-stack scene
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            format = argv[++i];
+            if (format != "csv" && format != "json") {
+                std::cerr << "Unknown format: " << format << std::endl;
+                return 1;
+            }
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            thresholdPercent = std::atof(argv[++i]);
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.minTimeMs = std::atof(argv[++i]);
+        } else if (arg == "--repetitions" && i + 1 < argc) {
+            options.minRepetitions = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--pin-threads") {
+            pinThreads = true;
+        } else if (arg == "--check-determinism") {
+            determinismThreads = std::max(8, getParallelThreadCount());
+            if (i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+                determinismThreads = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--check-stack" && i + 1 < argc) {
+            stackScene = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (pinThreads) {
+        setParallelThreadAffinity(true);
+    }
+    if (threads > 0) {
+        setParallelThreadCount(threads);
+    }
+    
+    if (determinismThreads > 0) {
+        return checkDeterminism(determinismThreads) ? 0 : 3;
+    }
+    if (!stackScene.empty()) {
+        return checkStack(stackScene, 0.005f) ? 0 : 4;
+    }
+    
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty() && !readBaseline(baselinePath, baseline)) {
+        return 1;
+    }
+    
+    std::cerr << "Running benchmarks with " << getParallelThreadCount() << " threads" << std::endl;
+    BenchmarkRunner runner(options);
+    {
+        QuietScope quiet;
+        AssetCache assets;
+        assets.setSurfaceLodCount(0);
+        benchmarkSdfQueries(runner);
+        benchmarkBvh(runner);
+        benchmarkBake(runner);
+        benchmarkSignedDistance(runner, assets);
+        benchmarkSimulationUpdate(runner, assets);
+        benchmarkRestingParticles(runner, assets);
+        benchmarkParticleSpawn(runner);
+        benchmarkMortonSort(runner);
+    }
+    
+    std::vector<BenchmarkResult>& results = runner.getResults();
+    int regressions = baselinePath.empty() ? 0 : compareWithBaseline(results, baseline, thresholdPercent);
+    
+    std::ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        if (!file.is_open()) {
+            std::cerr << "Cannot write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = outputPath.empty() ? std::cout : file;
+    if (format == "json") {
+        writeJson(out, results);
+    } else {
+        writeCsv(out, results);
+    }
+    
+    if (regressions > 0) {
+        std::cerr << regressions << " benchmark(s) regressed by more than " << thresholdPercent << "%" << std::endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include "parallel.h"
+#include "simulation.h"
+#include "sphere_tracer.h"
+
+// Renders the particle_simulation scene on the CPU, without an OpenGL context.
+// Doubles as a batched SDF query benchmark: every frame reports rays and SDF samples per second.
+int main(int argc, char* argv[]) {
+    int resolution = 64;
+    int numParticles = 1000;
+    int width = 800, height = 600;
+    int frames = 1;
+    int tileSize = 16;
+    int threads = 0;  // 0 = keep the pool default
+    bool pinThreads = false;
+    std::string meshPath = "../../data/bunny.obj";
+    std::string outputDirectory = "sdf_render_output";
+    
+    // Usage: sdf_render [resolution] [numParticles] [--size WxH] [--frames n] [--tile n] [--threads n]
+    //                   [--mesh path] [--output directory] [--pin-threads]
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                std::cerr << "Invalid image size: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--tile" && i + 1 < argc) {
+            tileSize = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--pin-threads") {
+            pinThreads = true;
+        } else if (arg == "--mesh" && i + 1 < argc) {
+            meshPath = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputDirectory = argv[++i];
+        } else if (positional == 0) {
+            resolution = std::atoi(argv[i]);
+            if (resolution <= 0) {
+                std::cerr << "Invalid resolution: " << argv[i] << std::endl;
+                return 1;
+            }
+            positional++;
+        } else if (positional == 1) {
+            numParticles = std::atoi(argv[i]);
+            if (numParticles < 0) {
+                std::cerr << "Invalid particle count: " << argv[i] << std::endl;
+                return 1;
+            }
+            positional++;
+        }
+    }
+    if (pinThreads) {
+        setParallelThreadAffinity(true);
+    }
+    if (threads > 0) {
+        setParallelThreadCount(threads);
+    }
+    
+    auto collisionObject = std::make_unique<CollisionObject>();
+    if (!collisionObject->loadFromOBJ(meshPath, resolution)) {
+        std::cerr << "Failed to load collision object" << std::endl;
+        return 1;
+    }
+    
+    // Same scene layout as particle_simulation
+    glm::vec3 objMin = collisionObject->getWorldMin();
+    glm::vec3 objMax = collisionObject->getWorldMax();
+    glm::vec3 padding = (objMax - objMin) * 0.5f;
+    glm::vec3 boxMin = objMin - padding;
+    glm::vec3 boxMax = objMax + padding;
+    glm::vec3 center = (boxMin + boxMax) * 0.5f;
+    collisionObject->setMass(50.0f);
+    collisionObject->setPosition(center);
+    collisionObject->setVelocity(glm::vec3(1.0f, 0.5f, 0.0f));
+    
+    glm::vec3 objSize = objMax - objMin;
+    float maxDimension = glm::max(glm::max(objSize.x, objSize.y), objSize.z);
+    
+    Simulation simulation(boxMin, boxMax);
+    simulation.addCollisionObject(std::move(collisionObject));
+    simulation.initialize(numParticles, maxDimension * 0.8f, maxDimension * 0.01f);
+    
+    // Orbit camera matching the interactive renderer's default angles, framed on the bounds
+    float cameraDistance = glm::length(boxMax - boxMin) * 1.5f;
+    glm::vec3 cameraOffset = cameraDistance * glm::vec3(std::cos(0.3f), std::sin(0.3f), 0.0f);
+    
+    SphereTracer tracer(width, height);
+    tracer.setTileSize(tileSize);
+    tracer.setCamera(center + cameraOffset, center, glm::vec3(0.0f, 1.0f, 0.0f));
+    
+    std::error_code error;
+    std::filesystem::create_directories(outputDirectory, error);
+    if (error) {
+        std::cerr << "Cannot create output directory " << outputDirectory << ": " << error.message() << std::endl;
+        return 1;
+    }
+    
+    std::cout << "Rendering " << frames << " frame(s) at " << width << "x" << height
+              << " with " << getParallelThreadCount() << " threads" << std::endl;
+    
+    double totalTimeMs = 0.0;
+    uint64_t totalQueries = 0;
+    uint64_t totalRays = 0;
+    for (int frame = 0; frame < frames; ++frame) {
+        if (frame > 0) {
+            simulation.update(1.0f / 60.0f);
+        }
+        tracer.render(simulation);
+        
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06d.ppm", frame);
+        if (!tracer.writeImage((std::filesystem::path(outputDirectory) / name).string())) {
+            return 1;
+        }
+        
+        const SphereTraceStats& stats = tracer.getStats();
+        double seconds = stats.renderTimeMs / 1000.0;
+        std::cout << "Frame " << frame << ": " << stats.renderTimeMs << " ms"
+                  << ", " << stats.rays / seconds / 1e6 << " Mrays/s"
+                  << ", " << stats.sdfQueries << " SDF queries (" << stats.sdfQueries / seconds / 1e6 << " M/s)"
+                  << ", " << stats.sphereTests << " sphere tests"
+                  << ", " << stats.emptyTiles << "/" << stats.tiles << " empty tiles" << std::endl;
+        totalTimeMs += stats.renderTimeMs;
+        totalQueries += stats.sdfQueries;
+        totalRays += stats.rays;
+    }
+    
+    double totalSeconds = totalTimeMs / 1000.0;
+    std::cout << "Average: " << totalTimeMs / frames << " ms/frame, "
+              << totalRays / totalSeconds / 1e6 << " Mrays/s, "
+              << totalQueries / totalSeconds / 1e6 << " M SDF queries/s" << std::endl;
+    std::cout << "Images written to " << outputDirectory << std::endl;
+    
+    return 0;
+}
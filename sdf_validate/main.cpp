@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "asset_cache.h"
+#include "mesh_generator.h"
+#include "parallel.h"
+
+// Checks a baked SDF against exact distances computed from the mesh. Distances come from
+// testing every triangle; signs come from the winding number, which does not share the
+// ray-parity test the bake uses. Each generator mode is one entry in getGeneratorModes().
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Bakes 'meshPath' at 'resolution'; 'mesh' is the same mesh, already loaded
+using GenerateFunction = std::function<std::shared_ptr<const SDF>(const std::string& meshPath, const Mesh& mesh, int resolution)>;
+
+struct GeneratorMode {
+    const char* name;
+    const char* description;
+    GenerateFunction generate;
+};
+
+static std::vector<GeneratorMode> getGeneratorModes() {
+    return {
+        {"bvh", "SDF::generateFromMesh", [](const std::string&, const Mesh& mesh, int resolution) {
+            auto sdf = std::make_shared<SDF>(resolution);
+            sdf->generateFromMesh(mesh);
+            return std::shared_ptr<const SDF>(sdf);
+        }},
+        {"bake-file", "AssetCache bake written to disk and read back", [](const std::string& meshPath, const Mesh&, int resolution) {
+            std::string directory = (std::filesystem::temp_directory_path() / "sdf_validate_bakes").string();
+            std::string key = CollisionObject::makeAssetKey(meshPath, resolution);
+            std::shared_ptr<const SDF> sdf;
+            // Start empty so the first cache really bakes and saves; a fresh one must then load the file
+            std::error_code error;
+            std::filesystem::remove_all(directory, error);
+            for (int pass = 0; pass < 2; ++pass) {
+                AssetCache assets;
+                assets.setBakeDirectory(directory);
+                assets.setSurfaceLodCount(0);
+                auto object = assets.acquire(key);
+                if (!object) {
+                    return std::shared_ptr<const SDF>();
+                }
+                // The prototype stays alive through 'sdf' sharing its grid
+                sdf = std::shared_ptr<const SDF>(object, &object->getSDF());
+            }
+            return sdf;
+        }},
+    };
+}
+
+// Solid angle of triangle (a, b, c) seen from the origin (Van Oosterom and Strackee)
+static double getSolidAngle(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c) {
+    double la = glm::length(a), lb = glm::length(b), lc = glm::length(c);
+    double numerator = glm::dot(a, glm::cross(b, c));
+    double denominator = la * lb * lc + glm::dot(a, b) * lc + glm::dot(b, c) * la + glm::dot(c, a) * lb;
+    return 2.0 * std::atan2(numerator, denominator);
+}
+
+// Exact signed distance: negative inside, where the winding number is about 1
+static float getExactDistance(const glm::vec3& point, const std::vector<Triangle>& triangles) {
+    double solidAngle = 0.0;
+    glm::dvec3 p(point);
+    for (const Triangle& tri : triangles) {
+        solidAngle += getSolidAngle(glm::dvec3(tri.v0) - p, glm::dvec3(tri.v1) - p, glm::dvec3(tri.v2) - p);
+    }
+    float distance = bruteForceClosestDistance(point, triangles);
+    return solidAngle / (4.0 * 3.14159265358979) > 0.5 ? -distance : distance;
+}
+
+struct ErrorStats {
+    size_t count = 0;
+    double maxError = 0.0;
+    double meanError = 0.0;
+    double p50 = 0.0, p90 = 0.0, p99 = 0.0;
+    size_t signMismatches = 0;
+    size_t farSignMismatches = 0;  // Exact distance beyond half a cell, where the sign is unambiguous
+};
+
+static double getPercentile(const std::vector<double>& sorted, double fraction) {
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5))];
+}
+
+static ErrorStats computeErrorStats(const std::vector<float>& measured, const std::vector<float>& exact, float cellSize) {
+    ErrorStats stats;
+    stats.count = measured.size();
+    if (stats.count == 0) {
+        return stats;
+    }
+    std::vector<double> errors(stats.count);
+    double sum = 0.0;
+    for (size_t i = 0; i < stats.count; ++i) {
+        errors[i] = std::abs(static_cast<double>(measured[i]) - exact[i]);
+        sum += errors[i];
+        if ((measured[i] < 0.0f) != (exact[i] < 0.0f)) {
+            stats.signMismatches++;
+            if (std::abs(exact[i]) > 0.5f * cellSize) {
+                stats.farSignMismatches++;
+            }
+        }
+    }
+    std::sort(errors.begin(), errors.end());
+    stats.maxError = errors.back();
+    stats.meanError = sum / stats.count;
+    stats.p50 = getPercentile(errors, 0.5);
+    stats.p90 = getPercentile(errors, 0.9);
+    stats.p99 = getPercentile(errors, 0.99);
+    return stats;
+}
+
+static std::vector<float> computeExactDistances(const std::vector<glm::vec3>& points, const std::vector<Triangle>& triangles) {
+    std::vector<float> exact(points.size());
+    parallelFor(points.size(), 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            exact[i] = getExactDistance(points[i], triangles);
+        }
+    });
+    return exact;
+}
+
+// Random points on the surface (area weighted), moved along the face normal by up to 'maxOffset'
+static std::vector<glm::vec3> makeNearSurfacePoints(const std::vector<Triangle>& triangles, size_t count, float maxOffset, std::mt19937& rng) {
+    std::vector<double> cumulativeArea(triangles.size());
+    double totalArea = 0.0;
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        totalArea += 0.5 * glm::length(glm::cross(triangles[i].v1 - triangles[i].v0, triangles[i].v2 - triangles[i].v0));
+        cumulativeArea[i] = totalArea;
+    }
+    std::uniform_real_distribution<double> pickArea(0.0, totalArea);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> offset(-maxOffset, maxOffset);
+    std::vector<glm::vec3> points(count);
+    for (auto& point : points) {
+        size_t index = std::lower_bound(cumulativeArea.begin(), cumulativeArea.end(), pickArea(rng)) - cumulativeArea.begin();
+        const Triangle& tri = triangles[std::min(index, triangles.size() - 1)];
+        float u = unit(rng), v = unit(rng);
+        if (u + v > 1.0f) {
+            u = 1.0f - u;
+            v = 1.0f - v;
+        }
+        point = tri.v0 + u * (tri.v1 - tri.v0) + v * (tri.v2 - tri.v0) + offset(rng) * tri.normal;
+    }
+    return points;
+}
+
+static void printStats(const char* set, const ErrorStats& stats, float cellSize) {
+    std::printf("  %-13s %8zu %10.3g %10.3g %10.3g %10.3g %10.3g %9.3f %8.3f%% %8.3f%%\n",
+                set, stats.count, stats.maxError, stats.meanError, stats.p50, stats.p90, stats.p99,
+                stats.maxError / cellSize, 100.0 * stats.signMismatches / std::max<size_t>(stats.count, 1),
+                100.0 * stats.farSignMismatches / std::max<size_t>(stats.count, 1));
+}
+
+int main(int argc, char* argv[]) {
+    std::string meshPath = makeProceduralMeshPath(ProceduralShape::Blob, 29);
+    std::vector<int> resolutions = {32, 64};
+    std::vector<std::string> modeNames;
+    size_t sampleCount = 10000;
+    uint32_t seed = 1;
+    int threads = 0;  // 0 = keep the pool default
+    double maxErrorCells = -1.0;      // Limits for the exit status; negative = not checked
+    double maxSignMismatchPercent = -1.0;
+    
+    // Usage: sdf_validate [--mesh path] [--resolution n[,n...]] [--mode name]... [--samples n] [--seed n]
+    //                     [--threads n] [--max-error cells] [--max-sign-mismatch percent]
+    std::vector<GeneratorMode> modes = getGeneratorModes();
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--mesh" && i + 1 < argc) {
+            meshPath = argv[++i];
+        } else if (arg == "--resolution" && i + 1 < argc) {
+            resolutions.clear();
+            for (const char* cursor = argv[++i]; *cursor;) {
+                char* end = nullptr;
+                long value = std::strtol(cursor, &end, 10);
+                if (end == cursor || value < 2) {
+                    std::cerr << "Invalid resolution list: " << argv[i] << std::endl;
+                    return 1;
+                }
+                resolutions.push_back(static_cast<int>(value));
+                cursor = *end == ',' ? end + 1 : end;
+            }
+        } else if (arg == "--mode" && i + 1 < argc) {
+            modeNames.push_back(argv[++i]);
+        } else if (arg == "--samples" && i + 1 < argc) {
+            sampleCount = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--max-error" && i + 1 < argc) {
+            maxErrorCells = std::atof(argv[++i]);
+        } else if (arg == "--max-sign-mismatch" && i + 1 < argc) {
+            maxSignMismatchPercent = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            std::cerr << "Generator modes:" << std::endl;
+            for (const auto& mode : modes) {
+                std::cerr << "  " << mode.name << " - " << mode.description << std::endl;
+            }
+            return 1;
+        }
+    }
+    if (threads > 0) {
+        setParallelThreadCount(threads);
+    }
+    if (modeNames.empty()) {
+        modeNames.push_back(modes.front().name);
+    }
+    
+    Mesh mesh;
+    if (!loadMeshFromPath(meshPath, mesh)) {
+        return 1;
+    }
+    const std::vector<Triangle>& triangles = mesh.getTriangles();
+    std::cout << "Validating " << meshPath << " (" << triangles.size() << " triangles) with "
+              << getParallelThreadCount() << " threads" << std::endl;
+    
+    bool passed = true;
+    for (const std::string& modeName : modeNames) {
+        auto mode = std::find_if(modes.begin(), modes.end(), [&](const GeneratorMode& candidate) { return modeName == candidate.name; });
+        if (mode == modes.end()) {
+            std::cerr << "Unknown generator mode: " << modeName << std::endl;
+            return 1;
+        }
+        for (int resolution : resolutions) {
+            auto start = std::chrono::steady_clock::now();
+            std::shared_ptr<const SDF> sdf = mode->generate(meshPath, mesh, resolution);
+            double bakeMs = elapsedMs(start);
+            if (!sdf) {
+                std::cerr << "Generator " << mode->name << " failed at resolution " << resolution << std::endl;
+                return 1;
+            }
+            glm::vec3 cell = sdf->getCellSize();
+            float cellSize = std::max(std::max(cell.x, cell.y), cell.z);
+            std::mt19937 rng(seed);
+            
+            // Stored grid values: the generator's own error, without interpolation
+            std::vector<glm::vec3> gridPoints(sampleCount);
+            std::vector<float> gridValues(sampleCount);
+            std::uniform_int_distribution<int> voxel(0, resolution - 1);
+            for (size_t i = 0; i < sampleCount; ++i) {
+                int x = voxel(rng), y = voxel(rng), z = voxel(rng);
+                gridPoints[i] = sdf->getMin() + glm::vec3(x, y, z) * cell;
+                gridValues[i] = sdf->getGridValue(x, y, z);
+            }
+            // Interpolated samples, uniformly in the grid bounds and within two cells of the surface
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            std::vector<glm::vec3> uniformPoints(sampleCount);
+            for (auto& point : uniformPoints) {
+                point = sdf->getMin() + (sdf->getMax() - sdf->getMin()) * glm::vec3(unit(rng), unit(rng), unit(rng));
+            }
+            std::vector<glm::vec3> surfacePoints = makeNearSurfacePoints(triangles, sampleCount, 2.0f * cellSize, rng);
+            std::vector<float> uniformValues(sampleCount), surfaceValues(sampleCount);
+            for (size_t i = 0; i < sampleCount; ++i) {
+                uniformValues[i] = sdf->sample(uniformPoints[i]);
+                surfaceValues[i] = sdf->sample(surfacePoints[i]);
+            }
+            
+            auto referenceStart = std::chrono::steady_clock::now();
+            ErrorStats gridStats = computeErrorStats(gridValues, computeExactDistances(gridPoints, triangles), cellSize);
+            ErrorStats uniformStats = computeErrorStats(uniformValues, computeExactDistances(uniformPoints, triangles), cellSize);
+            ErrorStats surfaceStats = computeErrorStats(surfaceValues, computeExactDistances(surfacePoints, triangles), cellSize);
+            double referenceMs = elapsedMs(referenceStart);
+            
+            size_t voxels = static_cast<size_t>(resolution) * resolution * resolution;
+            std::printf("\nmode %s, resolution %d: %zu voxels in %.1f ms (%.3f M voxels/s), cell %.4g, reference %.0f ms\n",
+                        mode->name, resolution, voxels, bakeMs, voxels / (bakeMs * 1000.0), cellSize, referenceMs);
+            std::printf("  %-13s %8s %10s %10s %10s %10s %10s %9s %9s %9s\n",
+                        "set", "points", "max", "mean", "p50", "p90", "p99", "max/cell", "sign", ">0.5cell");
+            printStats("grid", gridStats, cellSize);
+            printStats("uniform", uniformStats, cellSize);
+            printStats("near-surface", surfaceStats, cellSize);
+            
+            for (const ErrorStats* stats : {&gridStats, &uniformStats, &surfaceStats}) {
+                if (maxErrorCells >= 0.0 && stats->maxError > maxErrorCells * cellSize) {
+                    passed = false;
+                }
+                if (maxSignMismatchPercent >= 0.0 && 100.0 * stats->farSignMismatches / stats->count > maxSignMismatchPercent) {
+                    passed = false;
+                }
+            }
+        }
+    }
+    
+    if (!passed) {
+        std::cout << "\nFAILED: error or sign mismatches above the given limits" << std::endl;
+        return 2;
+    }
+    return 0;
+}
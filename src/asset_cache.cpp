@@ -0,0 +1,261 @@
+#include "asset_cache.h"
+#include "mapped_file.h"
+#include "mesh_generator.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char BakeMagic[8] = {'S', 'D', 'F', 'B', 'A', 'K', 'E', '1'};
+static const uint32_t BakeVersion = 1;
+
+// Fixed part of a bake file: magic, version, resolution, source size and time, bounds, key length
+struct BakeHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t resolution;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    float minBounds[3];
+    float maxBounds[3];
+    uint32_t keyBytes;
+};
+
+// Identifies the OBJ contents a bake was made from without hashing the whole file.
+// Procedural meshes are fully described by their path, which is part of the key.
+static bool getSourceStamp(const std::string& path, uint64_t& size, int64_t& time) {
+    if (isProceduralMeshPath(path)) {
+        size = 0;
+        time = 0;
+        return true;
+    }
+    std::error_code error;
+    size = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    time = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+    return !error;
+}
+
+// Grid values start at the next 4-byte boundary after the key
+static size_t getBakeDataOffset(size_t keyBytes) {
+    return (sizeof(BakeHeader) + keyBytes + 3) & ~size_t(3);
+}
+
+AssetCache::AssetCache() : surfaceLodCount(MaxSurfaceLods) {
+}
+
+std::shared_ptr<const CollisionObject> AssetCache::acquire(const std::string& key) {
+    std::promise<std::shared_ptr<const CollisionObject>> promise;
+    std::shared_future<std::shared_ptr<const CollisionObject>> inFlight;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = assets.find(key);
+        if (it != assets.end()) {
+            return it->second;
+        }
+        auto pending = loading.find(key);
+        if (pending != loading.end()) {
+            inFlight = pending->second;
+        } else {
+            loading.emplace(key, promise.get_future().share());
+        }
+    }
+    if (inFlight.valid()) {
+        return inFlight.get();
+    }
+    
+    // Load without holding the lock so different assets can bake concurrently
+    std::shared_ptr<const CollisionObject> asset = load(key);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // add() may have registered the key meanwhile; keep the first copy. A failed load
+        // is not cached, so a later call tries again.
+        if (asset) {
+            asset = assets.emplace(key, asset).first->second;
+        }
+        loading.erase(key);
+    }
+    promise.set_value(asset);
+    return asset;
+}
+
+bool AssetCache::preload(const std::vector<std::string>& keys) {
+    std::vector<std::string> missing;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& key : keys) {
+            if (assets.find(key) == assets.end()) {
+                missing.push_back(key);
+            }
+        }
+    }
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    
+    // One asset per task; threads left idle by a small batch help with the bakes inside it
+    std::atomic<bool> succeeded(true);
+    parallelFor(missing.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!acquire(missing[i])) {
+                succeeded = false;
+            }
+        }
+    });
+    return succeeded;
+}
+
+std::unique_ptr<CollisionObject> AssetCache::instantiate(const std::string& key) {
+    std::shared_ptr<const CollisionObject> prototype = acquire(key);
+    if (!prototype) {
+        return nullptr;
+    }
+    auto object = std::make_unique<CollisionObject>();
+    object->shareGeometry(*prototype);
+    return object;
+}
+
+void AssetCache::add(std::shared_ptr<const CollisionObject> prototype) {
+    if (!prototype || prototype->getAssetKey().empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    assets.emplace(prototype->getAssetKey(), prototype);
+}
+
+size_t AssetCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return assets.size();
+}
+
+std::shared_ptr<CollisionObject> AssetCache::load(const std::string& key) const {
+    size_t split = key.rfind('|');
+    int resolution = split == std::string::npos ? 0 : std::atoi(key.c_str() + split + 1);
+    if (resolution < 2) {
+        std::cerr << "AssetCache: malformed asset key '" << key << "'" << std::endl;
+        return nullptr;
+    }
+    std::string path = key.substr(0, split);
+    
+    auto object = std::make_shared<CollisionObject>();
+    if (bakeDirectory.empty()) {
+        if (!object->loadFromOBJ(path, resolution)) {
+            return nullptr;
+        }
+    } else {
+        auto mesh = std::make_shared<Mesh>();
+        if (!loadMeshFromPath(path, *mesh)) {
+            return nullptr;
+        }
+        auto sdf = std::make_shared<SDF>(resolution);
+        if (!loadBake(key, path, *sdf)) {
+            sdf->generateFromMesh(*mesh);
+            saveBake(key, path, *sdf);
+        }
+        object->setGeometry(mesh, sdf, key);
+    }
+    
+    if (surfaceLodCount > 0) {
+        object->buildSurfaceLods(surfaceLodCount);
+    }
+    return object;
+}
+
+std::string AssetCache::getBakePath(const std::string& key) const {
+    std::ostringstream name;
+    name << std::hex << std::hash<std::string>()(key) << ".sdfbake";
+    return (std::filesystem::path(bakeDirectory) / name.str()).string();
+}
+
+bool AssetCache::loadBake(const std::string& key, const std::string& sourcePath, SDF& sdf) const {
+    std::string bakePath = getBakePath(key);
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (!std::filesystem::exists(bakePath) || !getSourceStamp(sourcePath, sourceSize, sourceTime)) {
+        return false;
+    }
+    
+    MappedFile file;
+    if (!file.open(bakePath) || file.size() < sizeof(BakeHeader)) {
+        return false;
+    }
+    BakeHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    size_t gridBytes = static_cast<size_t>(sdf.getResolution()) * sdf.getResolution() * sdf.getResolution() * sizeof(float);
+    size_t dataOffset = getBakeDataOffset(header.keyBytes);
+    if (std::memcmp(header.magic, BakeMagic, sizeof(BakeMagic)) != 0 || header.version != BakeVersion
+        || header.resolution != sdf.getResolution() || header.keyBytes != key.size()
+        || file.size() != dataOffset + gridBytes
+        || std::memcmp(file.data() + sizeof(header), key.data(), key.size()) != 0) {
+        return false;
+    }
+    if (header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+        std::cout << "AssetCache: " << sourcePath << " changed since it was baked, rebaking" << std::endl;
+        return false;
+    }
+    
+    sdf.setGrid(glm::vec3(header.minBounds[0], header.minBounds[1], header.minBounds[2]),
+                glm::vec3(header.maxBounds[0], header.maxBounds[1], header.maxBounds[2]),
+                reinterpret_cast<const float*>(file.data() + dataOffset));
+    std::cout << "AssetCache: loaded baked SDF for " << key << " from " << bakePath << std::endl;
+    return true;
+}
+
+void AssetCache::saveBake(const std::string& key, const std::string& sourcePath, const SDF& sdf) const {
+    BakeHeader header = {};
+    std::memcpy(header.magic, BakeMagic, sizeof(BakeMagic));
+    header.version = BakeVersion;
+    header.resolution = sdf.getResolution();
+    if (!getSourceStamp(sourcePath, header.sourceSize, header.sourceTime)) {
+        return;
+    }
+    glm::vec3 minBounds = sdf.getMin(), maxBounds = sdf.getMax();
+    for (int axis = 0; axis < 3; ++axis) {
+        header.minBounds[axis] = minBounds[axis];
+        header.maxBounds[axis] = maxBounds[axis];
+    }
+    header.keyBytes = static_cast<uint32_t>(key.size());
+    
+    std::error_code error;
+    std::filesystem::create_directories(bakeDirectory, error);
+    std::string bakePath = getBakePath(key);
+    // Unique per process and thread, so concurrent writers of one bake never share a file
+    std::ostringstream tempSuffix;
+#ifdef _WIN32
+    tempSuffix << "." << _getpid();
+#else
+    tempSuffix << "." << getpid();
+#endif
+    tempSuffix << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    std::string tempPath = bakePath + tempSuffix.str();
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        const char padding[4] = {};
+        const std::vector<float>& grid = sdf.getGridData();
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(key.data(), key.size());
+        file.write(padding, getBakeDataOffset(key.size()) - sizeof(header) - key.size());
+        file.write(reinterpret_cast<const char*>(grid.data()), grid.size() * sizeof(float));
+        if (!file) {
+            std::cerr << "AssetCache: cannot write " << tempPath << std::endl;
+            return;
+        }
+    }
+    // Rename so concurrent runs never read a half-written bake
+    std::filesystem::rename(tempPath, bakePath, error);
+    if (error) {
+        std::cerr << "AssetCache: cannot write " << bakePath << ": " << error.message() << std::endl;
+    }
+}
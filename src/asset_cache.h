@@ -0,0 +1,50 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "collision_object.h"
+
+// Loads collision geometry once per asset key (see CollisionObject::makeAssetKey) and
+// hands out instances that share it. Checkpoints and scenes refer to geometry by key,
+// so restoring them only bakes assets the process has not loaded yet.
+//
+// With a bake directory set, baked SDF grids are also kept on disk and reused by later
+// runs while the source OBJ is unchanged, so a new process skips the bake as well.
+class AssetCache {
+public:
+    AssetCache();
+    
+    void setBakeDirectory(const std::string& directory) { bakeDirectory = directory; }
+    // Surface LODs extracted for each newly loaded asset (0 skips extraction)
+    void setSurfaceLodCount(int count) { surfaceLodCount = count; }
+    
+    // Returns the shared prototype for 'key', loading it on first use; null if it cannot be loaded.
+    // Safe to call from several threads; threads asking for a key that is being loaded wait
+    // for that load instead of starting their own.
+    std::shared_ptr<const CollisionObject> acquire(const std::string& key);
+    // Loads all missing keys, several assets at a time (duplicates are loaded once).
+    // Returns false if any of them failed.
+    bool preload(const std::vector<std::string>& keys);
+    // New object sharing the geometry for 'key', with default transform and mass
+    std::unique_ptr<CollisionObject> instantiate(const std::string& key);
+    // Registers geometry created elsewhere under its asset key
+    void add(std::shared_ptr<const CollisionObject> prototype);
+    
+    size_t size() const;
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const CollisionObject>> assets;
+    std::unordered_map<std::string, std::shared_future<std::shared_ptr<const CollisionObject>>> loading;
+    std::string bakeDirectory;
+    int surfaceLodCount;
+    
+    std::shared_ptr<CollisionObject> load(const std::string& key) const;
+    std::string getBakePath(const std::string& key) const;
+    bool loadBake(const std::string& key, const std::string& sourcePath, SDF& sdf) const;
+    void saveBake(const std::string& key, const std::string& sourcePath, const SDF& sdf) const;
+};
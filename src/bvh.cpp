@@ -4,6 +4,102 @@
 #include <iostream>
 #include <limits>
 
+static float pointTriangleDistance(const glm::vec3& point, const Triangle& tri) {
+    glm::vec3 edge0 = tri.v1 - tri.v0;
+    glm::vec3 edge1 = tri.v2 - tri.v0;
+    glm::vec3 v0 = tri.v0 - point;
+    
+    float a = glm::dot(edge0, edge0);
+    float b = glm::dot(edge0, edge1);
+    float c = glm::dot(edge1, edge1);
+    float d = glm::dot(edge0, v0);
+    float e = glm::dot(edge1, v0);
+    
+    float det = a * c - b * b;
+    float s = b * e - c * d;
+    float t = b * d - a * e;
+    
+    if (s + t < det) {
+        if (s < 0) {
+            if (t < 0) {
+                if (d < 0) {
+                    s = glm::clamp(-d / a, 0.0f, 1.0f);
+                    t = 0;
+                } else {
+                    s = 0;
+                    t = glm::clamp(-e / c, 0.0f, 1.0f);
+                }
+            } else {
+                s = 0;
+                t = glm::clamp(-e / c, 0.0f, 1.0f);
+            }
+        } else if (t < 0) {
+            s = glm::clamp(-d / a, 0.0f, 1.0f);
+            t = 0;
+        } else {
+            float invDet = 1 / det;
+            s *= invDet;
+            t *= invDet;
+        }
+    } else {
+        if (s < 0) {
+            float tmp0 = b + d;
+            float tmp1 = c + e;
+            if (tmp1 > tmp0) {
+                float numer = tmp1 - tmp0;
+                float denom = a - 2 * b + c;
+                s = glm::clamp(numer / denom, 0.0f, 1.0f);
+                t = 1 - s;
+            } else {
+                t = glm::clamp(-e / c, 0.0f, 1.0f);
+                s = 0;
+            }
+        } else if (t < 0) {
+            if (a + d > b + e) {
+                float numer = c + e - b - d;
+                float denom = a - 2 * b + c;
+                s = glm::clamp(numer / denom, 0.0f, 1.0f);
+                t = 1 - s;
+            } else {
+                s = glm::clamp(-d / a, 0.0f, 1.0f);
+                t = 0;
+            }
+        } else {
+            float numer = c + e - b - d;
+            float denom = a - 2 * b + c;
+            s = glm::clamp(numer / denom, 0.0f, 1.0f);
+            t = 1 - s;
+        }
+    }
+    
+    glm::vec3 closest = tri.v0 + s * edge0 + t * edge1;
+    return glm::length(point - closest);
+}
+
+// Moller-Trumbore test for a hit strictly in front of 'origin'
+static bool rayHitsTriangle(const glm::vec3& origin, const glm::vec3& direction, const Triangle& tri) {
+    glm::vec3 edge1 = tri.v1 - tri.v0;
+    glm::vec3 edge2 = tri.v2 - tri.v0;
+    glm::vec3 h = glm::cross(direction, edge2);
+    float a = glm::dot(edge1, h);
+    
+    if (a > -1e-7 && a < 1e-7) return false;
+    
+    float f = 1.0f / a;
+    glm::vec3 s = origin - tri.v0;
+    float u = f * glm::dot(s, h);
+    
+    if (u < 0.0f || u > 1.0f) return false;
+    
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = f * glm::dot(direction, q);
+    
+    if (v < 0.0f || u + v > 1.0f) return false;
+    
+    float t = f * glm::dot(edge2, q);
+    return t > 1e-7;
+}
+
 void BVH::build(const std::vector<Triangle>& triangles) {
     std::cout << "Building BVH for " << triangles.size() << " triangles..." << std::endl;
     
@@ -99,75 +195,7 @@ float BVH::findClosestDistanceRecursive(const glm::vec3& point, const std::vecto
             
             if (sphereDist >= minDist) continue;
             
-            glm::vec3 edge0 = tri.v1 - tri.v0;
-            glm::vec3 edge1 = tri.v2 - tri.v0;
-            glm::vec3 v0 = tri.v0 - point;
-            
-            float a = glm::dot(edge0, edge0);
-            float b = glm::dot(edge0, edge1);
-            float c = glm::dot(edge1, edge1);
-            float d = glm::dot(edge0, v0);
-            float e = glm::dot(edge1, v0);
-            
-            float det = a * c - b * b;
-            float s = b * e - c * d;
-            float t = b * d - a * e;
-            
-            if (s + t < det) {
-                if (s < 0) {
-                    if (t < 0) {
-                        if (d < 0) {
-                            s = glm::clamp(-d / a, 0.0f, 1.0f);
-                            t = 0;
-                        } else {
-                            s = 0;
-                            t = glm::clamp(-e / c, 0.0f, 1.0f);
-                        }
-                    } else {
-                        s = 0;
-                        t = glm::clamp(-e / c, 0.0f, 1.0f);
-                    }
-                } else if (t < 0) {
-                    s = glm::clamp(-d / a, 0.0f, 1.0f);
-                    t = 0;
-                } else {
-                    float invDet = 1 / det;
-                    s *= invDet;
-                    t *= invDet;
-                }
-            } else {
-                if (s < 0) {
-                    float tmp0 = b + d;
-                    float tmp1 = c + e;
-                    if (tmp1 > tmp0) {
-                        float numer = tmp1 - tmp0;
-                        float denom = a - 2 * b + c;
-                        s = glm::clamp(numer / denom, 0.0f, 1.0f);
-                        t = 1 - s;
-                    } else {
-                        t = glm::clamp(-e / c, 0.0f, 1.0f);
-                        s = 0;
-                    }
-                } else if (t < 0) {
-                    if (a + d > b + e) {
-                        float numer = c + e - b - d;
-                        float denom = a - 2 * b + c;
-                        s = glm::clamp(numer / denom, 0.0f, 1.0f);
-                        t = 1 - s;
-                    } else {
-                        s = glm::clamp(-d / a, 0.0f, 1.0f);
-                        t = 0;
-                    }
-                } else {
-                    float numer = c + e - b - d;
-                    float denom = a - 2 * b + c;
-                    s = glm::clamp(numer / denom, 0.0f, 1.0f);
-                    t = 1 - s;
-                }
-            }
-            
-            glm::vec3 closest = tri.v0 + s * edge0 + t * edge1;
-            float distance = glm::length(point - closest);
+            float distance = pointTriangleDistance(point, tri);
             minDist = std::min(minDist, distance);
         }
         bestDistance = std::min(bestDistance, minDist);
@@ -223,26 +251,7 @@ int BVH::countIntersectionsRecursive(const glm::vec3& point, const glm::vec3& di
         for (int idx : node->triangleIndices) {
             const Triangle& tri = triangles[idx];
             
-            glm::vec3 edge1 = tri.v1 - tri.v0;
-            glm::vec3 edge2 = tri.v2 - tri.v0;
-            glm::vec3 h = glm::cross(direction, edge2);
-            float a = glm::dot(edge1, h);
-            
-            if (a > -1e-7 && a < 1e-7) continue;
-            
-            float f = 1.0f / a;
-            glm::vec3 s = point - tri.v0;
-            float u = f * glm::dot(s, h);
-            
-            if (u < 0.0f || u > 1.0f) continue;
-            
-            glm::vec3 q = glm::cross(s, edge1);
-            float v = f * glm::dot(direction, q);
-            
-            if (v < 0.0f || u + v > 1.0f) continue;
-            
-            float t = f * glm::dot(edge2, q);
-            if (t > 1e-7) {
+            if (rayHitsTriangle(point, direction, tri)) {
                 intersections++;
             }
         }
@@ -268,3 +277,21 @@ bool BVH::rayAABBIntersect(const glm::vec3& origin, const glm::vec3& direction,
     
     return tNear <= tFar && tFar >= 0;
 }
+
+float bruteForceClosestDistance(const glm::vec3& point, const std::vector<Triangle>& triangles) {
+    float bestDistance = std::numeric_limits<float>::max();
+    for (const Triangle& tri : triangles) {
+        bestDistance = std::min(bestDistance, pointTriangleDistance(point, tri));
+    }
+    return bestDistance;
+}
+
+int bruteForceCountIntersections(const glm::vec3& point, const glm::vec3& direction, const std::vector<Triangle>& triangles) {
+    int intersections = 0;
+    for (const Triangle& tri : triangles) {
+        if (rayHitsTriangle(point, direction, tri)) {
+            intersections++;
+        }
+    }
+    return intersections;
+}
@@ -31,3 +31,7 @@ private:
     int countIntersectionsRecursive(const glm::vec3& point, const glm::vec3& direction, const std::vector<Triangle>& triangles, const BVHNode* node) const;
     bool rayAABBIntersect(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& minBounds, const glm::vec3& maxBounds) const;
 };
+
+// Reference versions that test every triangle, for validating and benchmarking the BVH
+float bruteForceClosestDistance(const glm::vec3& point, const std::vector<Triangle>& triangles);
+int bruteForceCountIntersections(const glm::vec3& point, const glm::vec3& direction, const std::vector<Triangle>& triangles);
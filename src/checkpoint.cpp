@@ -0,0 +1,333 @@
+#include "checkpoint.h"
+#include "asset_cache.h"
+#include "mapped_file.h"
+#include "simulation.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<Particle>::value, "checkpoints store particles as raw bytes");
+static_assert(sizeof(KillZone) == 6 * sizeof(float), "checkpoints store kill zones as raw bytes");
+static_assert(sizeof(SimulationCheckpoint::ContactRecord) == 28, "checkpoints store contacts as raw bytes");
+
+static const char CheckpointMagic[8] = {'S', 'D', 'F', 'C', 'K', 'P', 'T', '1'};
+static const uint32_t CheckpointVersion = 1;
+static const size_t ParticleAlignment = 16;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint32_t particleBytes;       // sizeof(Particle) of the writing build
+    uint32_t randomStateBytes;
+    uint64_t objectCount;
+    uint64_t particleCount;
+    uint64_t particleOffset;      // Start of the particle array
+    uint64_t stepCount;
+    double simulationTime;
+    uint64_t sleepingParticles;   // Leading particles that are asleep
+    uint64_t griddedSleepers;     // Leading sleepers in the sleep grid
+    uint64_t sleepGridRemoved;
+    uint64_t emitterCount;
+    uint64_t killZoneCount;
+    uint64_t particleCapacity;
+    uint64_t emittedParticles;
+    uint64_t killedParticles;
+    uint64_t droppedParticles;
+    uint64_t contactCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    float cflNumber;
+    float objectGravity[3];
+    float restitution;
+    int32_t maxAdaptiveSubsteps;
+    int32_t solverIterations;
+    float sleepVelocity;
+    uint32_t sleepSteps;
+    uint32_t reorderInterval;
+    uint8_t adaptiveSubstepping;
+    uint8_t perIslandSubstepping;
+    uint8_t particleSleeping;
+    uint8_t warmStarting;
+    uint8_t sleepGridDirty;
+    uint8_t reserved[3];
+};
+
+// Pose, velocity and mass of an object record, following its asset key
+static const size_t ObjectValues = 14;
+// Region, rate, velocity, speed, size and emission credit of an emitter
+static const size_t EmitterValues = 13;
+
+template <typename T>
+static void appendValue(std::vector<char>& out, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static bool readBytes(const MappedFile& file, size_t& offset, void* data, size_t size) {
+    if (size > file.size() - offset) {
+        return false;
+    }
+    std::memcpy(data, file.data() + offset, size);
+    offset += size;
+    return true;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool writeCheckpoint(const SimulationCheckpoint& checkpoint, const std::string& path, uint64_t* bytesWritten) {
+    // Everything before the particle array is small; build it in memory first
+    std::vector<char> prefix(sizeof(CheckpointHeader));
+    prefix.insert(prefix.end(), checkpoint.randomState.begin(), checkpoint.randomState.end());
+    for (const auto& object : checkpoint.objects) {
+        appendValue(prefix, static_cast<uint32_t>(object.assetKey.size()));
+        prefix.insert(prefix.end(), object.assetKey.begin(), object.assetKey.end());
+        float values[ObjectValues] = {
+            object.position.x, object.position.y, object.position.z,
+            object.rotation.w, object.rotation.x, object.rotation.y, object.rotation.z,
+            object.scale.x, object.scale.y, object.scale.z,
+            object.velocity.x, object.velocity.y, object.velocity.z,
+            object.mass
+        };
+        appendValue(prefix, values);
+    }
+    for (size_t i = 0; i < checkpoint.emitters.size(); ++i) {
+        const ParticleEmitter& emitter = checkpoint.emitters[i];
+        float values[EmitterValues] = {
+            emitter.regionMin.x, emitter.regionMin.y, emitter.regionMin.z,
+            emitter.regionMax.x, emitter.regionMax.y, emitter.regionMax.z,
+            emitter.rate, emitter.velocity.x, emitter.velocity.y, emitter.velocity.z,
+            emitter.speed, emitter.size,
+            i < checkpoint.emissionCredit.size() ? checkpoint.emissionCredit[i] : 0.0f
+        };
+        appendValue(prefix, values);
+    }
+    for (const auto& zone : checkpoint.killZones) {
+        appendValue(prefix, zone);
+    }
+    for (const auto& contact : checkpoint.contacts) {
+        appendValue(prefix, contact);
+    }
+    prefix.resize((prefix.size() + ParticleAlignment - 1) / ParticleAlignment * ParticleAlignment, 0);
+    
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, CheckpointMagic, sizeof(CheckpointMagic));
+    header.version = CheckpointVersion;
+    header.headerBytes = sizeof(CheckpointHeader);
+    header.particleBytes = sizeof(Particle);
+    header.randomStateBytes = static_cast<uint32_t>(checkpoint.randomState.size());
+    header.objectCount = checkpoint.objects.size();
+    header.particleCount = checkpoint.particles.size();
+    header.particleOffset = prefix.size();
+    header.stepCount = checkpoint.stepCount;
+    header.simulationTime = checkpoint.simulationTime;
+    for (int axis = 0; axis < 3; ++axis) {
+        header.boundsMin[axis] = checkpoint.boundsMin[axis];
+        header.boundsMax[axis] = checkpoint.boundsMax[axis];
+        header.objectGravity[axis] = checkpoint.objectGravity[axis];
+    }
+    header.cflNumber = checkpoint.cflNumber;
+    header.maxAdaptiveSubsteps = checkpoint.maxAdaptiveSubsteps;
+    header.adaptiveSubstepping = checkpoint.adaptiveSubstepping ? 1 : 0;
+    header.perIslandSubstepping = checkpoint.perIslandSubstepping ? 1 : 0;
+    header.particleSleeping = checkpoint.particleSleeping ? 1 : 0;
+    header.sleepVelocity = checkpoint.sleepVelocity;
+    header.sleepSteps = static_cast<uint32_t>(checkpoint.sleepSteps);
+    header.sleepingParticles = checkpoint.sleepingParticles;
+    header.griddedSleepers = checkpoint.griddedSleepers;
+    header.sleepGridRemoved = checkpoint.sleepGridRemoved;
+    header.sleepGridDirty = checkpoint.sleepGridDirty ? 1 : 0;
+    header.reorderInterval = static_cast<uint32_t>(checkpoint.reorderInterval);
+    header.solverIterations = checkpoint.solverIterations;
+    header.warmStarting = checkpoint.warmStarting ? 1 : 0;
+    header.restitution = checkpoint.restitution;
+    header.contactCount = checkpoint.contacts.size();
+    header.emitterCount = checkpoint.emitters.size();
+    header.killZoneCount = checkpoint.killZones.size();
+    header.particleCapacity = checkpoint.particleCapacity;
+    header.emittedParticles = checkpoint.flowStats.emitted;
+    header.killedParticles = checkpoint.flowStats.killed;
+    header.droppedParticles = checkpoint.flowStats.dropped;
+    std::memcpy(prefix.data(), &header, sizeof(header));
+    
+    // Write next to the target and rename, so a crash never leaves a truncated checkpoint behind
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(prefix.data(), prefix.size());
+        file.write(reinterpret_cast<const char*>(checkpoint.particles.data()), checkpoint.particles.size() * sizeof(Particle));
+        if (!file) {
+            std::cerr << "Checkpoint: cannot write " << tempPath << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::cerr << "Checkpoint: cannot write " << path << ": " << error.message() << std::endl;
+        return false;
+    }
+    
+    if (bytesWritten) {
+        *bytesWritten = prefix.size() + checkpoint.particles.size() * sizeof(Particle);
+    }
+    return true;
+}
+
+bool readCheckpoint(const std::string& path, SimulationCheckpoint& checkpoint) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    
+    CheckpointHeader header;
+    size_t offset = 0;
+    if (!readBytes(file, offset, &header, sizeof(header))
+        || std::memcmp(header.magic, CheckpointMagic, sizeof(CheckpointMagic)) != 0) {
+        std::cerr << "Checkpoint: " << path << " is not a checkpoint file" << std::endl;
+        return false;
+    }
+    if (header.version != CheckpointVersion) {
+        std::cerr << "Checkpoint: " << path << " has format version " << header.version
+                  << ", this build reads version " << CheckpointVersion << std::endl;
+        return false;
+    }
+    if (header.headerBytes != sizeof(CheckpointHeader) || header.particleBytes != sizeof(Particle)) {
+        std::cerr << "Checkpoint: " << path << " was written by an incompatible build (version "
+                  << header.version << ")" << std::endl;
+        return false;
+    }
+    
+    checkpoint.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    checkpoint.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    checkpoint.stepCount = header.stepCount;
+    checkpoint.simulationTime = header.simulationTime;
+    checkpoint.adaptiveSubstepping = header.adaptiveSubstepping != 0;
+    checkpoint.perIslandSubstepping = header.perIslandSubstepping != 0;
+    checkpoint.cflNumber = header.cflNumber;
+    checkpoint.maxAdaptiveSubsteps = header.maxAdaptiveSubsteps;
+    checkpoint.particleSleeping = header.particleSleeping != 0;
+    checkpoint.sleepVelocity = header.sleepVelocity;
+    checkpoint.sleepSteps = static_cast<int>(header.sleepSteps);
+    checkpoint.sleepingParticles = header.sleepingParticles;
+    checkpoint.griddedSleepers = header.griddedSleepers;
+    checkpoint.sleepGridRemoved = header.sleepGridRemoved;
+    checkpoint.sleepGridDirty = header.sleepGridDirty != 0;
+    checkpoint.reorderInterval = static_cast<int>(header.reorderInterval);
+    checkpoint.solverIterations = header.solverIterations;
+    checkpoint.warmStarting = header.warmStarting != 0;
+    checkpoint.restitution = header.restitution;
+    checkpoint.objectGravity = glm::vec3(header.objectGravity[0], header.objectGravity[1], header.objectGravity[2]);
+    checkpoint.particleCapacity = header.particleCapacity;
+    checkpoint.flowStats.emitted = header.emittedParticles;
+    checkpoint.flowStats.killed = header.killedParticles;
+    checkpoint.flowStats.dropped = header.droppedParticles;
+    
+    bool valid = true;
+    checkpoint.randomState.resize(header.randomStateBytes);
+    valid = valid && readBytes(file, offset, &checkpoint.randomState[0], header.randomStateBytes);
+    checkpoint.objects.resize(valid ? header.objectCount : 0);
+    for (auto& object : checkpoint.objects) {
+        uint32_t keyBytes = 0;
+        float values[ObjectValues];
+        valid = valid && readBytes(file, offset, &keyBytes, sizeof(keyBytes));
+        object.assetKey.resize(valid ? keyBytes : 0);
+        valid = valid && readBytes(file, offset, &object.assetKey[0], object.assetKey.size())
+            && readBytes(file, offset, values, sizeof(values));
+        if (!valid) {
+            break;
+        }
+        object.position = glm::vec3(values[0], values[1], values[2]);
+        object.rotation = glm::quat(values[3], values[4], values[5], values[6]);
+        object.scale = glm::vec3(values[7], values[8], values[9]);
+        object.velocity = glm::vec3(values[10], values[11], values[12]);
+        object.mass = values[13];
+    }
+    
+    // Fixed-size records: check the counts against the file before allocating
+    size_t emitterBytes = EmitterValues * sizeof(float);
+    valid = valid && header.emitterCount <= (file.size() - offset) / emitterBytes;
+    checkpoint.emitters.resize(valid ? header.emitterCount : 0);
+    checkpoint.emissionCredit.resize(checkpoint.emitters.size());
+    for (size_t i = 0; i < checkpoint.emitters.size() && valid; ++i) {
+        float values[EmitterValues];
+        valid = readBytes(file, offset, values, sizeof(values));
+        ParticleEmitter& emitter = checkpoint.emitters[i];
+        emitter.regionMin = glm::vec3(values[0], values[1], values[2]);
+        emitter.regionMax = glm::vec3(values[3], values[4], values[5]);
+        emitter.rate = values[6];
+        emitter.velocity = glm::vec3(values[7], values[8], values[9]);
+        emitter.speed = values[10];
+        emitter.size = values[11];
+        checkpoint.emissionCredit[i] = values[12];
+    }
+    valid = valid && header.killZoneCount <= (file.size() - offset) / sizeof(KillZone);
+    checkpoint.killZones.resize(valid ? header.killZoneCount : 0);
+    valid = valid && readBytes(file, offset, checkpoint.killZones.data(), checkpoint.killZones.size() * sizeof(KillZone));
+    valid = valid && header.contactCount <= (file.size() - offset) / sizeof(SimulationCheckpoint::ContactRecord);
+    checkpoint.contacts.resize(valid ? header.contactCount : 0);
+    valid = valid && readBytes(file, offset, checkpoint.contacts.data(),
+                               checkpoint.contacts.size() * sizeof(SimulationCheckpoint::ContactRecord));
+    
+    // The particle array is the bulk of the file: one straight copy out of the mapping
+    offset = header.particleOffset;
+    valid = valid && offset <= file.size()
+        && header.particleCount <= (file.size() - offset) / sizeof(Particle)
+        && header.sleepingParticles <= header.particleCount
+        && header.griddedSleepers <= header.sleepingParticles;
+    if (!valid) {
+        std::cerr << "Checkpoint: " << path << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+    checkpoint.particles.resize(header.particleCount);
+    std::memcpy(static_cast<void*>(checkpoint.particles.data()), file.data() + offset, header.particleCount * sizeof(Particle));
+    return true;
+}
+
+bool loadCheckpoint(const std::string& path, Simulation& simulation, AssetCache& assets) {
+    SimulationCheckpoint checkpoint;
+    return readCheckpoint(path, checkpoint) && simulation.restoreCheckpoint(checkpoint, assets);
+}
+
+CheckpointWriter::CheckpointWriter() : writing(false), succeeded(true) {
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    wait();
+}
+
+bool CheckpointWriter::save(const Simulation& simulation, const std::string& path) {
+    if (writing.load()) {
+        return false;
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+    
+    auto captureStart = std::chrono::steady_clock::now();
+    simulation.captureCheckpoint(checkpoint);
+    this->path = path;
+    stats = CheckpointStats();
+    stats.captureMs = elapsedMs(captureStart);
+    
+    writing.store(true);
+    thread = std::thread([this]() {
+        auto writeStart = std::chrono::steady_clock::now();
+        succeeded = writeCheckpoint(checkpoint, this->path, &stats.bytes);
+        stats.writeMs = elapsedMs(writeStart);
+        writing.store(false);
+    });
+    return true;
+}
+
+bool CheckpointWriter::wait() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+    return succeeded;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "particle.h"
+#include "simulation.h"
+
+class AssetCache;
+
+// Complete resumable state of a Simulation. Particles are kept verbatim; collision objects
+// refer to their geometry by asset key, so meshes and SDFs are never stored in checkpoints.
+struct SimulationCheckpoint {
+    struct ObjectRecord {
+        std::string assetKey;
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+        glm::vec3 velocity;
+        float mass;
+    };
+    
+    // One cached object contact point, kept so warm starting continues after a restore
+    struct ContactRecord {
+        uint32_t first;    // Object indices, first < second
+        uint32_t second;
+        glm::vec3 offset;  // Contact point relative to the first object
+        float impulse;
+        float deltaTime;   // Time step the impulse was solved for
+    };
+    
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    uint64_t stepCount = 0;
+    double simulationTime = 0.0;
+    bool adaptiveSubstepping = false;
+    bool perIslandSubstepping = true;
+    float cflNumber = 0.5f;
+    int maxAdaptiveSubsteps = 16;
+    bool particleSleeping = false;
+    float sleepVelocity = 0.01f;
+    int sleepSteps = 30;
+    size_t sleepingParticles = 0;  // Stored first in 'particles'
+    // Sleep grid bookkeeping: which sleepers it covers decides the order particles are woken in
+    size_t griddedSleepers = 0;
+    size_t sleepGridRemoved = 0;
+    bool sleepGridDirty = true;
+    int reorderInterval = 0;
+    int solverIterations = 8;
+    bool warmStarting = true;
+    float restitution = 1.0f;
+    glm::vec3 objectGravity = glm::vec3(0.0f);
+    size_t particleCapacity = 0;
+    std::vector<ParticleEmitter> emitters;
+    std::vector<float> emissionCredit;  // One per emitter
+    std::vector<KillZone> killZones;
+    ParticleFlowStats flowStats;
+    std::string randomState;
+    std::vector<ObjectRecord> objects;
+    std::vector<ContactRecord> contacts;  // Grouped by object pair
+    std::vector<Particle> particles;
+};
+
+// Checkpoint file layout: a fixed header (magic "SDFCKPT1", format version, sizeof(Particle),
+// scalar state and counts), the RNG state, one record per object (asset key plus pose,
+// velocity and mass), emitters with their fractional emission credit, kill zones, cached
+// object contacts, then the particle array as raw Particle structs at a 16-byte aligned
+// offset. Files are only portable between builds with the same Particle layout.
+bool writeCheckpoint(const SimulationCheckpoint& checkpoint, const std::string& path, uint64_t* bytesWritten = nullptr);
+// Maps 'path' and copies it into 'checkpoint', reusing its storage
+bool readCheckpoint(const std::string& path, SimulationCheckpoint& checkpoint);
+// Reads 'path' and restores it into 'simulation', instancing geometry through 'assets'
+bool loadCheckpoint(const std::string& path, Simulation& simulation, AssetCache& assets);
+
+// Timings of the last finished checkpoint
+struct CheckpointStats {
+    uint64_t bytes = 0;
+    double captureMs = 0.0;  // Copying the state on the calling thread
+    double writeMs = 0.0;    // Serializing and writing on the background thread
+};
+
+// Writes checkpoints on a background thread. save() only copies the simulation state
+// (essentially a memcpy of the particle array), so the caller can keep stepping while
+// the copy is written out.
+class CheckpointWriter {
+public:
+    CheckpointWriter();
+    ~CheckpointWriter();
+    
+    // Returns false without doing anything if the previous checkpoint is still being written
+    bool save(const Simulation& simulation, const std::string& path);
+    // Blocks until the current write finishes; returns whether the last write succeeded
+    bool wait();
+    bool isWriting() const { return writing.load(); }
+    // Valid once isWriting() is false
+    const CheckpointStats& getStats() const { return stats; }
+
+private:
+    SimulationCheckpoint checkpoint;  // Owned by the writer thread while 'writing' is set
+    std::string path;
+    std::thread thread;
+    std::atomic<bool> writing;
+    bool succeeded;
+    CheckpointStats stats;
+};
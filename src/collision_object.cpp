@@ -1,9 +1,34 @@
 #include "collision_object.h"
+#include "mesh_generator.h"
+#include "surface_extractor.h"
 #include <glm/gtc/matrix_inverse.hpp>
+#include <algorithm>
 #include <limits>
 
+// Cells per axis of the grid that thins mesh vertices into contact samples
+static const int ContactSampleCells = 16;
+
+// Keeps the first mesh vertex found in each occupied cell of a grid over the mesh bounds
+static std::shared_ptr<const std::vector<glm::vec3>> buildContactSamples(const Mesh& mesh) {
+    auto samples = std::make_shared<std::vector<glm::vec3>>();
+    glm::vec3 meshMin = mesh.getMin();
+    glm::vec3 cellScale = float(ContactSampleCells) / glm::max(mesh.getMax() - meshMin, glm::vec3(1e-6f));
+    std::vector<bool> occupied(ContactSampleCells * ContactSampleCells * ContactSampleCells, false);
+    for (const auto& triangle : mesh.getTriangles()) {
+        for (const glm::vec3& vertex : {triangle.v0, triangle.v1, triangle.v2}) {
+            glm::ivec3 cell = glm::clamp(glm::ivec3((vertex - meshMin) * cellScale), glm::ivec3(0), glm::ivec3(ContactSampleCells - 1));
+            int index = (cell.z * ContactSampleCells + cell.y) * ContactSampleCells + cell.x;
+            if (!occupied[index]) {
+                occupied[index] = true;
+                samples->push_back(vertex);
+            }
+        }
+    }
+    return samples;
+}
+
 CollisionObject::CollisionObject() 
-    : sdf(64), position(0.0f), rotation(1.0f, 0.0f, 0.0f, 0.0f), scale(1.0f), velocity(0.0f),
+    : position(0.0f), rotation(1.0f, 0.0f, 0.0f, 0.0f), scale(1.0f), velocity(0.0f),
       mass(0.0f), inverseMass(0.0f),  // Default to static object (infinite mass)
       transformMatrix(1.0f), inverseTransformMatrix(1.0f), transformDirty(true),
       meshLoaded(false), sdfGenerated(false) {
@@ -11,15 +36,24 @@ CollisionObject::CollisionObject()
 
 bool CollisionObject::loadFromOBJ(const std::string& filename, int sdfResolution) {
     // Load mesh
-    if (!mesh.loadOBJ(filename)) {
+    auto newMesh = std::make_shared<Mesh>();
+    if (!loadMeshFromPath(filename, *newMesh)) {
         meshLoaded = false;
         sdfGenerated = false;
         return false;
     }
-    meshLoaded = true;    // Generate SDF with specified resolution
-    sdf = SDF(sdfResolution);
-    sdf.generateFromMesh(mesh);
+    mesh = newMesh;
+    contactSamples = buildContactSamples(*mesh);
+    meshLoaded = true;
+    
+    // Generate SDF with specified resolution
+    auto newSdf = std::make_shared<SDF>(sdfResolution);
+    newSdf->generateFromMesh(*mesh);
+    sdf = newSdf;
     sdfGenerated = true;
+    surfaceLods.clear();
+    surfaceLodStats.clear();
+    assetKey = makeAssetKey(filename, sdfResolution);
     
     // Don't set default mass - let the user explicitly set it
     // Mass remains 0.0f (static) until explicitly set
@@ -30,6 +64,54 @@ bool CollisionObject::loadFromOBJ(const std::string& filename, int sdfResolution
     return true;
 }
 
+bool CollisionObject::buildSurfaceLods(int count) {
+    surfaceLods.clear();
+    surfaceLodStats.clear();
+    if (!sdfGenerated) {
+        return false;
+    }
+    
+    SurfaceExtractor extractor;
+    for (int level = 0; level < std::min(count, MaxSurfaceLods); ++level) {
+        auto lod = std::make_shared<Mesh>();
+        extractor.setLevel(level);
+        if (!extractor.extract(*sdf, *lod)) {
+            break;  // Too coarse to capture the surface
+        }
+        surfaceLods.push_back(lod);
+        surfaceLodStats.push_back(extractor.getStats());
+    }
+    return !surfaceLods.empty();
+}
+
+void CollisionObject::shareGeometry(const CollisionObject& source) {
+    mesh = source.mesh;
+    sdf = source.sdf;
+    surfaceLods = source.surfaceLods;
+    surfaceLodStats = source.surfaceLodStats;
+    contactSamples = source.contactSamples;
+    assetKey = source.assetKey;
+    meshLoaded = source.meshLoaded;
+    sdfGenerated = source.sdfGenerated;
+    transformDirty = true;
+}
+
+void CollisionObject::setGeometry(std::shared_ptr<const Mesh> mesh, std::shared_ptr<const SDF> sdf, const std::string& assetKey) {
+    this->mesh = mesh;
+    this->sdf = sdf;
+    this->assetKey = assetKey;
+    surfaceLods.clear();
+    surfaceLodStats.clear();
+    contactSamples = mesh ? buildContactSamples(*mesh) : nullptr;
+    meshLoaded = mesh != nullptr;
+    sdfGenerated = sdf != nullptr;
+    transformDirty = true;
+}
+
+std::string CollisionObject::makeAssetKey(const std::string& path, int sdfResolution) {
+    return path + "|" + std::to_string(sdfResolution);
+}
+
 void CollisionObject::setPosition(const glm::vec3& position) {
     this->position = position;
     transformDirty = true;
@@ -74,7 +156,7 @@ float CollisionObject::getSignedDistance(const glm::vec3& worldPosition) const {
     glm::vec3 localPos = worldToLocal(worldPosition);
     
     // Sample SDF in local space
-    float localDistance = sdf.sample(localPos);
+    float localDistance = sdf->sample(localPos);
     
     // Scale the distance by the minimum scale factor
     // This is an approximation - for non-uniform scaling, 
@@ -92,12 +174,20 @@ glm::vec3 CollisionObject::getNormal(const glm::vec3& worldPosition) const {
     glm::vec3 localPos = worldToLocal(worldPosition);
     
     // Get gradient (normal) in local space
-    glm::vec3 localNormal = sdf.gradient(localPos);
+    glm::vec3 localNormal = sdf->gradient(localPos);
     
     // Transform normal back to world space
     return transformNormal(localNormal);
 }
 
+float CollisionObject::getWorldCellSize() const {
+    if (!isValid()) {
+        return 0.0f;
+    }
+    glm::vec3 worldCell = sdf->getCellSize() * glm::abs(scale);
+    return std::min({worldCell.x, worldCell.y, worldCell.z});
+}
+
 glm::mat4 CollisionObject::getTransformMatrix() const {
     updateTransformCache();
     return transformMatrix;
@@ -114,8 +204,8 @@ glm::vec3 CollisionObject::getWorldMin() const {
     }
     
     // Get local bounds
-    glm::vec3 localMin = mesh.getMin();
-    glm::vec3 localMax = mesh.getMax();
+    glm::vec3 localMin = mesh->getMin();
+    glm::vec3 localMax = mesh->getMax();
     
     // Transform all 8 corners of the bounding box
     glm::mat4 transform = getTransformMatrix();
@@ -147,8 +237,8 @@ glm::vec3 CollisionObject::getWorldMax() const {
     }
     
     // Get local bounds
-    glm::vec3 localMin = mesh.getMin();
-    glm::vec3 localMax = mesh.getMax();
+    glm::vec3 localMin = mesh->getMin();
+    glm::vec3 localMax = mesh->getMax();
     
     // Transform all 8 corners of the bounding box
     glm::mat4 transform = getTransformMatrix();
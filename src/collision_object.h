@@ -5,8 +5,13 @@
 #include <glm/gtc/quaternion.hpp>
 #include <memory>
 #include <string>
+#include <vector>
 #include "mesh.h"
 #include "sdf.h"
+#include "surface_extractor.h"
+
+// Upper bound on meshes extracted from an object's SDF (see buildSurfaceLods)
+constexpr int MaxSurfaceLods = 4;
 
 class CollisionObject {
 public:
@@ -15,6 +20,14 @@ public:
     
     // Initialization
     bool loadFromOBJ(const std::string& filename, int sdfResolution = 64);
+    // Reuse another object's mesh and SDF instead of loading and baking a copy
+    void shareGeometry(const CollisionObject& source);
+    // Adopt geometry built elsewhere (e.g. an SDF restored from a bake cache)
+    void setGeometry(std::shared_ptr<const Mesh> mesh, std::shared_ptr<const SDF> sdf, const std::string& assetKey);
+    
+    // Identifies the geometry source so it can be re-created (see AssetCache); empty if unknown
+    const std::string& getAssetKey() const { return assetKey; }
+    static std::string makeAssetKey(const std::string& path, int sdfResolution);
     
     // Transform operations
     void setPosition(const glm::vec3& position);
@@ -38,8 +51,20 @@ public:
     bool isStatic() const { return mass <= 0.0f; }
     
     // Access to mesh and SDF
-    const Mesh& getMesh() const { return mesh; }
-    const SDF& getSDF() const { return sdf; }
+    const Mesh& getMesh() const { return *mesh; }
+    const SDF& getSDF() const { return *sdf; }
+    
+    // Extracts 'count' meshes from the SDF: level 0 at full grid resolution (what the SDF
+    // actually contains), each further level at half the resolution of the previous one
+    bool buildSurfaceLods(int count = MaxSurfaceLods);
+    int getSurfaceLodCount() const { return static_cast<int>(surfaceLods.size()); }
+    const Mesh& getSurfaceLod(int level) const { return *surfaceLods[level]; }
+    // Size and extraction time of each LOD, for tools to report
+    const SurfaceExtractionStats& getSurfaceLodStats(int level) const { return surfaceLodStats[level]; }
+    
+    // Surface points in local space, about one per cell of a coarse grid over the mesh,
+    // tested against other objects' SDFs to find object contacts (valid objects only)
+    const std::vector<glm::vec3>& getContactSamples() const { return *contactSamples; }
     
     // Collision detection
     float getSignedDistance(const glm::vec3& worldPosition) const;
@@ -52,13 +77,20 @@ public:
     // Bounds in world space
     glm::vec3 getWorldMin() const;
     glm::vec3 getWorldMax() const;
+    // Smallest SDF cell edge in world units (the finest feature the field resolves)
+    float getWorldCellSize() const;
     
     // Validation
     bool isValid() const { return meshLoaded && sdfGenerated; }
     
 private:
-    Mesh mesh;
-    SDF sdf;
+    // Geometry is immutable once loaded and may be shared between instances
+    std::shared_ptr<const Mesh> mesh;
+    std::shared_ptr<const SDF> sdf;
+    std::vector<std::shared_ptr<const Mesh>> surfaceLods;
+    std::vector<SurfaceExtractionStats> surfaceLodStats;  // One per surface LOD
+    std::shared_ptr<const std::vector<glm::vec3>> contactSamples;
+    std::string assetKey;
     
     // Transform properties
     glm::vec3 position;
@@ -0,0 +1,26 @@
+#include "contact_buffer.h"
+#include <algorithm>
+
+void ContactBuffer::reserve(size_t capacity) {
+    if (capacity <= firstIds.size()) {
+        return;
+    }
+    firstIds.resize(capacity);
+    secondIds.resize(capacity);
+    points.resize(capacity);
+    normals.resize(capacity);
+    depths.resize(capacity);
+}
+
+void ContactBuffer::append(const ContactBuffer& other) {
+    size_t offset = count;
+    if (offset + other.count > firstIds.size()) {
+        reserve(std::max(offset + other.count, firstIds.size() * 2));
+    }
+    std::copy(other.firstIds.begin(), other.firstIds.begin() + other.count, firstIds.begin() + offset);
+    std::copy(other.secondIds.begin(), other.secondIds.begin() + other.count, secondIds.begin() + offset);
+    std::copy(other.points.begin(), other.points.begin() + other.count, points.begin() + offset);
+    std::copy(other.normals.begin(), other.normals.begin() + other.count, normals.begin() + offset);
+    std::copy(other.depths.begin(), other.depths.begin() + other.count, depths.begin() + offset);
+    count += other.count;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Contacts written by a detection pass and read by a resolution pass, stored as separate
+// arrays so each pass only streams the fields it uses. Storage only grows: clear() keeps
+// it, so a buffer reused every step stops allocating once it has seen the largest step.
+class ContactBuffer {
+public:
+    void clear() { count = 0; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    void reserve(size_t capacity);
+    
+    // 'normal' points from the second body towards the first; 'depth' is the overlap
+    void add(uint32_t first, uint32_t second, const glm::vec3& point, const glm::vec3& normal, float depth) {
+        if (count == firstIds.size()) {
+            reserve(count < 64 ? 64 : count * 2);
+        }
+        firstIds[count] = first;
+        secondIds[count] = second;
+        points[count] = point;
+        normals[count] = normal;
+        depths[count] = depth;
+        count++;
+    }
+    // Appends all contacts of 'other' in order
+    void append(const ContactBuffer& other);
+    
+    uint32_t getFirst(size_t i) const { return firstIds[i]; }
+    uint32_t getSecond(size_t i) const { return secondIds[i]; }
+    const glm::vec3& getPoint(size_t i) const { return points[i]; }
+    const glm::vec3& getNormal(size_t i) const { return normals[i]; }
+    float getDepth(size_t i) const { return depths[i]; }
+
+private:
+    // Sized to the capacity; entries from 'count' on are unused
+    std::vector<uint32_t> firstIds;
+    std::vector<uint32_t> secondIds;
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec3> normals;
+    std::vector<float> depths;
+    size_t count = 0;
+};
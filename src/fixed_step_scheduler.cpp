@@ -0,0 +1,50 @@
+#include "fixed_step_scheduler.h"
+#include <algorithm>
+#include <cmath>
+
+FixedStepScheduler::FixedStepScheduler(float stepsPerSecond, int maxSubsteps)
+    : accumulator(0.0), droppedSteps(0), executedSteps(0) {
+    setStepRate(stepsPerSecond);
+    setMaxSubsteps(maxSubsteps);
+}
+
+void FixedStepScheduler::setStepRate(float stepsPerSecond) {
+    stepRate = std::max(stepsPerSecond, 1.0f);
+    stepSize = 1.0f / stepRate;
+}
+
+void FixedStepScheduler::setMaxSubsteps(int maxSubsteps) {
+    this->maxSubsteps = std::max(maxSubsteps, 1);
+}
+
+int FixedStepScheduler::advance(double elapsedSeconds) {
+    accumulator += std::max(elapsedSeconds, 0.0);
+    
+    double dueSteps = std::floor(accumulator / stepSize);
+    int steps = static_cast<int>(std::min(dueSteps, static_cast<double>(maxSubsteps)));
+    accumulator -= steps * static_cast<double>(stepSize);
+    
+    // Too far behind: discard whole steps beyond the substep budget, keep the fraction
+    if (accumulator >= stepSize) {
+        double excess = std::floor(accumulator / stepSize);
+        droppedSteps += static_cast<uint64_t>(excess);
+        accumulator -= excess * stepSize;
+    }
+    
+    executedSteps += steps;
+    return steps;
+}
+
+float FixedStepScheduler::getInterpolationAlpha() const {
+    return static_cast<float>(accumulator / stepSize);
+}
+
+double FixedStepScheduler::getTimeUntilNextStep() const {
+    return std::max(0.0, stepSize - accumulator);
+}
+
+void FixedStepScheduler::reset() {
+    accumulator = 0.0;
+    droppedSteps = 0;
+    executedSteps = 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+// Converts elapsed real time into a whole number of fixed-size simulation steps.
+// Leftover time is carried in an accumulator; when a frame would need more than
+// maxSubsteps steps the excess is dropped (and counted) instead of letting the
+// simulation fall further and further behind.
+class FixedStepScheduler {
+public:
+    FixedStepScheduler(float stepsPerSecond = 120.0f, int maxSubsteps = 8);
+    
+    void setStepRate(float stepsPerSecond);
+    float getStepRate() const { return stepRate; }
+    float getStepSize() const { return stepSize; }
+    
+    void setMaxSubsteps(int maxSubsteps);
+    int getMaxSubsteps() const { return maxSubsteps; }
+    
+    // Adds elapsed real time and returns how many fixed steps to run now
+    int advance(double elapsedSeconds);
+    
+    // Fraction of a step left in the accumulator [0, 1)
+    float getInterpolationAlpha() const;
+    // Real time until the next step is due
+    double getTimeUntilNextStep() const;
+    
+    uint64_t getDroppedSteps() const { return droppedSteps; }
+    uint64_t getExecutedSteps() const { return executedSteps; }
+    
+    void reset();
+
+private:
+    float stepRate;
+    float stepSize;
+    int maxSubsteps;
+    double accumulator;
+    uint64_t droppedSteps;
+    uint64_t executedSteps;
+};
@@ -0,0 +1,212 @@
+#include "frame_capture.h"
+#include "image_io.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+FrameCapture::FrameCapture()
+    : width(0), height(0), active(false), oldestReadback(0), pendingReadbacks(0),
+      framesCaptured(0), framesDropped(0), framesQueued(0), maxQueuedFrames(8), stopping(false), framesWritten(0) {
+}
+
+FrameCapture::~FrameCapture() {
+    stop();
+}
+
+bool FrameCapture::start(int width, int height, const std::string& directory, int bufferCount, size_t maxQueuedFrames) {
+    stop();
+    
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "FrameCapture: cannot create directory " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+    
+    this->width = width;
+    this->height = height;
+    this->directory = directory;
+    this->maxQueuedFrames = std::max<size_t>(maxQueuedFrames, 1);
+    
+    // One pixel-pack buffer per in-flight frame, allocated once
+    GLsizeiptr frameBytes = static_cast<GLsizeiptr>(width) * height * 4;
+    readbacks.resize(std::max(bufferCount, 2));
+    for (auto& readback : readbacks) {
+        glGenBuffers(1, &readback.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+        readback.fence = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    oldestReadback = 0;
+    pendingReadbacks = 0;
+    framesCaptured = 0;
+    framesDropped = 0;
+    framesQueued = 0;
+    framesWritten = 0;
+    stopping = false;
+    active = true;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+    return true;
+}
+
+void FrameCapture::stop() {
+    if (!active) {
+        return;
+    }
+    
+    // Flush the frames still on the GPU; blocking is fine at shutdown
+    collect(true);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_one();
+    writer.join();
+    
+    for (auto& readback : readbacks) {
+        if (readback.fence) {
+            glDeleteSync(readback.fence);
+        }
+        glDeleteBuffers(1, &readback.buffer);
+    }
+    readbacks.clear();
+    queue.clear();
+    freeBuffers.clear();
+    active = false;
+}
+
+void FrameCapture::capture() {
+    if (!active) {
+        return;
+    }
+    
+    collect(false);
+    
+    // Every buffer is still in flight: the GPU is behind, so skip this frame instead of waiting
+    if (pendingReadbacks == static_cast<int>(readbacks.size())) {
+        framesDropped++;
+        return;
+    }
+    
+    int slot = (oldestReadback + pendingReadbacks) % static_cast<int>(readbacks.size());
+    Readback& readback = readbacks[slot];
+    
+    // With a pack buffer bound, glReadPixels only records the copy and returns immediately
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    
+    pendingReadbacks++;
+    framesCaptured++;
+}
+
+void FrameCapture::collect(bool wait) {
+    size_t frameBytes = static_cast<size_t>(width) * height * 4;
+    
+    // Collect in submission order so the image sequence stays ordered
+    while (pendingReadbacks > 0) {
+        Readback& readback = readbacks[oldestReadback];
+        GLenum result = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (wait && result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);  // 1 ms
+        }
+        if (result == GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        
+        // Reuse pixel storage released by the writer; drop the frame if the writer is backed up
+        std::vector<unsigned char> pixels;
+        bool queueFull;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queueFull = !wait && queue.size() >= maxQueuedFrames;
+            if (!queueFull && !freeBuffers.empty()) {
+                pixels = std::move(freeBuffers.back());
+                freeBuffers.pop_back();
+            }
+        }
+        
+        if (queueFull) {
+            framesDropped++;
+        } else {
+            pixels.resize(frameBytes);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(frameBytes), GL_MAP_READ_BIT);
+            if (mapped) {
+                std::memcpy(pixels.data(), mapped, frameBytes);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            
+            if (mapped) {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_back(Frame{ framesQueued++, std::move(pixels) });
+            } else {
+                framesDropped++;
+            }
+            condition.notify_one();
+        }
+        
+        oldestReadback = (oldestReadback + 1) % static_cast<int>(readbacks.size());
+        pendingReadbacks--;
+    }
+}
+
+void FrameCapture::writerLoop() {
+    std::vector<unsigned char> rgb;
+    
+    while (true) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;  // Stopping and fully drained
+            }
+            frame = std::move(queue.front());
+            queue.pop_front();
+        }
+        
+        if (writeFrame(frame, rgb)) {
+            framesWritten++;
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        freeBuffers.push_back(std::move(frame.pixels));
+    }
+}
+
+bool FrameCapture::writeFrame(const Frame& frame, std::vector<unsigned char>& rgb) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06llu.ppm", static_cast<unsigned long long>(frame.index));
+    std::string path = (std::filesystem::path(directory) / name).string();
+    
+    // GL rows start at the bottom; image rows start at the top and have no alpha
+    rgb.resize(static_cast<size_t>(width) * height * 3);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* src = frame.pixels.data() + static_cast<size_t>(height - 1 - y) * width * 4;
+        unsigned char* dst = rgb.data() + static_cast<size_t>(y) * width * 3;
+        for (int x = 0; x < width; ++x) {
+            dst[x * 3 + 0] = src[x * 4 + 0];
+            dst[x * 3 + 1] = src[x * 4 + 1];
+            dst[x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+    return writePPM(path, width, height, rgb.data());
+}
+
+FrameCaptureStats FrameCapture::getStats() const {
+    FrameCaptureStats stats;
+    stats.framesCaptured = framesCaptured;
+    stats.framesWritten = framesWritten.load();
+    stats.framesDropped = framesDropped;
+    return stats;
+}
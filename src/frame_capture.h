@@ -0,0 +1,77 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Capture counters since start()
+struct FrameCaptureStats {
+    uint64_t framesCaptured = 0;  // Readbacks issued on the GPU
+    uint64_t framesWritten = 0;   // Images encoded and written to disk
+    uint64_t framesDropped = 0;   // Skipped because the GPU or the writer fell behind
+};
+
+// Records the rendered frames as a numbered PPM image sequence without blocking the
+// render loop. glReadPixels goes into a ring of pixel-pack buffers and is fenced, and
+// each buffer is only mapped a few frames later once its fence has signalled. The
+// pixels are then handed to a writer thread that encodes and saves them. If the GPU or
+// the disk falls behind, frames are dropped and counted rather than waited for.
+class FrameCapture {
+public:
+    FrameCapture();
+    ~FrameCapture();
+    
+    // Creates 'directory' if needed and starts the writer thread (requires a current GL context)
+    bool start(int width, int height, const std::string& directory, int bufferCount = 3, size_t maxQueuedFrames = 8);
+    // Waits for outstanding readbacks and writes, then releases GL resources
+    void stop();
+    bool isActive() const { return active; }
+    
+    // Queues a readback of the currently bound read framebuffer; call after drawing
+    void capture();
+    
+    FrameCaptureStats getStats() const;
+
+private:
+    struct Readback {
+        GLuint buffer;
+        GLsync fence;  // Null when the buffer holds no pending frame
+    };
+    
+    struct Frame {
+        uint64_t index;
+        std::vector<unsigned char> pixels;  // Bottom-up RGBA rows as read from GL
+    };
+    
+    int width, height;
+    std::string directory;
+    bool active;
+    
+    // Render thread state
+    std::vector<Readback> readbacks;
+    int oldestReadback;    // Next buffer to collect
+    int pendingReadbacks;
+    uint64_t framesCaptured;
+    uint64_t framesDropped;
+    uint64_t framesQueued;  // Next image number; dropped frames leave no gaps in the sequence
+    
+    // Writer thread state, guarded by mutex
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Frame> queue;
+    std::vector<std::vector<unsigned char>> freeBuffers;  // Recycled pixel storage
+    size_t maxQueuedFrames;
+    bool stopping;
+    std::atomic<uint64_t> framesWritten;
+    
+    void collect(bool wait);
+    void writerLoop();
+    bool writeFrame(const Frame& frame, std::vector<unsigned char>& rgb) const;
+};
@@ -0,0 +1,15 @@
+#include "image_io.h"
+#include <fstream>
+#include <iostream>
+
+bool writePPM(const std::string& path, int width, int height, const unsigned char* rgb) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot write image " << path << std::endl;
+        return false;
+    }
+    
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(rgb), static_cast<std::streamsize>(width) * height * 3);
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string>
+
+// Writes an 8-bit RGB image with rows ordered top to bottom as a binary PPM (P6) file
+bool writePPM(const std::string& path, int width, int height, const unsigned char* rgb);
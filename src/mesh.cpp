@@ -146,9 +146,6 @@ bool Mesh::loadOBJ(const std::string& filename) {
     std::cout << "Mesh::loadOBJ - Bounds computed. Min: (" << minBounds.x << "," << minBounds.y << "," << minBounds.z 
               << "), Max: (" << maxBounds.x << "," << maxBounds.y << "," << maxBounds.z << ")" << std::endl; // Added log
     
-    setupMesh(); // Setup VAO/VBO/EBO after loading data
-    std::cout << "Mesh::loadOBJ - Mesh setup for rendering complete." << std::endl; // Added log
-    
     std::cout << "Loaded mesh with " << loaded_vertices_local.size() << " raw input vertices, " 
               << this->vertices_for_rendering.size() << " unique rendering vertices, and " 
               << triangles.size() << " triangles (for SDF), "
@@ -157,7 +154,35 @@ bool Mesh::loadOBJ(const std::string& filename) {
     return true;
 }
 
-void Mesh::setupMesh() {
+void Mesh::setGeometry(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices) {
+    vertices_for_rendering = vertices;
+    indices_for_rendering = indices;
+    
+    triangles.clear();
+    triangles.reserve(indices.size() / 3);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        Triangle tri;
+        tri.v0 = vertices[indices[i]];
+        tri.v1 = vertices[indices[i + 1]];
+        tri.v2 = vertices[indices[i + 2]];
+        // Extracted surfaces can contain slivers; keep their normal finite
+        glm::vec3 cross = glm::cross(tri.v1 - tri.v0, tri.v2 - tri.v0);
+        float length = glm::length(cross);
+        tri.normal = length > 0.0f ? cross / length : glm::vec3(0.0f);
+        triangles.push_back(tri);
+    }
+    computeBounds();
+    
+    if (meshSetupDone) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+        meshSetupDone = false;
+    }
+}
+
+void Mesh::setupMesh() const {
     std::cout << "Mesh::setupMesh - Setting up VAO/VBO/EBO." << std::endl; // Added log
     if (vertices_for_rendering.empty() || indices_for_rendering.empty()) {
         std::cerr << "Cannot setup mesh: No vertex or index data." << std::endl;
@@ -187,14 +212,40 @@ void Mesh::setupMesh() {
 
 void Mesh::draw() const {
     if (!meshSetupDone) {
-        std::cerr << "Mesh not setup for drawing!" << std::endl;
-        return;
+        setupMesh();
+        if (!meshSetupDone) {
+            return;
+        }
     }
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices_for_rendering.size()), GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
 }
 
+void Mesh::drawInstanced(GLuint instanceBuffer, GLintptr offset, int instanceCount) const {
+    if (!meshSetupDone) {
+        setupMesh();
+        if (!meshSetupDone) {
+            return;
+        }
+    }
+    glBindVertexArray(VAO);
+    
+    // A mat4 attribute occupies four consecutive vec4 locations
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (int column = 0; column < 4; ++column) {
+        GLuint location = 2 + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices_for_rendering.size()), GL_UNSIGNED_INT, 0, instanceCount);
+    glBindVertexArray(0);
+}
+
 void Mesh::computeBounds() {
     if (triangles.empty()) return;
     
@@ -16,22 +16,30 @@ public:
     ~Mesh(); // Destructor
 
     bool loadOBJ(const std::string& filename);
+    // Replaces the geometry with an indexed triangle list (e.g. extracted from an SDF).
+    // GPU buffers are rebuilt on the next draw; call with the GL context current if already drawn.
+    void setGeometry(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
     const std::vector<Triangle>& getTriangles() const { return triangles; }
     glm::vec3 getMin() const { return minBounds; }
     glm::vec3 getMax() const { return maxBounds; }
 
     void draw() const; // Drawing method
+    // Instanced draw; per-instance model matrices (mat4) are read from attribute
+    // locations 2-5 of 'instanceBuffer' starting at byte 'offset'
+    void drawInstanced(GLuint instanceBuffer, GLintptr offset, int instanceCount) const;
+    int getIndexCount() const { return static_cast<int>(indices_for_rendering.size()); }
     
 private:
-    void setupMesh(); // Helper to setup VAO/VBO/EBO
+    // Uploads VAO/VBO/EBO on first draw, so meshes can be loaded without a GL context
+    void setupMesh() const;
     std::vector<Triangle> triangles; // For SDF
     glm::vec3 minBounds, maxBounds;
     
     // For rendering
     std::vector<glm::vec3> vertices_for_rendering;
     std::vector<unsigned int> indices_for_rendering;
-    GLuint VAO, VBO, EBO;
-    bool meshSetupDone;
+    mutable GLuint VAO, VBO, EBO;
+    mutable bool meshSetupDone;
 
     void computeBounds();
     glm::vec3 computeTriangleNormal(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
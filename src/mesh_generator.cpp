@@ -0,0 +1,250 @@
+#include "mesh_generator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+
+static const char* ProceduralPrefix = "procedural:";
+static const float Pi = 3.14159265358979f;
+
+static void addQuad(std::vector<unsigned int>& indices, unsigned int a, unsigned int b, unsigned int c, unsigned int d) {
+    indices.insert(indices.end(), {a, b, c, a, c, d});
+}
+
+static int getMinimumTessellation(ProceduralShape shape) {
+    switch (shape) {
+        case ProceduralShape::Sphere: return 2;
+        case ProceduralShape::Torus: return 3;
+        default: return 1;
+    }
+}
+
+static size_t getTriangleCount(ProceduralShape shape, size_t n) {
+    switch (shape) {
+        case ProceduralShape::Sphere: return 4 * n * (n - 1);
+        case ProceduralShape::Torus: return 4 * n * n;
+        case ProceduralShape::Plate: return 4 * n * n + 8 * n;
+        default: return 12 * n * n;
+    }
+}
+
+static void generateSphere(int n, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices) {
+    const float radius = 0.5f;
+    int segments = 2 * n, rings = n;
+    
+    // North pole, rings - 1 latitude rings, south pole
+    vertices.push_back(glm::vec3(0.0f, radius, 0.0f));
+    for (int ring = 1; ring < rings; ++ring) {
+        float theta = Pi * ring / rings;
+        for (int segment = 0; segment < segments; ++segment) {
+            float phi = 2.0f * Pi * segment / segments;
+            vertices.push_back(radius * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+        }
+    }
+    vertices.push_back(glm::vec3(0.0f, -radius, 0.0f));
+    
+    auto ringVertex = [segments](int ring, int segment) {
+        return static_cast<unsigned int>(1 + (ring - 1) * segments + segment % segments);
+    };
+    unsigned int southPole = static_cast<unsigned int>(vertices.size() - 1);
+    for (int segment = 0; segment < segments; ++segment) {
+        indices.insert(indices.end(), {0u, ringVertex(1, segment + 1), ringVertex(1, segment)});
+        for (int ring = 1; ring < rings - 1; ++ring) {
+            addQuad(indices, ringVertex(ring, segment), ringVertex(ring, segment + 1),
+                    ringVertex(ring + 1, segment + 1), ringVertex(ring + 1, segment));
+        }
+        indices.insert(indices.end(), {southPole, ringVertex(rings - 1, segment), ringVertex(rings - 1, segment + 1)});
+    }
+}
+
+static void generateTorus(int n, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices) {
+    const float majorRadius = 0.35f, minorRadius = 0.15f;
+    int majorSegments = 2 * n, minorSegments = n;
+    
+    for (int i = 0; i < majorSegments; ++i) {
+        float phi = 2.0f * Pi * i / majorSegments;
+        for (int j = 0; j < minorSegments; ++j) {
+            float theta = 2.0f * Pi * j / minorSegments;
+            float ringRadius = majorRadius + minorRadius * std::cos(theta);
+            vertices.push_back(glm::vec3(ringRadius * std::cos(phi), minorRadius * std::sin(theta), ringRadius * std::sin(phi)));
+        }
+    }
+    
+    auto vertex = [majorSegments, minorSegments](int i, int j) {
+        return static_cast<unsigned int>((i % majorSegments) * minorSegments + j % minorSegments);
+    };
+    for (int i = 0; i < majorSegments; ++i) {
+        for (int j = 0; j < minorSegments; ++j) {
+            addQuad(indices, vertex(i, j), vertex(i, j + 1), vertex(i + 1, j + 1), vertex(i + 1, j));
+        }
+    }
+}
+
+// Surface of a box of cells.x * cells.y * cells.z lattice cells. 'place' maps lattice
+// coordinates normalized to [0, 1] to positions, so the same lattice gives the cube, the
+// blob and the plate. Points on shared edges and corners are emitted once.
+static void generateBoxLattice(const glm::ivec3& cells, const std::function<glm::vec3(const glm::vec3&)>& place,
+                               std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices) {
+    std::unordered_map<uint64_t, unsigned int> latticeVertex;
+    auto vertex = [&](const glm::ivec3& point) {
+        uint64_t key = (static_cast<uint64_t>(point.x) * (cells.y + 1) + point.y) * (cells.z + 1) + point.z;
+        auto it = latticeVertex.find(key);
+        if (it != latticeVertex.end()) {
+            return it->second;
+        }
+        unsigned int index = static_cast<unsigned int>(vertices.size());
+        vertices.push_back(place(glm::vec3(float(point.x) / cells.x, float(point.y) / cells.y, float(point.z) / cells.z)));
+        latticeVertex.emplace(key, index);
+        return index;
+    };
+    
+    for (int axis = 0; axis < 3; ++axis) {
+        // (u, v) follow 'axis' cyclically, so u x v points along +axis
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for (int side = 0; side < 2; ++side) {
+            for (int i = 0; i < cells[u]; ++i) {
+                for (int j = 0; j < cells[v]; ++j) {
+                    glm::ivec3 corner[4];
+                    const int du[4] = {0, 1, 1, 0};
+                    const int dv[4] = {0, 0, 1, 1};
+                    for (int k = 0; k < 4; ++k) {
+                        corner[k][axis] = side * cells[axis];
+                        corner[k][u] = i + du[k];
+                        corner[k][v] = j + dv[k];
+                    }
+                    if (side == 1) {
+                        addQuad(indices, vertex(corner[0]), vertex(corner[1]), vertex(corner[2]), vertex(corner[3]));
+                    } else {
+                        addQuad(indices, vertex(corner[0]), vertex(corner[3]), vertex(corner[2]), vertex(corner[1]));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Smooth radial displacement in [-0.13, 0.13], fixed so blobs are identical between runs
+static float blobBumps(const glm::vec3& direction) {
+    return 0.06f * std::sin(glm::dot(glm::vec3(3.0f, 1.0f, 2.0f), direction) * 2.0f + 0.3f)
+         + 0.04f * std::sin(glm::dot(glm::vec3(-2.0f, 4.0f, 1.0f), direction) * 2.0f + 1.7f)
+         + 0.03f * std::sin(glm::dot(glm::vec3(1.0f, -3.0f, 5.0f), direction) * 2.0f + 4.1f);
+}
+
+const char* getProceduralShapeName(ProceduralShape shape) {
+    switch (shape) {
+        case ProceduralShape::Sphere: return "sphere";
+        case ProceduralShape::Torus: return "torus";
+        case ProceduralShape::Cube: return "cube";
+        case ProceduralShape::Blob: return "blob";
+        case ProceduralShape::Plate: return "plate";
+    }
+    return "unknown";
+}
+
+bool parseProceduralShape(const std::string& name, ProceduralShape& shape) {
+    for (ProceduralShape candidate : {ProceduralShape::Sphere, ProceduralShape::Torus, ProceduralShape::Cube,
+                                      ProceduralShape::Blob, ProceduralShape::Plate}) {
+        if (name == getProceduralShapeName(candidate)) {
+            shape = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+int getTessellationForTriangles(ProceduralShape shape, size_t targetTriangles) {
+    int minimum = getMinimumTessellation(shape);
+    // Every shape grows with n^2; start from the leading term and check the neighbours
+    double leading = getTriangleCount(shape, 1000) / 1e6;
+    int estimate = std::max(minimum, static_cast<int>(std::sqrt(targetTriangles / leading)));
+    int best = estimate;
+    for (int n = std::max(minimum, estimate - 1); n <= estimate + 1; ++n) {
+        auto distance = [&](int level) {
+            size_t count = getTriangleCount(shape, level);
+            return count > targetTriangles ? count - targetTriangles : targetTriangles - count;
+        };
+        if (distance(n) < distance(best)) {
+            best = n;
+        }
+    }
+    return best;
+}
+
+void generateProceduralMesh(ProceduralShape shape, int tessellation,
+                            std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices) {
+    int n = std::max(tessellation, getMinimumTessellation(shape));
+    vertices.clear();
+    indices.clear();
+    indices.reserve(getTriangleCount(shape, n) * 3);
+    
+    switch (shape) {
+        case ProceduralShape::Sphere:
+            generateSphere(n, vertices, indices);
+            break;
+        case ProceduralShape::Torus:
+            generateTorus(n, vertices, indices);
+            break;
+        case ProceduralShape::Cube:
+            generateBoxLattice(glm::ivec3(n), [](const glm::vec3& unit) {
+                return unit - glm::vec3(0.5f);
+            }, vertices, indices);
+            break;
+        case ProceduralShape::Blob:
+            generateBoxLattice(glm::ivec3(n), [](const glm::vec3& unit) {
+                glm::vec3 direction = glm::normalize(unit * 2.0f - glm::vec3(1.0f));
+                return direction * (0.4f * (1.0f + blobBumps(direction)));
+            }, vertices, indices);
+            break;
+        case ProceduralShape::Plate:
+            generateBoxLattice(glm::ivec3(n, 1, n), [](const glm::vec3& unit) {
+                return glm::vec3(unit.x - 0.5f, (unit.y - 0.5f) * 0.02f, unit.z - 0.5f);
+            }, vertices, indices);
+            break;
+    }
+}
+
+void generateProceduralMesh(ProceduralShape shape, int tessellation, Mesh& mesh) {
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    generateProceduralMesh(shape, tessellation, vertices, indices);
+    mesh.setGeometry(vertices, indices);
+}
+
+bool isProceduralMeshPath(const std::string& path) {
+    return path.compare(0, std::strlen(ProceduralPrefix), ProceduralPrefix) == 0;
+}
+
+bool parseProceduralMeshPath(const std::string& path, ProceduralShape& shape, int& tessellation) {
+    if (!isProceduralMeshPath(path)) {
+        return false;
+    }
+    std::string spec = path.substr(std::strlen(ProceduralPrefix));
+    size_t split = spec.find(':');
+    if (split == std::string::npos || !parseProceduralShape(spec.substr(0, split), shape)) {
+        return false;
+    }
+    tessellation = std::atoi(spec.c_str() + split + 1);
+    return tessellation >= getMinimumTessellation(shape);
+}
+
+std::string makeProceduralMeshPath(ProceduralShape shape, int tessellation) {
+    return std::string(ProceduralPrefix) + getProceduralShapeName(shape) + ":" + std::to_string(tessellation);
+}
+
+bool loadMeshFromPath(const std::string& path, Mesh& mesh) {
+    if (!isProceduralMeshPath(path)) {
+        return mesh.loadOBJ(path);
+    }
+    ProceduralShape shape;
+    int tessellation = 0;
+    if (!parseProceduralMeshPath(path, shape, tessellation)) {
+        std::cerr << "Invalid procedural mesh '" << path << "', expected procedural:<shape>:<tessellation>" << std::endl;
+        return false;
+    }
+    generateProceduralMesh(shape, tessellation, mesh);
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "mesh.h"
+
+// Closed procedural meshes for benchmarks and tests, so they can sweep triangle counts without
+// external data. Every shape fits in a unit cube centered on the origin, is watertight with
+// shared vertices, and winds its triangles counter-clockwise seen from outside.
+enum class ProceduralShape {
+    Sphere,  // UV sphere, 2n segments x n rings: 4n(n - 1) triangles
+    Torus,   // Ring of radius 0.35 and tube radius 0.15, 2n x n quads: 4n^2 triangles
+    Cube,    // Each face split into n x n quads: 12n^2 triangles
+    Blob,    // Cube-sphere with smooth pseudo-random bumps: 12n^2 triangles
+    Plate    // 1 x 0.02 x 1 slab split into n x n quads on the large faces: 4n^2 + 8n triangles
+};
+
+const char* getProceduralShapeName(ProceduralShape shape);
+bool parseProceduralShape(const std::string& name, ProceduralShape& shape);
+
+// Tessellation level n whose triangle count is closest to 'targetTriangles'
+int getTessellationForTriangles(ProceduralShape shape, size_t targetTriangles);
+
+void generateProceduralMesh(ProceduralShape shape, int tessellation,
+                            std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices);
+void generateProceduralMesh(ProceduralShape shape, int tessellation, Mesh& mesh);
+
+// Procedural meshes can stand in for OBJ paths (e.g. in asset keys and scene files) using
+// the form "procedural:<shape>:<tessellation>", for example "procedural:torus:64"
+bool isProceduralMeshPath(const std::string& path);
+bool parseProceduralMeshPath(const std::string& path, ProceduralShape& shape, int& tessellation);
+std::string makeProceduralMeshPath(ProceduralShape shape, int tessellation);
+// Generates the mesh for a procedural path and loads any other path as an OBJ file
+bool loadMeshFromPath(const std::string& path, Mesh& mesh);
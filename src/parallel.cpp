@@ -0,0 +1,350 @@
+#include "parallel.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+struct Task {
+    std::function<void()> function;
+    TaskGroup* group;
+};
+
+// Deque of one worker (or of the threads outside the pool). The owner pushes and pops
+// at the back; thieves take from the front, where the oldest and usually largest tasks are.
+struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Task*> tasks;
+    
+    void push(Task* task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+    
+    Task* pop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) {
+            return nullptr;
+        }
+        Task* task = tasks.back();
+        tasks.pop_back();
+        return task;
+    }
+    
+    Task* steal() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) {
+            return nullptr;
+        }
+        Task* task = tasks.front();
+        tasks.pop_front();
+        return task;
+    }
+};
+
+class ThreadPool;
+
+// Failed attempts to find a task before a waiting thread goes to sleep
+const int WaitSpinCount = 64;
+
+// Index of the current thread's queue in its pool; -1 on threads outside the pool
+thread_local int workerIndex = -1;
+thread_local ThreadPool* workerPool = nullptr;
+
+class ThreadPool {
+public:
+    ThreadPool(int threadCount, bool pinThreads) : queues(std::max(threadCount, 1)), stopping(false),
+                                                   queuedTasks(0), sleepingWorkers(0), sleepingWaiters(0) {
+        // queues[0] takes tasks from threads outside the pool; workers own the others
+        for (int i = 1; i < threadCount; ++i) {
+            workers.emplace_back([this, i, pinThreads]() { workerLoop(i, pinThreads); });
+        }
+    }
+    
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    
+    int getThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+    
+    void submit(Task* task) {
+        int index = workerPool == this ? workerIndex : 0;
+        queues[index].push(task);
+        queuedTasks.fetch_add(1);
+        if (sleepingWorkers.load() > 0) {
+            // Taking the lock orders this wake-up after a sleeper's check of queuedTasks
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wakeCondition.notify_one();
+        }
+    }
+    
+    // Runs one queued task on the calling thread; false if there was none
+    bool runOneTask() {
+        Task* task = findTask(workerPool == this ? workerIndex : 0);
+        if (!task) {
+            return false;
+        }
+        execute(task);
+        return true;
+    }
+    
+    // Sleeps until 'pending' drops to zero or there is a task to run. Sleeping waiters
+    // count as sleeping workers, so submit() wakes them for new work too.
+    void sleepUntilDone(const std::atomic<int>& pending) {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        sleepingWaiters.fetch_add(1);
+        wakeCondition.wait(lock, [this, &pending]() { return pending.load() == 0 || queuedTasks.load() > 0; });
+        sleepingWaiters.fetch_sub(1);
+        sleepingWorkers.fetch_sub(1);
+    }
+
+private:
+    std::vector<WorkQueue> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    bool stopping;
+    std::atomic<int> queuedTasks;
+    std::atomic<int> sleepingWorkers;
+    std::atomic<int> sleepingWaiters;  // Threads in sleepUntilDone
+    
+    Task* findTask(int index) {
+        if (queuedTasks.load() == 0) {
+            return nullptr;
+        }
+        Task* task = queues[index].pop();
+        // Steal round-robin starting after our own queue, so thieves spread over victims
+        for (size_t offset = 1; !task && offset < queues.size(); ++offset) {
+            task = queues[(index + offset) % queues.size()].steal();
+        }
+        if (task) {
+            queuedTasks.fetch_sub(1);
+        }
+        return task;
+    }
+    
+    void execute(Task* task) {
+        task->function();
+        TaskGroup* group = task->group;
+        delete task;
+        // The group may be destroyed as soon as its last task finishes, so only the pool is
+        // touched afterwards. Waiters check their group under the lock, as sleepers do in submit.
+        if (group->finishTask() && sleepingWaiters.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wakeCondition.notify_all();
+        }
+    }
+    
+    // Pins the calling thread to the index-th CPU it is allowed to run on (wrapping around),
+    // so restricted CPU sets such as taskset or container limits are respected
+    static bool pinToCpu(int index) {
+#ifdef __linux__
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return false;
+        }
+        int allowedCount = CPU_COUNT(&allowed);
+        if (allowedCount == 0) {
+            return false;
+        }
+        int target = index % allowedCount;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+            }
+        }
+        return false;
+#else
+        (void)index;
+        return true;  // Pinning is a hint; silently unsupported elsewhere
+#endif
+    }
+    
+    void workerLoop(int index, bool pinThreads) {
+        workerIndex = index;
+        workerPool = this;
+        if (pinThreads && !pinToCpu(index)) {
+            std::cerr << "Failed to pin worker thread " << index << " to a CPU" << std::endl;
+        }
+        for (;;) {
+            if (runOneTask()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepingWorkers.fetch_add(1);
+            wakeCondition.wait(lock, [this]() { return stopping || queuedTasks.load() > 0; });
+            sleepingWorkers.fetch_sub(1);
+            if (stopping) {
+                return;
+            }
+        }
+    }
+};
+
+std::mutex poolMutex;
+std::unique_ptr<ThreadPool> pool;
+int requestedThreadCount = 0;  // 0 = SDF_NUM_THREADS or hardware concurrency
+bool threadAffinity = false;
+
+int getDefaultThreadCount() {
+    if (const char* value = std::getenv("SDF_NUM_THREADS")) {
+        int count = std::atoi(value);
+        if (count > 0) {
+            return count;
+        }
+    }
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+ThreadPool& getPool() {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (!pool) {
+        int count = requestedThreadCount > 0 ? requestedThreadCount : getDefaultThreadCount();
+        pool = std::make_unique<ThreadPool>(count, threadAffinity);
+    }
+    return *pool;
+}
+
+} // namespace
+
+int getParallelThreadCount() {
+    return getPool().getThreadCount();
+}
+
+void setParallelThreadCount(int count) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    requestedThreadCount = count;
+    pool.reset();
+}
+
+void setParallelThreadAffinity(bool enabled) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    threadAffinity = enabled;
+    pool.reset();
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    ThreadPool& threadPool = getPool();
+    if (threadPool.getThreadCount() == 1) {
+        task();
+        return;
+    }
+    pending.fetch_add(1, std::memory_order_relaxed);
+    threadPool.submit(new Task{std::move(task), this});
+}
+
+void TaskGroup::wait() {
+    if (pending.load(std::memory_order_acquire) == 0) {
+        return;
+    }
+    ThreadPool& threadPool = getPool();
+    int spins = 0;
+    while (pending.load(std::memory_order_acquire) > 0) {
+        // Help instead of blocking; this is what lets a task wait for nested work
+        if (threadPool.runOneTask()) {
+            spins = 0;
+        } else if (++spins < WaitSpinCount) {
+            std::this_thread::yield();
+        } else {
+            // The remaining tasks are running elsewhere; sleep rather than burn a core
+            threadPool.sleepUntilDone(pending);
+            spins = 0;
+        }
+    }
+}
+
+int TaskGraph::addTask(std::function<void()> task, std::initializer_list<int> dependencies) {
+    int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    nodes.back().task = std::move(task);
+    for (int dependency : dependencies) {
+        nodes[dependency].successors.push_back(index);
+        nodes.back().dependencyCount++;
+    }
+    return index;
+}
+
+void TaskGraph::run() {
+    for (auto& node : nodes) {
+        node.remaining.store(node.dependencyCount, std::memory_order_relaxed);
+    }
+    TaskGroup group;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].dependencyCount == 0) {
+            start(static_cast<int>(i), group);
+        }
+    }
+    group.wait();
+}
+
+void TaskGraph::start(int index, TaskGroup& group) {
+    group.run([this, index, &group]() {
+        Node& node = nodes[index];
+        node.task();
+        // The last dependency to finish starts the successor
+        for (int successor : node.successors) {
+            if (nodes[successor].remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                start(successor, group);
+            }
+        }
+    });
+}
+
+void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    grainSize = std::max<size_t>(grainSize, 1);
+    size_t chunkCount = (count + grainSize - 1) / grainSize;
+    
+    // Small loops and single-threaded pools run inline
+    int threadCount = getParallelThreadCount();
+    if (chunkCount == 1 || threadCount == 1) {
+        for (size_t begin = 0; begin < count; begin += grainSize) {
+            body(begin, std::min(begin + grainSize, count));
+        }
+        return;
+    }
+    
+    // Helper tasks and the caller claim chunks from a shared counter until none are left.
+    // Helpers that only start after the loop is done (e.g. stolen late) return at once.
+    std::atomic<size_t> nextChunk(0);
+    auto processChunks = [&]() {
+        for (;;) {
+            size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= chunkCount) {
+                break;
+            }
+            size_t begin = chunk * grainSize;
+            body(begin, std::min(begin + grainSize, count));
+        }
+    };
+    TaskGroup group;
+    size_t helpers = std::min(chunkCount, static_cast<size_t>(threadCount)) - 1;
+    for (size_t i = 0; i < helpers; ++i) {
+        group.run(processChunks);
+    }
+    processChunks();
+    group.wait();
+}
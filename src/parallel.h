@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+// Shared work-stealing pool for the whole library. Threads are created once on first use
+// and reused, so per-frame passes do not pay thread start-up costs, and every subsystem
+// draws from the same threads instead of starting its own. Each worker keeps a deque of
+// tasks: it runs its newest task first and idle workers steal the oldest ones. Threads
+// that wait for tasks run queued work meanwhile, so parallel loops and task groups nest.
+
+// Number of threads (including the caller) that work is spread over
+int getParallelThreadCount();
+// Resizes the pool; 1 runs everything serially on the calling thread. 0 restores the
+// default: the SDF_NUM_THREADS environment variable if set, else the hardware concurrency.
+// Must not be called while parallel work is running.
+void setParallelThreadCount(int count);
+// Pins each worker to its own logical CPU out of those the process may run on, leaving
+// the first one to the thread that drives the pool. Recreates the pool; only implemented
+// on Linux.
+void setParallelThreadAffinity(bool enabled);
+
+// Calls body(begin, end) over [0, count) in chunks of at most grainSize elements.
+// Blocks until every chunk has finished.
+void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+// Tasks that are waited for together. With a single-threaded pool run() executes the task
+// immediately. The destructor waits for outstanding tasks.
+class TaskGroup {
+public:
+    TaskGroup() : pending(0) {}
+    ~TaskGroup() { wait(); }
+    
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    
+    void run(std::function<void()> task);
+    // Returns once every task started through this group has finished, running queued
+    // tasks on the calling thread while it waits
+    void wait();
+    
+    // Called by the pool when one of this group's tasks has finished; true for the last one
+    bool finishTask() { return pending.fetch_sub(1) == 1; }
+
+private:
+    std::atomic<int> pending;
+};
+
+// Small dependency graph of tasks. run() starts every task whose dependencies have
+// finished, so independent tasks run concurrently. A graph can be run repeatedly.
+class TaskGraph {
+public:
+    // Returns the new task's id; dependencies are ids of tasks added earlier
+    int addTask(std::function<void()> task, std::initializer_list<int> dependencies = {});
+    void run();
+
+private:
+    struct Node {
+        std::function<void()> task;
+        std::vector<int> successors;
+        int dependencyCount = 0;
+        std::atomic<int> remaining{0};
+        
+        Node() = default;
+        Node(Node&& other) : task(std::move(other.task)), successors(std::move(other.successors)),
+                             dependencyCount(other.dependencyCount) {}
+    };
+    
+    std::vector<Node> nodes;
+    
+    void start(int index, TaskGroup& group);
+};
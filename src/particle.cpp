@@ -1,11 +1,15 @@
 #include "particle.h"
-#include <random>
+#include "parallel.h"
+#include "random.h"
+#include <algorithm>
 #include <cmath>
+#include <random>
+#include <sstream>
 
-Particle::Particle() : position(0.0f), velocity(0.0f), size(0.05f), mass(1.0f), inverseMass(1.0f) {}
+Particle::Particle() : position(0.0f), velocity(0.0f), size(0.05f), mass(1.0f), inverseMass(1.0f), restSteps(0) {}
 
 Particle::Particle(const glm::vec3& position, const glm::vec3& velocity, float size, float mass)
-    : position(position), velocity(velocity), size(size) {
+    : position(position), velocity(velocity), size(size), restSteps(0) {
     setMass(mass);
 }
 
@@ -22,18 +26,63 @@ void Particle::update(float deltaTime) {
     position += velocity * deltaTime;
 }
 
-ParticleSystem::ParticleSystem(int numParticles) : numParticles(numParticles) {
+static uint64_t makeRandomSeed() {
+    std::random_device device;
+    return (static_cast<uint64_t>(device()) << 32) | device();
+}
+
+ParticleSystem::ParticleSystem(int numParticles) : numParticles(numParticles), capacity(0), randomSeed(makeRandomSeed()), spawnedCount(0) {
     particles.reserve(numParticles);
 }
 
-void ParticleSystem::initialize(const glm::vec3& boxMin, const glm::vec3& boxMax, float speed) {
+void ParticleSystem::initialize(const glm::vec3& boxMin, const glm::vec3& boxMax, float speed, float size) {
+    int count = numParticles;
     particles.clear();
-    particles.reserve(numParticles);
-      for (int i = 0; i < numParticles; ++i) {
-        glm::vec3 pos = getRandomPosition(boxMin, boxMax);
-        glm::vec3 vel = getRandomDirection() * speed;
-        float particleMass = 1.0f;  // Default particle mass
-        particles.emplace_back(pos, vel, 0.05f, particleMass);
+    addParticles(count, boxMin, boxMax, speed, size);
+}
+
+int ParticleSystem::addParticles(int count, const glm::vec3& boxMin, const glm::vec3& boxMax, float speed, float size,
+                                 const glm::vec3& baseVelocity) {
+    count = std::max(count, 0);
+    if (capacity > 0) {
+        count = static_cast<int>(std::min<size_t>(count, capacity - std::min(capacity, particles.size())));
+    }
+    size_t first = particles.size();
+    uint64_t firstIndex = spawnedCount;
+    particles.resize(first + count);
+    glm::vec3 extent = boxMax - boxMin;
+    uint64_t seed = randomSeed;
+    parallelFor(count, 16384, [&](size_t begin, size_t end) {
+        Particle* out = particles.data() + first;
+        for (size_t i = begin; i < end; ++i) {
+            // Separate statements: the draw order must not depend on argument evaluation order
+            RandomStream random(seed, firstIndex + i);
+            float x = random.nextFloat();
+            float y = random.nextFloat();
+            float z = random.nextFloat();
+            float u = random.nextFloat();
+            float v = random.nextFloat();
+            glm::vec3 position = boxMin + extent * glm::vec3(x, y, z);
+            out[i] = Particle(position, baseVelocity + uniformSphereDirection(u, v) * speed, size, 1.0f);
+        }
+    });
+    spawnedCount += count;
+    numParticles = static_cast<int>(particles.size());
+    return count;
+}
+
+void ParticleSystem::removeParticle(size_t index) {
+    if (index + 1 < particles.size()) {
+        particles[index] = particles.back();
+    }
+    particles.pop_back();
+    numParticles = static_cast<int>(particles.size());
+}
+
+void ParticleSystem::setCapacity(size_t maxParticles) {
+    capacity = maxParticles;
+    if (capacity > 0) {
+        particles.reserve(capacity);
     }
 }
 
@@ -49,25 +98,19 @@ void ParticleSystem::setParticleSize(float size) {
     }
 }
 
-glm::vec3 ParticleSystem::getRandomDirection() const {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
-    
-    glm::vec3 direction;
-    do {
-        direction = glm::vec3(dis(gen), dis(gen), dis(gen));
-    } while (glm::length(direction) > 1.0f || glm::length(direction) < 0.1f);
-    
-    return glm::normalize(direction);
+std::string ParticleSystem::getRandomState() const {
+    std::ostringstream stream;
+    stream << randomSeed << " " << spawnedCount;
+    return stream.str();
 }
 
-glm::vec3 ParticleSystem::getRandomPosition(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_real_distribution<float> disX(boxMin.x, boxMax.x);
-    static std::uniform_real_distribution<float> disY(boxMin.y, boxMax.y);
-    static std::uniform_real_distribution<float> disZ(boxMin.z, boxMax.z);
-    
-    return glm::vec3(disX(gen), disY(gen), disZ(gen));
+bool ParticleSystem::setRandomState(const std::string& state) {
+    std::istringstream stream(state);
+    uint64_t seed = 0, spawned = 0;
+    if (!(stream >> seed >> spawned) || !(stream >> std::ws).eof()) {
+        return false;
+    }
+    randomSeed = seed;
+    spawnedCount = spawned;
+    return true;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
 #include <vector>
 
 class Particle {
@@ -15,11 +17,14 @@ public:
     float getSize() const { return size; }
     float getMass() const { return mass; }
     float getInverseMass() const { return inverseMass; }
+    // Consecutive steps spent below the simulation's sleep velocity
+    uint32_t getRestSteps() const { return restSteps; }
     
     void setPosition(const glm::vec3& pos) { position = pos; }
     void setVelocity(const glm::vec3& vel) { velocity = vel; }
     void setSize(float s) { size = s; }
     void setMass(float m);
+    void setRestSteps(uint32_t steps) { restSteps = steps; }
     
 private:
     glm::vec3 position;
@@ -27,23 +32,43 @@ private:
     float size;
     float mass;
     float inverseMass;  // Cached for performance
+    uint32_t restSteps;
 };
 
 class ParticleSystem {
 public:
     ParticleSystem(int numParticles = 100);
     
-    void initialize(const glm::vec3& boxMin, const glm::vec3& boxMax, float speed = 2.0f);
+    void initialize(const glm::vec3& boxMin, const glm::vec3& boxMax, float speed = 2.0f, float size = 0.05f);
+    // Appends 'count' particles at random positions in the box, moving at 'baseVelocity' plus
+    // 'speed' in a random direction. Each particle's values depend only on the seed and its
+    // spawn index, so spawning is parallel and gives the same particles for any thread count
+    // or split into batches. Stops at the capacity; returns the number added.
+    int addParticles(int count, const glm::vec3& boxMin, const glm::vec3& boxMax, float speed, float size,
+                     const glm::vec3& baseVelocity = glm::vec3(0.0f));
+    // Removes a particle in O(1) by moving the last particle into its slot
+    void removeParticle(size_t index);
     void update(float deltaTime);
     
     const std::vector<Particle>& getParticles() const { return particles; }
     std::vector<Particle>& getParticles() { return particles; }
     void setParticleSize(float size);
+    void setParticleCount(int count) { numParticles = count; }
+    // Upper bound on live particles, reserved up front so that spawning and removing during a
+    // run never reallocates; 0 = no limit
+    void setCapacity(size_t capacity);
+    size_t getCapacity() const { return capacity; }
+    
+    // Seed for new particles; restarts the spawn index. Taken from std::random_device unless set.
+    void setSeed(uint64_t seed) { randomSeed = seed; spawnedCount = 0; }
+    // Serialized seed and spawn index, so a restored run spawns the same particles
+    std::string getRandomState() const;
+    bool setRandomState(const std::string& state);
     
 private:
     std::vector<Particle> particles;
     int numParticles;
-    
-    glm::vec3 getRandomDirection() const;
-    glm::vec3 getRandomPosition(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+    size_t capacity;
+    uint64_t randomSeed;
+    uint64_t spawnedCount;  // Particles spawned since the seed was set; the next one's stream index
 };
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Counter-based random numbers. A stream is a pure function of (seed, stream index), so
+// element i of a batch can be drawn on any thread and in any order with the same result,
+// and no generator state has to be shared between threads.
+
+// SplitMix64 finalizer: a bijective 64-bit mix
+inline uint64_t mixBits(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+// SplitMix64 sequence starting at a point derived from the seed and the stream index.
+// Cheap to construct, so one stream per particle is fine.
+class RandomStream {
+public:
+    RandomStream(uint64_t seed, uint64_t stream) : state(mixBits(seed) ^ mixBits(stream * 0xD1B54A32D192ED03ull + 1)) {}
+
+    uint64_t nextUInt64() {
+        state += 0x9E3779B97F4A7C15ull;
+        return mixBits(state);
+    }
+
+    // Uniform in [0, 1), from the top 24 bits
+    float nextFloat() { return static_cast<float>(nextUInt64() >> 40) * (1.0f / 16777216.0f); }
+
+private:
+    uint64_t state;
+};
+
+// Uniform direction on the unit sphere from two uniforms in [0, 1), without rejection
+inline glm::vec3 uniformSphereDirection(float u, float v) {
+    float z = 1.0f - 2.0f * u;
+    float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    float phi = 6.28318531f * v;
+    return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
@@ -1,6 +1,9 @@
 #include "renderer.h"
+#include "parallel.h"
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <functional>
 
 // Define M_PI if not defined (Windows compatibility)
 #ifndef M_PI
@@ -12,9 +15,12 @@ const char* vertexShaderSource = R"(
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
@@ -33,7 +39,51 @@ void main() {
 }
 )";
 
-Renderer::Renderer(int width, int height) : width(width), height(height), window(nullptr) {
+// Instanced particle vertex shader: the unit sphere is scaled and translated per instance
+const char* particleVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aInstance; // xyz = position, w = radius
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+
+void main() {
+    vec3 worldPos = aInstance.xyz + aPos * aInstance.w;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
+)";
+
+// Uniform buffer binding point shared by every program's Camera block
+static const GLuint CameraBindingPoint = 0;
+
+// Instanced mesh vertex shader: one model matrix per instance
+const char* meshInstanceVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in mat4 aModel;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+
+void main() {
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+}
+)";
+
+Renderer::Renderer(int width, int height) : width(width), height(height), window(nullptr),
+    offscreen(false), offscreenFBO(0), offscreenColor(0), offscreenDepth(0),
+    flatModelLoc(-1), flatColorLoc(-1), particleColorLoc(-1), meshInstanceColorLoc(-1), cameraUBO(0), currentProgram(0),
+    boxVAO(0), boxVBO(0), boxEBO(0), sphereVAO(0), sphereVBO(0), sphereEBO(0),
+    particleInstancing(true), meshLods(true), showSdfSurface(false), frustumCulling(true) {
+    for (auto& lod : sphereLods) {
+        lod.indexCount = 0;
+        lod.firstIndex = 0;
+    }
     viewMatrix = glm::mat4(1.0f);
     projectionMatrix = glm::mat4(1.0f);
     
@@ -60,14 +110,7 @@ bool Renderer::initialize() {
         return false;
     }
     
-    // Configure GLFW
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    
-    // Create window
-    window = glfwCreateWindow(width, height, "SDF Collision Simulation", nullptr, nullptr);
-    if (!window) {
+    if (!createWindow()) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
         return false;
@@ -75,12 +118,17 @@ bool Renderer::initialize() {
     
     glfwMakeContextCurrent(window);
     
-    // Initialize GLEW
+    // Initialize GLEW (experimental flag is required to load extensions in a core profile)
+    glewExperimental = GL_TRUE;
     if (glewInit() != GLEW_OK) {
         std::cerr << "Failed to initialize GLEW" << std::endl;
         return false;
     }
     
+    if (offscreen && !createOffscreenFramebuffer()) {
+        return false;
+    }
+    
     // Set viewport
     glViewport(0, 0, width, height);
     
@@ -111,14 +159,73 @@ bool Renderer::initialize() {
     return true;
 }
 
+bool Renderer::createWindow() {
+    // Configure GLFW
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, offscreen ? GLFW_FALSE : GLFW_TRUE);
+    
+    // Create window
+    window = glfwCreateWindow(width, height, "SDF Collision Simulation", nullptr, nullptr);
+    
+    return window != nullptr;
+}
+
+bool Renderer::createOffscreenFramebuffer() {
+    glGenRenderbuffers(1, &offscreenColor);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    
+    glGenRenderbuffers(1, &offscreenDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    
+    glGenFramebuffers(1, &offscreenFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth);
+    
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+        return false;
+    }
+    
+    // Stays bound for the lifetime of the renderer: all drawing and readback go through it
+    return true;
+}
+
+bool Renderer::startCapture(const std::string& directory) {
+    if (!frameCapture.start(width, height, directory)) {
+        return false;
+    }
+    std::cout << "Capturing frames to " << directory << std::endl;
+    return true;
+}
+
 void Renderer::cleanup() {
+    frameCapture.stop();
     if (boxVAO) glDeleteVertexArrays(1, &boxVAO);
     if (boxVBO) glDeleteBuffers(1, &boxVBO);
     if (boxEBO) glDeleteBuffers(1, &boxEBO);
     if (sphereVAO) glDeleteVertexArrays(1, &sphereVAO);
     if (sphereVBO) glDeleteBuffers(1, &sphereVBO);
     if (sphereEBO) glDeleteBuffers(1, &sphereEBO);
-    if (shaderProgram) glDeleteProgram(shaderProgram);
+    particleStream.destroy();
+    meshInstanceStream.destroy();
+    if (cameraUBO) glDeleteBuffers(1, &cameraUBO);
+    flatShader.destroy();
+    particleShader.destroy();
+    meshInstanceShader.destroy();
+    boxVAO = boxVBO = boxEBO = 0;
+    sphereVAO = sphereVBO = sphereEBO = 0;
+    cameraUBO = 0;
+    if (offscreenFBO) glDeleteFramebuffers(1, &offscreenFBO);
+    if (offscreenColor) glDeleteRenderbuffers(1, &offscreenColor);
+    if (offscreenDepth) glDeleteRenderbuffers(1, &offscreenDepth);
+    offscreenFBO = offscreenColor = offscreenDepth = 0;
     
     if (window) {
         glfwDestroyWindow(window);
@@ -128,18 +235,35 @@ void Renderer::cleanup() {
 }
 
 void Renderer::beginFrame() {
+    stats = RenderStats();
+    currentProgram = 0;
     handleMouseInput();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    
+    // View and projection are uploaded once per frame and shared by all programs
+    glm::mat4 camera[2] = { viewMatrix, projectionMatrix };
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(camera), camera);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    
+    frustum = Frustum(projectionMatrix * viewMatrix);
 }
 
 void Renderer::endFrame() {
-    glfwSwapBuffers(window);
+    // Reads the offscreen framebuffer, or the back buffer before it is presented
+    frameCapture.capture();
+    
+    if (offscreen) {
+        glFlush();
+    } else {
+        glfwSwapBuffers(window);
+    }
     glfwPollEvents();
 }
 
 void Renderer::drawWireframeBox(const glm::vec3& min, const glm::vec3& max) {
-    glUseProgram(shaderProgram);
+    useProgram(flatShader);
     
     // Create transformation matrix to scale and translate the unit box
     glm::vec3 center = (min + max) * 0.5f;
@@ -150,20 +274,14 @@ void Renderer::drawWireframeBox(const glm::vec3& min, const glm::vec3& max) {
     model = glm::scale(model, size);
     
     // Set uniforms
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
-    GLint colorLoc = glGetUniformLocation(shaderProgram, "color");
-    
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-    glUniform3f(colorLoc, 1.0f, 1.0f, 1.0f); // White color
+    ShaderProgram::setMat4(flatModelLoc, model);
+    ShaderProgram::setVec3(flatColorLoc, glm::vec3(1.0f, 1.0f, 1.0f)); // White color
     
     // Draw wireframe
     glBindVertexArray(boxVAO);
     glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
+    stats.drawCalls++;
 }
 
 void Renderer::setCamera(const glm::vec3& position, const glm::vec3& target, const glm::vec3& up) {
@@ -175,33 +293,48 @@ void Renderer::setPerspective(float fov, float aspect, float near, float far) {
 }
 
 bool Renderer::createShaderProgram() {
-    GLuint vertexShader = compileShader(vertexShaderSource, GL_VERTEX_SHADER);
-    GLuint fragmentShader = compileShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
-    
-    if (vertexShader == 0 || fragmentShader == 0) {
+    if (!flatShader.create(vertexShaderSource, fragmentShaderSource)) {
         return false;
     }
     
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+    // The instanced particle program shares the flat-color fragment shader
+    if (!particleShader.create(particleVertexShaderSource, fragmentShaderSource)) {
+        return false;
+    }
     
-    GLint success;
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-        std::cerr << "Shader program linking failed: " << infoLog << std::endl;
+    if (!meshInstanceShader.create(meshInstanceVertexShaderSource, fragmentShaderSource)) {
         return false;
     }
     
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // Resolve per-object uniform locations once
+    flatModelLoc = flatShader.getUniformLocation("model");
+    flatColorLoc = flatShader.getUniformLocation("color");
+    particleColorLoc = particleShader.getUniformLocation("color");
+    meshInstanceColorLoc = meshInstanceShader.getUniformLocation("color");
+    
+    // Camera uniform block (view + projection), filled in beginFrame()
+    glGenBuffers(1, &cameraUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUBO);
+    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CameraBindingPoint, cameraUBO);
+    
+    flatShader.bindUniformBlock("Camera", CameraBindingPoint);
+    particleShader.bindUniformBlock("Camera", CameraBindingPoint);
+    meshInstanceShader.bindUniformBlock("Camera", CameraBindingPoint);
+    
+    meshInstanceStream.create(GL_ARRAY_BUFFER, 256 * sizeof(glm::mat4));
     
     return true;
 }
 
+void Renderer::useProgram(const ShaderProgram& program) {
+    if (currentProgram != program.getId()) {
+        glUseProgram(program.getId());
+        currentProgram = program.getId();
+    }
+}
+
 void Renderer::setupBoxGeometry() {
     // Unit cube vertices (centered at origin)
     float vertices[] = {
@@ -245,23 +378,6 @@ void Renderer::setupBoxGeometry() {
     glBindVertexArray(0);
 }
 
-GLuint Renderer::compileShader(const char* source, GLenum type) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
-    
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "Shader compilation failed: " << infoLog << std::endl;
-        return 0;
-    }
-    
-    return shader;
-}
-
 void Renderer::updateCamera() {
     // Convert spherical coordinates to Cartesian
     float x = radius * cos(phi) * cos(theta);
@@ -278,20 +394,133 @@ void Renderer::handleMouseInput() {
 }
 
 void Renderer::drawParticles(const std::vector<Particle>& particles) {
-    glUseProgram(shaderProgram);
+    if (particles.empty()) {
+        return;
+    }
     
-    // Get uniform locations
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
-    GLint colorLoc = glGetUniformLocation(shaderProgram, "color");
+    if (particleInstancing) {
+        drawParticlesInstanced(particles);
+    } else {
+        drawParticlesPerObject(particles);
+    }
+}
+
+// Particles are classified and packed in fixed-size chunks so the two passes line up
+static const size_t ParticleChunkSize = 4096;
+static const unsigned char CulledLod = 0xFF;
+
+void Renderer::drawParticlesInstanced(const std::vector<Particle>& particles) {
+    const size_t count = particles.size();
+    const size_t chunkCount = (count + ParticleChunkSize - 1) / ParticleChunkSize;
+    particleLods.resize(count);
+    chunkLodCounts.assign(chunkCount * SphereLodCount, 0);
+    
+    // Projected radius in pixels is radius * pixelScale / viewDepth
+    const float pixelScale = projectionMatrix[1][1] * height * 0.5f;
+    const glm::vec4 depthRow(-viewMatrix[0][2], -viewMatrix[1][2], -viewMatrix[2][2], -viewMatrix[3][2]);
+    
+    // Pass 1: cull against the frustum and pick a LOD per particle, counting per chunk
+    parallelFor(count, ParticleChunkSize, [&](size_t begin, size_t end) {
+        size_t* counts = &chunkLodCounts[(begin / ParticleChunkSize) * SphereLodCount];
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 position = particles[i].getPosition();
+            float size = particles[i].getSize();
+            if (frustumCulling && !frustum.intersectsSphere(position, size)) {
+                particleLods[i] = CulledLod;
+                continue;
+            }
+            float depth = glm::max(glm::dot(glm::vec3(depthRow), position) + depthRow.w, 1e-4f);
+            int lod = selectSphereLod(size * pixelScale / depth);
+            particleLods[i] = static_cast<unsigned char>(lod);
+            counts[lod]++;
+        }
+    });
+    
+    // Turn counts into write offsets: all LOD 0 instances first, then LOD 1, ...
+    size_t lodStart[SphereLodCount];
+    size_t visibleCount = 0;
+    for (int lod = 0; lod < SphereLodCount; ++lod) {
+        lodStart[lod] = visibleCount;
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            size_t& slot = chunkLodCounts[chunk * SphereLodCount + lod];
+            size_t chunkInstances = slot;
+            slot = visibleCount;
+            visibleCount += chunkInstances;
+        }
+        stats.particlesPerLod[lod] += static_cast<int>(visibleCount - lodStart[lod]);
+    }
+    stats.particlesCulled += static_cast<int>(count - visibleCount);
+    if (visibleCount == 0) {
+        return;
+    }
+    
+    // Pass 2: write visible particles (position + radius) straight into the mapped ring segment
+    size_t byteSize = visibleCount * sizeof(glm::vec4);
+    glm::vec4* instances = static_cast<glm::vec4*>(particleStream.map(byteSize));
+    if (!instances) {
+        std::cerr << "Failed to map particle instance buffer" << std::endl;
+        return;
+    }
+    parallelFor(count, ParticleChunkSize, [&](size_t begin, size_t end) {
+        size_t offsets[SphereLodCount];
+        const size_t* chunkOffsets = &chunkLodCounts[(begin / ParticleChunkSize) * SphereLodCount];
+        std::copy(chunkOffsets, chunkOffsets + SphereLodCount, offsets);
+        for (size_t i = begin; i < end; ++i) {
+            unsigned char lod = particleLods[i];
+            if (lod != CulledLod) {
+                instances[offsets[lod]++] = glm::vec4(particles[i].getPosition(), particles[i].getSize());
+            }
+        }
+    });
+    GLintptr offset = particleStream.unmap(byteSize);
+    accumulateStreamStats(particleStream);
     
-    // Set view and projection matrices
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+    useProgram(particleShader);
+    ShaderProgram::setVec3(particleColorLoc, glm::vec3(1.0f, 0.3f, 0.3f));
+    
+    glBindVertexArray(sphereVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, particleStream.getBuffer());
+    
+    // One instanced draw per LOD, each reading its own range of the ring segment
+    for (int lod = 0; lod < SphereLodCount; ++lod) {
+        size_t lodEnd = (lod + 1 < SphereLodCount) ? lodStart[lod + 1] : visibleCount;
+        GLsizei lodInstances = static_cast<GLsizei>(lodEnd - lodStart[lod]);
+        if (lodInstances == 0) {
+            continue;
+        }
+        
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4),
+                              (void*)(offset + lodStart[lod] * sizeof(glm::vec4)));
+        glDrawElementsInstanced(GL_TRIANGLES, sphereLods[lod].indexCount, GL_UNSIGNED_INT,
+                                (void*)(sphereLods[lod].firstIndex * sizeof(unsigned int)), lodInstances);
+        stats.drawCalls++;
+    }
+    
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    
+    // Fence the segment so it is not rewritten until the GPU has consumed it
+    particleStream.fence();
+    
+    stats.instancesDrawn += static_cast<int>(visibleCount);
+}
+
+int Renderer::selectSphereLod(float pixelRadius) {
+    // Minimum projected radius (pixels) for each LOD; anything smaller uses the coarsest
+    const float lodPixelRadius[SphereLodCount - 1] = { 16.0f, 6.0f, 2.0f };
+    for (int lod = 0; lod < SphereLodCount - 1; ++lod) {
+        if (pixelRadius >= lodPixelRadius[lod]) {
+            return lod;
+        }
+    }
+    return SphereLodCount - 1;
+}
+
+void Renderer::drawParticlesPerObject(const std::vector<Particle>& particles) {
+    useProgram(flatShader);
     
     // Set particle color (red)
-    glUniform3f(colorLoc, 1.0f, 0.3f, 0.3f);
+    ShaderProgram::setVec3(flatColorLoc, glm::vec3(1.0f, 0.3f, 0.3f));
     
     glBindVertexArray(sphereVAO);
     
@@ -301,62 +530,73 @@ void Renderer::drawParticles(const std::vector<Particle>& particles) {
         model = glm::translate(model, particle.getPosition());
         model = glm::scale(model, glm::vec3(particle.getSize()));
         
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+        ShaderProgram::setMat4(flatModelLoc, model);
+        glDrawElements(GL_TRIANGLES, sphereLods[0].indexCount, GL_UNSIGNED_INT, 0);
     }
     
     glBindVertexArray(0);
+    
+    stats.drawCalls += static_cast<int>(particles.size());
+    stats.instancesDrawn += static_cast<int>(particles.size());
 }
 
 void Renderer::setupSphereGeometry() {
-    // Create a high-resolution UV sphere (latitude-longitude sphere)
+    // Create UV spheres (latitude-longitude spheres) at decreasing resolutions
     std::vector<glm::vec3> vertices;
     std::vector<unsigned int> indices;
     
-    const int latitudes = 32;   // Number of latitude divisions (horizontal rings)
-    const int longitudes = 64;  // Number of longitude divisions (vertical segments)
+    // Latitude (horizontal rings) and longitude (vertical segments) divisions per LOD
+    const int lodLatitudes[SphereLodCount] = { 32, 16, 8, 4 };
+    const int lodLongitudes[SphereLodCount] = { 64, 32, 16, 8 };
     
-    // Generate vertices
-    for (int lat = 0; lat <= latitudes; ++lat) {
-        float theta = lat * M_PI / latitudes;  // 0 to PI
-        float sinTheta = sin(theta);
-        float cosTheta = cos(theta);
+    for (int lod = 0; lod < SphereLodCount; ++lod) {
+        const int latitudes = lodLatitudes[lod];
+        const int longitudes = lodLongitudes[lod];
+        const unsigned int baseVertex = static_cast<unsigned int>(vertices.size());
+        sphereLods[lod].firstIndex = indices.size();
         
-        for (int lon = 0; lon <= longitudes; ++lon) {
-            float phi = lon * 2 * M_PI / longitudes;  // 0 to 2*PI
-            float sinPhi = sin(phi);
-            float cosPhi = cos(phi);
+        // Generate vertices
+        for (int lat = 0; lat <= latitudes; ++lat) {
+            float theta = lat * M_PI / latitudes;  // 0 to PI
+            float sinTheta = sin(theta);
+            float cosTheta = cos(theta);
             
-            // Calculate vertex position on unit sphere
-            glm::vec3 vertex;
-            vertex.x = cosPhi * sinTheta;
-            vertex.y = cosTheta;
-            vertex.z = sinPhi * sinTheta;
-            
-            vertices.push_back(vertex);
+            for (int lon = 0; lon <= longitudes; ++lon) {
+                float phi = lon * 2 * M_PI / longitudes;  // 0 to 2*PI
+                float sinPhi = sin(phi);
+                float cosPhi = cos(phi);
+                
+                // Calculate vertex position on unit sphere
+                glm::vec3 vertex;
+                vertex.x = cosPhi * sinTheta;
+                vertex.y = cosTheta;
+                vertex.z = sinPhi * sinTheta;
+                
+                vertices.push_back(vertex);
+            }
         }
-    }
-    
-    // Generate indices for triangles
-    for (int lat = 0; lat < latitudes; ++lat) {
-        for (int lon = 0; lon < longitudes; ++lon) {
-            int first = lat * (longitudes + 1) + lon;
-            int second = first + longitudes + 1;
-            
-            // First triangle
-            indices.push_back(first);
-            indices.push_back(second);
-            indices.push_back(first + 1);
-            
-            // Second triangle
-            indices.push_back(second);
-            indices.push_back(second + 1);
-            indices.push_back(first + 1);
+        
+        // Generate indices for triangles
+        for (int lat = 0; lat < latitudes; ++lat) {
+            for (int lon = 0; lon < longitudes; ++lon) {
+                unsigned int first = baseVertex + lat * (longitudes + 1) + lon;
+                unsigned int second = first + longitudes + 1;
+                
+                // First triangle
+                indices.push_back(first);
+                indices.push_back(second);
+                indices.push_back(first + 1);
+                
+                // Second triangle
+                indices.push_back(second);
+                indices.push_back(second + 1);
+                indices.push_back(first + 1);
+            }
         }
+        
+        sphereLods[lod].indexCount = static_cast<GLsizei>(indices.size() - sphereLods[lod].firstIndex);
     }
     
-    sphereIndexCount = indices.size();
-    
     // Convert vertices to float array
     std::vector<float> vertexData;
     for (const auto& vertex : vertices) {
@@ -380,11 +620,17 @@ void Renderer::setupSphereGeometry() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
     
+    // Per-instance attribute for the instanced particle path (position + radius).
+    // The pointer itself is set per draw since each frame writes a different ring segment.
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    particleStream.create(GL_ARRAY_BUFFER, 1024 * sizeof(glm::vec4));
+    
     glBindVertexArray(0);
 }
 
 void Renderer::drawMesh(const Mesh& mesh, const glm::vec3& position) {
-    glUseProgram(shaderProgram);
+    useProgram(flatShader);
     
     // Create transformation matrix
     glm::mat4 model = glm::mat4(1.0f);
@@ -392,36 +638,22 @@ void Renderer::drawMesh(const Mesh& mesh, const glm::vec3& position) {
     // TODO: Add rotation and scale if needed, from CollisionObject
     
     // Set uniforms
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
-    GLint colorLoc = glGetUniformLocation(shaderProgram, "color");
-    
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-    glUniform3f(colorLoc, 0.3f, 0.8f, 0.3f); // Green color for mesh
+    ShaderProgram::setMat4(flatModelLoc, model);
+    ShaderProgram::setVec3(flatColorLoc, glm::vec3(0.3f, 0.8f, 0.3f)); // Green color for mesh
     
     mesh.draw(); // Delegate drawing to the Mesh object
+    stats.drawCalls++;
 }
 
 void Renderer::drawMesh(const Mesh& mesh, const glm::mat4& transformMatrix) {
-    glUseProgram(shaderProgram);
+    useProgram(flatShader);
     
     // Use the provided transform matrix directly (includes position, rotation, and scale)
-    
-    // Set uniforms
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
-    GLint colorLoc = glGetUniformLocation(shaderProgram, "color");
-    
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(transformMatrix));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-    glUniform3f(colorLoc, 0.3f, 0.8f, 0.3f); // Green color for mesh
+    ShaderProgram::setMat4(flatModelLoc, transformMatrix);
+    ShaderProgram::setVec3(flatColorLoc, glm::vec3(0.3f, 0.8f, 0.3f)); // Green color for mesh
     
     mesh.draw(); // Delegate drawing to the Mesh object
+    stats.drawCalls++;
 }
 
 void Renderer::drawMeshes(const std::vector<const Mesh*>& meshes, const std::vector<glm::vec3>& positions) {
@@ -430,11 +662,155 @@ void Renderer::drawMeshes(const std::vector<const Mesh*>& meshes, const std::vec
         return;
     }
     
+    std::vector<glm::mat4> transforms;
+    transforms.reserve(positions.size());
+    for (const auto& position : positions) {
+        transforms.push_back(glm::translate(glm::mat4(1.0f), position));
+    }
+    
+    drawMeshesInstanced(meshes, transforms);
+}
+
+void Renderer::drawMeshesInstanced(const std::vector<const Mesh*>& meshes, const std::vector<glm::mat4>& transforms) {
+    if (meshes.size() != transforms.size()) {
+        std::cerr << "Error: Meshes and transforms vectors must have the same size" << std::endl;
+        return;
+    }
+    
+    // Frustum-test each instance's world-space bounds in parallel
+    meshVisible.assign(meshes.size(), 1);
+    if (frustumCulling) {
+        parallelFor(meshes.size(), 64, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (!meshes[i]) {
+                    continue;
+                }
+                // Transform the local box as center + extent (Arvo's method)
+                glm::vec3 localCenter = (meshes[i]->getMin() + meshes[i]->getMax()) * 0.5f;
+                glm::vec3 localExtent = (meshes[i]->getMax() - meshes[i]->getMin()) * 0.5f;
+                const glm::mat4& m = transforms[i];
+                glm::vec3 center = glm::vec3(m * glm::vec4(localCenter, 1.0f));
+                glm::vec3 extent;
+                for (int axis = 0; axis < 3; ++axis) {
+                    extent[axis] = glm::abs(m[0][axis]) * localExtent.x +
+                                   glm::abs(m[1][axis]) * localExtent.y +
+                                   glm::abs(m[2][axis]) * localExtent.z;
+                }
+                meshVisible[i] = frustum.intersectsAABB(center - extent, center + extent) ? 1 : 0;
+            }
+        });
+    }
+    
+    // Sort visible instance indices so that instances sharing a mesh are contiguous
+    meshDrawOrder.clear();
     for (size_t i = 0; i < meshes.size(); ++i) {
-        if (meshes[i]) {
-            drawMesh(*meshes[i], positions[i]);
+        if (!meshes[i]) {
+            continue;
+        }
+        if (meshVisible[i]) {
+            meshDrawOrder.push_back(i);
+        } else {
+            stats.objectsCulled++;
+        }
+    }
+    if (meshDrawOrder.empty()) {
+        return;
+    }
+    std::stable_sort(meshDrawOrder.begin(), meshDrawOrder.end(), [&](size_t a, size_t b) {
+        return std::less<const Mesh*>()(meshes[a], meshes[b]);
+    });
+    
+    // Upload all model matrices in group order with a single map
+    size_t byteSize = meshDrawOrder.size() * sizeof(glm::mat4);
+    glm::mat4* instances = static_cast<glm::mat4*>(meshInstanceStream.map(byteSize));
+    if (!instances) {
+        std::cerr << "Failed to map mesh instance buffer" << std::endl;
+        return;
+    }
+    for (size_t i = 0; i < meshDrawOrder.size(); ++i) {
+        instances[i] = transforms[meshDrawOrder[i]];
+    }
+    GLintptr baseOffset = meshInstanceStream.unmap(byteSize);
+    accumulateStreamStats(meshInstanceStream);
+    
+    useProgram(meshInstanceShader);
+    ShaderProgram::setVec3(meshInstanceColorLoc, glm::vec3(0.3f, 0.8f, 0.3f)); // Green color for mesh
+    
+    // One instanced draw per distinct mesh
+    size_t groupStart = 0;
+    while (groupStart < meshDrawOrder.size()) {
+        const Mesh* mesh = meshes[meshDrawOrder[groupStart]];
+        size_t groupEnd = groupStart + 1;
+        while (groupEnd < meshDrawOrder.size() && meshes[meshDrawOrder[groupEnd]] == mesh) {
+            groupEnd++;
         }
+        
+        int instanceCount = static_cast<int>(groupEnd - groupStart);
+        mesh->drawInstanced(meshInstanceStream.getBuffer(), baseOffset + groupStart * sizeof(glm::mat4), instanceCount);
+        
+        stats.drawCalls++;
+        stats.instancesDrawn += instanceCount;
+        stats.meshTrianglesDrawn += static_cast<size_t>(mesh->getIndexCount() / 3) * instanceCount;
+        groupStart = groupEnd;
+    }
+    
+    meshInstanceStream.fence();
+}
+
+void Renderer::drawSnapshot(const SimulationSnapshot& snapshot) {
+    drawWireframeBox(snapshot.boundsMin, snapshot.boundsMax);
+    
+    snapshotMeshes.clear();
+    snapshotTransforms.clear();
+    for (const auto& object : snapshot.objects) {
+        snapshotMeshes.push_back(selectObjectMesh(object));
+        snapshotTransforms.push_back(object.transform);
+    }
+    drawMeshesInstanced(snapshotMeshes, snapshotTransforms);
+    
+    drawParticles(snapshot.particles);
+}
+
+const Mesh* Renderer::selectObjectMesh(const SimulationSnapshot::ObjectState& object) {
+    if (object.surfaceLodCount == 0 || !object.mesh) {
+        return object.mesh;
+    }
+    if (showSdfSurface) {
+        stats.objectsUsingSurfaceLods++;
+        return object.surfaceLods[0];
     }
+    if (!meshLods || object.surfaceLodCount < 2) {
+        return object.mesh;
+    }
+    
+    // Projected bounding-sphere radius in pixels, as for particle LODs
+    glm::vec3 localCenter = (object.mesh->getMin() + object.mesh->getMax()) * 0.5f;
+    float localRadius = glm::length(object.mesh->getMax() - object.mesh->getMin()) * 0.5f;
+    const glm::mat4& m = object.transform;
+    float maxScale = glm::max(glm::max(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1]))), glm::length(glm::vec3(m[2])));
+    glm::vec4 viewCenter = viewMatrix * (m * glm::vec4(localCenter, 1.0f));
+    float depth = glm::max(-viewCenter.z, 1e-4f);
+    float pixelRadius = localRadius * maxScale * projectionMatrix[1][1] * height * 0.5f / depth;
+    
+    // Large objects keep the original mesh; each halving of screen size drops one extracted level
+    const float originalMeshPixelRadius = 96.0f;
+    int level = 0;
+    for (float threshold = originalMeshPixelRadius; pixelRadius < threshold && level < object.surfaceLodCount - 1; threshold *= 0.5f) {
+        level++;
+    }
+    if (level == 0) {
+        return object.mesh;
+    }
+    stats.objectsUsingSurfaceLods++;
+    return object.surfaceLods[level];
+}
+
+void Renderer::accumulateStreamStats(StreamBuffer& stream) {
+    const StreamBufferStats& streamStats = stream.getStats();
+    stats.instanceBytesUploaded += streamStats.bytesUploaded;
+    stats.uploadWaitTimeMs += streamStats.waitTimeMs;
+    stats.uploadStalls += streamStats.stalls;
+    stream.resetStats();
 }
 
 // Static callback functions
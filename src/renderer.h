@@ -8,12 +8,38 @@
 #include <vector>
 #include "particle.h"
 #include "mesh.h"
+#include "stream_buffer.h"
+#include "shader_program.h"
+#include "frustum.h"
+#include "simulation_snapshot.h"
+#include "frame_capture.h"
+
+// Number of sphere tessellation levels used for particles (0 = finest)
+constexpr int SphereLodCount = 4;
+
+// Per-frame rendering statistics, reset in beginFrame()
+struct RenderStats {
+    int drawCalls = 0;
+    int instancesDrawn = 0;
+    int particlesCulled = 0;
+    int objectsCulled = 0;
+    int objectsUsingSurfaceLods = 0;  // Objects drawn with a mesh extracted from their SDF
+    size_t meshTrianglesDrawn = 0;
+    int particlesPerLod[SphereLodCount] = {};
+    size_t instanceBytesUploaded = 0;
+    double uploadWaitTimeMs = 0.0;  // CPU time blocked on GPU fences for streaming buffers
+    int uploadStalls = 0;
+};
 
 class Renderer {
 public:
     Renderer(int width, int height);
     ~Renderer();
     
+    // Render into a framebuffer object of a hidden window instead of a visible one (call before initialize)
+    void setOffscreen(bool enabled) { offscreen = enabled; }
+    bool isOffscreen() const { return offscreen; }
+    
     bool initialize();
     void cleanup();
     
@@ -21,12 +47,38 @@ public:
     void endFrame();
     
     void drawWireframeBox(const glm::vec3& min, const glm::vec3& max);
-    void drawParticles(const std::vector<Particle>& particles);    void drawMesh(const Mesh& mesh, const glm::vec3& position);
+    void drawParticles(const std::vector<Particle>& particles);
+    void drawMesh(const Mesh& mesh, const glm::vec3& position);
     void drawMesh(const Mesh& mesh, const glm::mat4& transformMatrix);
     void drawMeshes(const std::vector<const Mesh*>& meshes, const std::vector<glm::vec3>& positions);
+    // Groups instances by mesh and draws each group with one instanced call
+    void drawMeshesInstanced(const std::vector<const Mesh*>& meshes, const std::vector<glm::mat4>& transforms);
+    // Draws bounds, collision objects and particles of a published simulation snapshot
+    void drawSnapshot(const SimulationSnapshot& snapshot);
+    // Camera changes are uploaded to the Camera uniform block in the next beginFrame()
     void setCamera(const glm::vec3& position, const glm::vec3& target, const glm::vec3& up);
     void setPerspective(float fov, float aspect, float near, float far);
     
+    // Draw all particles with a single instanced call (default) or one call per particle
+    void setParticleInstancing(bool enabled) { particleInstancing = enabled; }
+    bool isParticleInstancing() const { return particleInstancing; }
+    // Skip particles and meshes outside the view frustum (instanced paths only)
+    void setFrustumCulling(bool enabled) { frustumCulling = enabled; }
+    bool isFrustumCulling() const { return frustumCulling; }
+    // Draw small collision objects with coarser meshes extracted from their SDF
+    void setMeshLods(bool enabled) { meshLods = enabled; }
+    bool isMeshLods() const { return meshLods; }
+    // Draw each collision object's full-resolution SDF surface instead of its OBJ mesh
+    void setShowSdfSurface(bool enabled) { showSdfSurface = enabled; }
+    bool isShowSdfSurface() const { return showSdfSurface; }
+    const RenderStats& getStats() const { return stats; }
+    
+    // Write every rendered frame to 'directory' as frame_NNNNNN.ppm without stalling the loop
+    bool startCapture(const std::string& directory);
+    void stopCapture() { frameCapture.stop(); }
+    bool isCapturing() const { return frameCapture.isActive(); }
+    FrameCaptureStats getCaptureStats() const { return frameCapture.getStats(); }
+    
     // Orbit camera controls
     void updateCamera();
     void handleMouseInput();
@@ -38,11 +90,52 @@ private:
     GLFWwindow* window;
     int width, height;
     
-    GLuint shaderProgram;
+    // Offscreen target, used instead of the default framebuffer when offscreen is set
+    bool offscreen;
+    GLuint offscreenFBO, offscreenColor, offscreenDepth;
+    FrameCapture frameCapture;
+    
+    ShaderProgram flatShader;          // Per-object model matrix + flat color
+    ShaderProgram particleShader;      // Instanced sphere shader (per-instance position and radius)
+    ShaderProgram meshInstanceShader;  // Per-instance model matrix from attribute locations 2-5
+    GLint flatModelLoc, flatColorLoc;
+    GLint particleColorLoc;
+    GLint meshInstanceColorLoc;
+    GLuint cameraUBO;                  // View + projection uniform block, updated once per frame
+    GLuint currentProgram;             // Last program bound this frame, to skip redundant binds
     GLuint boxVAO, boxVBO, boxEBO;
     GLuint sphereVAO, sphereVBO, sphereEBO;
     GLuint meshVAO, meshVBO;
-    int sphereIndexCount;
+    
+    // Sphere tessellation levels packed into one index buffer
+    struct SphereLod {
+        GLsizei indexCount;
+        size_t firstIndex;
+    };
+    SphereLod sphereLods[SphereLodCount];
+    
+    // Particle instancing state
+    bool particleInstancing;
+    StreamBuffer particleStream;  // Ring-buffered per-instance data (xyz = position, w = radius)
+    std::vector<unsigned char> particleLods;   // Scratch: LOD per particle, or culled
+    std::vector<size_t> chunkLodCounts;        // Scratch: per-chunk instance counts for each LOD
+    
+    // Batched mesh instancing state
+    StreamBuffer meshInstanceStream;    // Ring-buffered model matrices, grouped by mesh
+    std::vector<size_t> meshDrawOrder;  // Scratch: instance indices sorted by mesh
+    std::vector<unsigned char> meshVisible;  // Scratch: frustum test result per instance
+    std::vector<const Mesh*> snapshotMeshes;      // Scratch: draw lists built from snapshots
+    std::vector<glm::mat4> snapshotTransforms;
+    
+    // Mesh selection for snapshot objects
+    bool meshLods;
+    bool showSdfSurface;
+    
+    // Culling state, rebuilt in beginFrame()
+    bool frustumCulling;
+    Frustum frustum;
+    
+    RenderStats stats;
     
     glm::mat4 viewMatrix;
     glm::mat4 projectionMatrix;
@@ -57,10 +150,17 @@ private:
     bool mousePressed;
     double lastMouseX, lastMouseY;
     
+    bool createWindow();
+    bool createOffscreenFramebuffer();
     bool createShaderProgram();
+    void useProgram(const ShaderProgram& program);
+    void drawParticlesInstanced(const std::vector<Particle>& particles);
+    void drawParticlesPerObject(const std::vector<Particle>& particles);
+    void accumulateStreamStats(StreamBuffer& stream);
+    static int selectSphereLod(float pixelRadius);
+    const Mesh* selectObjectMesh(const SimulationSnapshot::ObjectState& object);
     void setupBoxGeometry();
     void setupSphereGeometry();
-    GLuint compileShader(const char* source, GLenum type);
     
     // Camera callbacks
     static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
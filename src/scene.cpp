@@ -0,0 +1,455 @@
+#include "scene.h"
+#include "mesh_generator.h"
+#include "random.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool isNumber(const std::string& token) {
+    char* end = nullptr;
+    std::strtod(token.c_str(), &end);
+    return end != token.c_str() && *end == '\0';
+}
+
+// Consumes the numeric tokens following a keyword
+static std::vector<float> readNumbers(const std::vector<std::string>& tokens, size_t& index) {
+    std::vector<float> values;
+    while (index < tokens.size() && isNumber(tokens[index])) {
+        values.push_back(static_cast<float>(std::atof(tokens[index].c_str())));
+        index++;
+    }
+    return values;
+}
+
+static glm::vec3 toVec3(const std::vector<float>& values) {
+    return glm::vec3(values[0], values[1], values[2]);
+}
+
+namespace {
+
+// Line-by-line parser state; fail() reports the error with its location
+struct SceneParser {
+    std::string path;
+    std::filesystem::path directory;
+    int line = 0;
+    SceneDescription& scene;
+    
+    SceneParser(const std::string& path, SceneDescription& scene)
+        : path(path), directory(std::filesystem::path(path).parent_path()), scene(scene) {
+    }
+    
+    bool fail(const std::string& message) const {
+        std::cerr << path << ":" << line << ": " << message << std::endl;
+        return false;
+    }
+    
+    int findAsset(const std::string& name) const {
+        for (size_t i = 0; i < scene.assets.size(); ++i) {
+            if (scene.assets[i].name == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+    
+    // Applies one instance property; returns false (after reporting) if 'key' is not one
+    bool parseInstanceProperty(const std::string& key, const std::vector<float>& values, SceneDescription::Instance& instance) {
+        if (key == "position" && values.size() == 3) {
+            instance.position = toVec3(values);
+        } else if (key == "rotation" && values.size() == 4) {
+            instance.rotation = glm::normalize(glm::quat(values[0], values[1], values[2], values[3]));
+        } else if (key == "euler" && values.size() == 3) {
+            instance.rotation = glm::angleAxis(glm::radians(values[2]), glm::vec3(0.0f, 0.0f, 1.0f))
+                              * glm::angleAxis(glm::radians(values[1]), glm::vec3(0.0f, 1.0f, 0.0f))
+                              * glm::angleAxis(glm::radians(values[0]), glm::vec3(1.0f, 0.0f, 0.0f));
+        } else if (key == "scale" && values.size() == 1) {
+            instance.scale = glm::vec3(values[0]);
+        } else if (key == "scale" && values.size() == 3) {
+            instance.scale = toVec3(values);
+        } else if (key == "mass" && values.size() == 1) {
+            instance.mass = values[0];
+        } else if (key == "velocity" && values.size() == 3) {
+            instance.velocity = toVec3(values);
+        } else {
+            return fail("invalid property '" + key + "' with " + std::to_string(values.size()) + " values");
+        }
+        return true;
+    }
+    
+    bool parseAsset(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 3) {
+            return fail("expected: asset <name> <path> [resolution n] [size s]");
+        }
+        if (findAsset(tokens[1]) >= 0) {
+            return fail("asset '" + tokens[1] + "' defined twice");
+        }
+        SceneDescription::Asset asset;
+        asset.name = tokens[1];
+        std::filesystem::path assetPath(tokens[2]);
+        if (isProceduralMeshPath(tokens[2])) {
+            asset.path = tokens[2];
+        } else {
+            asset.path = (assetPath.is_relative() ? directory / assetPath : assetPath).lexically_normal().string();
+        }
+        asset.resolution = scene.resolution;
+        asset.size = 0.0f;
+        for (size_t i = 3; i < tokens.size();) {
+            std::string key = tokens[i++];
+            std::vector<float> values = readNumbers(tokens, i);
+            if (key == "resolution" && values.size() == 1 && values[0] >= 2.0f) {
+                asset.resolution = static_cast<int>(values[0]);
+            } else if (key == "size" && values.size() == 1 && values[0] > 0.0f) {
+                asset.size = values[0];
+            } else {
+                return fail("invalid asset property '" + key + "'");
+            }
+        }
+        scene.assets.push_back(asset);
+        return true;
+    }
+    
+    bool parseObject(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 2) {
+            return fail("expected: object <asset> [properties]");
+        }
+        SceneDescription::Instance instance;
+        instance.asset = findAsset(tokens[1]);
+        if (instance.asset < 0) {
+            return fail("unknown asset '" + tokens[1] + "'");
+        }
+        for (size_t i = 2; i < tokens.size();) {
+            std::string key = tokens[i++];
+            if (!parseInstanceProperty(key, readNumbers(tokens, i), instance)) {
+                return false;
+            }
+        }
+        scene.instances.push_back(instance);
+        return true;
+    }
+    
+    bool parseGrid(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 2) {
+            return fail("expected: grid <asset> count nx ny nz spacing sx sy sz [properties]");
+        }
+        SceneDescription::Instance prototype;
+        prototype.asset = findAsset(tokens[1]);
+        if (prototype.asset < 0) {
+            return fail("unknown asset '" + tokens[1] + "'");
+        }
+        glm::ivec3 count(0);
+        glm::vec3 spacing(0.0f), origin(0.0f);
+        float speed = 0.0f;
+        for (size_t i = 2; i < tokens.size();) {
+            std::string key = tokens[i++];
+            std::vector<float> values = readNumbers(tokens, i);
+            if (key == "count" && values.size() == 3) {
+                count = glm::ivec3(int(values[0]), int(values[1]), int(values[2]));
+            } else if (key == "spacing" && values.size() == 3) {
+                spacing = toVec3(values);
+            } else if (key == "origin" && values.size() == 3) {
+                origin = toVec3(values);
+            } else if (key == "speed" && values.size() == 1) {
+                speed = values[0];
+            } else if (!parseInstanceProperty(key, values, prototype)) {
+                return false;
+            }
+        }
+        if (count.x < 1 || count.y < 1 || count.z < 1) {
+            return fail("grid needs 'count nx ny nz' with positive counts");
+        }
+        
+        // One counter-based stream per instance, keyed by the scene seed and the line, so the
+        // same file always yields the same velocities
+        uint64_t gridSeed = mixBits((static_cast<uint64_t>(scene.seed) << 32) | static_cast<uint32_t>(line));
+        uint64_t index = 0;
+        glm::vec3 center = glm::vec3(float(count.x - 1), float(count.y - 1), float(count.z - 1)) * 0.5f;
+        for (int z = 0; z < count.z; ++z) {
+            for (int y = 0; y < count.y; ++y) {
+                for (int x = 0; x < count.x; ++x) {
+                    SceneDescription::Instance instance = prototype;
+                    instance.position = origin + prototype.position + (glm::vec3(x, y, z) - center) * spacing;
+                    if (speed > 0.0f) {
+                        RandomStream random(gridSeed, index);
+                        float u = random.nextFloat();
+                        float v = random.nextFloat();
+                        instance.velocity += uniformSphereDirection(u, v) * speed;
+                    }
+                    index++;
+                    scene.instances.push_back(instance);
+                }
+            }
+        }
+        return true;
+    }
+    
+    bool parseEmitter(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 2 || !isNumber(tokens[1]) || std::atoi(tokens[1].c_str()) < 0) {
+            return fail("expected: emitter <count> [min x y z] [max x y z] [speed s] [size r] [rate n] [velocity x y z]");
+        }
+        SceneDescription::Emitter emitter;
+        emitter.count = std::atoi(tokens[1].c_str());
+        bool hasMin = false, hasMax = false;
+        for (size_t i = 2; i < tokens.size();) {
+            std::string key = tokens[i++];
+            std::vector<float> values = readNumbers(tokens, i);
+            if (key == "min" && values.size() == 3) {
+                emitter.regionMin = toVec3(values);
+                hasMin = true;
+            } else if (key == "max" && values.size() == 3) {
+                emitter.regionMax = toVec3(values);
+                hasMax = true;
+            } else if (key == "speed" && values.size() == 1) {
+                emitter.speed = values[0];
+            } else if (key == "size" && values.size() == 1 && values[0] > 0.0f) {
+                emitter.size = values[0];
+            } else if (key == "rate" && values.size() == 1 && values[0] >= 0.0f) {
+                emitter.rate = values[0];
+            } else if (key == "velocity" && values.size() == 3) {
+                emitter.velocity = toVec3(values);
+            } else {
+                return fail("invalid emitter property '" + key + "'");
+            }
+        }
+        if (hasMin != hasMax) {
+            return fail("emitter region needs both 'min' and 'max'");
+        }
+        emitter.hasRegion = hasMin;
+        scene.emitters.push_back(emitter);
+        return true;
+    }
+    
+    bool parseKillZone(const std::vector<std::string>& tokens) {
+        KillZone zone;
+        bool hasMin = false, hasMax = false;
+        for (size_t i = 1; i < tokens.size();) {
+            std::string key = tokens[i++];
+            std::vector<float> values = readNumbers(tokens, i);
+            if (key == "min" && values.size() == 3) {
+                zone.regionMin = toVec3(values);
+                hasMin = true;
+            } else if (key == "max" && values.size() == 3) {
+                zone.regionMax = toVec3(values);
+                hasMax = true;
+            } else {
+                return fail("invalid kill property '" + key + "'");
+            }
+        }
+        if (!hasMin || !hasMax) {
+            return fail("expected: kill min x y z max x y z");
+        }
+        if (zone.regionMin.x >= zone.regionMax.x || zone.regionMin.y >= zone.regionMax.y || zone.regionMin.z >= zone.regionMax.z) {
+            return fail("kill zone minimum must be below the maximum");
+        }
+        scene.killZones.push_back(zone);
+        return true;
+    }
+    
+    bool parseLine(const std::vector<std::string>& tokens) {
+        const std::string& directive = tokens[0];
+        size_t index = 1;
+        if (directive == "asset") {
+            return parseAsset(tokens);
+        } else if (directive == "object") {
+            return parseObject(tokens);
+        } else if (directive == "grid") {
+            return parseGrid(tokens);
+        } else if (directive == "emitter") {
+            return parseEmitter(tokens);
+        } else if (directive == "kill") {
+            return parseKillZone(tokens);
+        } else if (directive == "adaptive" && tokens.size() == 2 && (tokens[1] == "on" || tokens[1] == "off")) {
+            scene.adaptive = tokens[1] == "on";
+            return true;
+        }
+        
+        // Remaining directives take only numbers
+        std::vector<float> values = readNumbers(tokens, index);
+        if (index != tokens.size()) {
+            return fail("unexpected '" + tokens[index] + "' after '" + directive + "'");
+        }
+        if (directive == "bounds" && values.size() == 6) {
+            scene.hasBounds = true;
+            scene.boundsMin = glm::vec3(values[0], values[1], values[2]);
+            scene.boundsMax = glm::vec3(values[3], values[4], values[5]);
+            if (scene.boundsMin.x >= scene.boundsMax.x || scene.boundsMin.y >= scene.boundsMax.y || scene.boundsMin.z >= scene.boundsMax.z) {
+                return fail("bounds minimum must be below the maximum");
+            }
+        } else if (directive == "resolution" && values.size() == 1 && values[0] >= 2.0f) {
+            scene.resolution = static_cast<int>(values[0]);
+        } else if (directive == "seed" && values.size() == 1) {
+            scene.hasSeed = true;
+            scene.seed = static_cast<uint32_t>(values[0]);
+        } else if (directive == "cfl" && values.size() == 1 && values[0] > 0.0f) {
+            scene.cflNumber = values[0];
+        } else if (directive == "step_rate" && values.size() == 1 && values[0] > 0.0f) {
+            scene.stepRate = values[0];
+        } else if (directive == "sleep" && values.size() == 2 && values[0] >= 0.0f && values[1] >= 1.0f) {
+            scene.sleeping = true;
+            scene.sleepVelocity = values[0];
+            scene.sleepSteps = static_cast<int>(values[1]);
+        } else if (directive == "reorder" && values.size() == 1 && values[0] >= 0.0f) {
+            scene.reorderInterval = static_cast<int>(values[0]);
+        } else if (directive == "object_gravity" && values.size() == 3) {
+            scene.objectGravity = glm::vec3(values[0], values[1], values[2]);
+        } else if (directive == "restitution" && values.size() == 1 && values[0] >= 0.0f && values[0] <= 1.0f) {
+            scene.restitution = values[0];
+        } else if (directive == "solver_iterations" && values.size() == 1 && values[0] >= 1.0f) {
+            scene.solverIterations = static_cast<int>(values[0]);
+        } else if (directive == "max_particles" && values.size() == 1 && values[0] >= 1.0f) {
+            scene.maxParticles = static_cast<size_t>(values[0]);
+        } else {
+            return fail("invalid directive '" + directive + "'");
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+bool parseScene(const std::string& path, SceneDescription& scene) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open scene file " << path << std::endl;
+        return false;
+    }
+    
+    scene = SceneDescription();
+    SceneParser parser(path, scene);
+    std::string text;
+    while (std::getline(file, text)) {
+        parser.line++;
+        size_t comment = text.find('#');
+        if (comment != std::string::npos) {
+            text.erase(comment);
+        }
+        std::istringstream stream(text);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (stream >> token) {
+            tokens.push_back(token);
+        }
+        if (!tokens.empty() && !parser.parseLine(tokens)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool instantiateScene(const SceneDescription& scene, Simulation& simulation, AssetCache& assets, SceneLoadStats* stats) {
+    SceneLoadStats localStats;
+    SceneLoadStats& result = stats ? *stats : localStats;
+    
+    // Bake every distinct (mesh, resolution) pair once, several at a time
+    auto bakeStart = std::chrono::steady_clock::now();
+    std::vector<std::string> keys;
+    for (const auto& asset : scene.assets) {
+        keys.push_back(CollisionObject::makeAssetKey(asset.path, asset.resolution));
+    }
+    if (!assets.preload(keys)) {
+        std::cerr << "Failed to load scene assets" << std::endl;
+        return false;
+    }
+    result.bakeMs = elapsedMs(bakeStart);
+    
+    auto instantiateStart = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<const CollisionObject>> prototypes;
+    std::vector<float> unitScales;
+    for (size_t i = 0; i < scene.assets.size(); ++i) {
+        prototypes.push_back(assets.acquire(keys[i]));
+        glm::vec3 extent = prototypes.back()->getMesh().getMax() - prototypes.back()->getMesh().getMin();
+        float largest = glm::max(glm::max(extent.x, extent.y), extent.z);
+        unitScales.push_back(scene.assets[i].size > 0.0f && largest > 0.0f ? scene.assets[i].size / largest : 1.0f);
+    }
+    std::sort(keys.begin(), keys.end());
+    result.assets = std::unique(keys.begin(), keys.end()) - keys.begin();
+    
+    simulation.clearCollisionObjects();
+    glm::vec3 objectsMin(std::numeric_limits<float>::max());
+    glm::vec3 objectsMax(-std::numeric_limits<float>::max());
+    for (const auto& instance : scene.instances) {
+        auto object = std::make_unique<CollisionObject>();
+        object->shareGeometry(*prototypes[instance.asset]);
+        object->setPosition(instance.position);
+        object->setRotation(instance.rotation);
+        object->setScale(instance.scale * unitScales[instance.asset]);
+        object->setVelocity(instance.velocity);
+        object->setMass(instance.mass);
+        objectsMin = glm::min(objectsMin, object->getWorldMin());
+        objectsMax = glm::max(objectsMax, object->getWorldMax());
+        simulation.addCollisionObject(std::move(object));
+    }
+    
+    glm::vec3 boundsMin = scene.boundsMin, boundsMax = scene.boundsMax;
+    if (!scene.hasBounds) {
+        if (scene.instances.empty()) {
+            std::cerr << "Scene has neither bounds nor objects" << std::endl;
+            return false;
+        }
+        glm::vec3 padding = (objectsMax - objectsMin) * 0.5f;
+        boundsMin = objectsMin - padding;
+        boundsMax = objectsMax + padding;
+    }
+    simulation.setBounds(boundsMin, boundsMax);
+    simulation.setAdaptiveSubstepping(scene.adaptive);
+    simulation.setCflNumber(scene.cflNumber);
+    simulation.setParticleSleeping(scene.sleeping);
+    if (scene.sleeping) {
+        simulation.setSleepThreshold(scene.sleepVelocity, scene.sleepSteps);
+    }
+    simulation.setSpatialReorderInterval(scene.reorderInterval);
+    simulation.setObjectGravity(scene.objectGravity);
+    simulation.setRestitution(scene.restitution);
+    simulation.setSolverIterations(scene.solverIterations);
+    if (scene.hasSeed) {
+        simulation.setRandomSeed(scene.seed);
+    }
+    
+    simulation.initialize(0);
+    simulation.setParticleCapacity(scene.maxParticles);
+    simulation.clearEmitters();
+    simulation.clearKillZones();
+    for (const auto& emitter : scene.emitters) {
+        glm::vec3 regionMin = emitter.hasRegion ? emitter.regionMin : boundsMin;
+        glm::vec3 regionMax = emitter.hasRegion ? emitter.regionMax : boundsMax;
+        simulation.addParticles(emitter.count, regionMin, regionMax, emitter.speed, emitter.size, emitter.velocity);
+        if (emitter.rate > 0.0f) {
+            ParticleEmitter source;
+            source.regionMin = regionMin;
+            source.regionMax = regionMax;
+            source.rate = emitter.rate;
+            source.velocity = emitter.velocity;
+            source.speed = emitter.speed;
+            source.size = emitter.size;
+            simulation.addEmitter(source);
+        }
+    }
+    for (const auto& zone : scene.killZones) {
+        simulation.addKillZone(zone);
+    }
+    
+    result.objects = simulation.getCollisionObjectCount();
+    result.particles = simulation.getParticles().size();
+    result.instantiateMs = elapsedMs(instantiateStart);
+    return true;
+}
+
+bool loadScene(const std::string& path, Simulation& simulation, AssetCache& assets, SceneDescription& scene, SceneLoadStats* stats) {
+    auto parseStart = std::chrono::steady_clock::now();
+    if (!parseScene(path, scene)) {
+        return false;
+    }
+    if (stats) {
+        stats->parseMs = elapsedMs(parseStart);
+    }
+    return instantiateScene(scene, simulation, assets, stats);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "asset_cache.h"
+#include "simulation.h"
+
+// Scene file format: one directive per line, '#' starts a comment. Properties are a
+// keyword followed by its numbers and may appear in any order after the positional arguments.
+//
+//   bounds <minX minY minZ> <maxX maxY maxZ>    Simulation box (default: objects' bounds, padded by half)
+//   resolution <n>                              Default SDF resolution for assets (64)
+//   seed <n>                                    Random seed for emitters and grid velocities
+//   adaptive <on|off>                           Adaptive substepping
+//   cfl <c>                                     CFL number for adaptive substepping
+//   step_rate <hz>                              Simulation steps per second (for the demos)
+//   sleep <speed> <steps>                       Particles slower than 'speed' for 'steps' steps sleep
+//   reorder <steps>                             Sort particles by position every 'steps' steps
+//   object_gravity <x y z>                      Acceleration of dynamic objects (particles are unaffected)
+//   restitution <e>                             Bounciness of object contacts, 0 to 1 (1)
+//   solver_iterations <n>                       Object contact solver passes per step (8)
+//   asset <name> <path.obj> [resolution n] [size s]
+//                                               Mesh relative to the scene file, or a procedural mesh
+//                                               such as procedural:torus:64; 'size' scales instances
+//                                               so the mesh's largest dimension becomes s
+//   object <asset> [position x y z] [rotation w x y z] [euler x y z] [scale s | scale x y z]
+//                  [mass m] [velocity x y z]    One instance; euler angles in degrees, mass 0 = static
+//   grid <asset> count nx ny nz spacing sx sy sz [origin x y z] [speed s] [object properties]
+//                                               nx * ny * nz instances centered on 'origin'; 'speed' adds
+//                                               a random velocity of that magnitude to each
+//   emitter <count> [min x y z] [max x y z] [speed s] [size r] [rate n] [velocity x y z]
+//                                               Particles spawned in a box (default: the bounds);
+//                                               'rate' keeps spawning n per second after the first
+//                                               'count', moving at 'velocity' plus 'speed'
+//   kill min x y z max x y z                    Particles entering the box are removed
+//   max_particles <n>                           Particle capacity, reserved up front; emitters stop
+//                                               spawning at this count (default: no limit)
+struct SceneDescription {
+    struct Asset {
+        std::string name;
+        std::string path;
+        int resolution;
+        float size;  // Largest dimension instances are normalized to; 0 keeps mesh units
+    };
+    
+    struct Instance {
+        int asset;
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec3 scale = glm::vec3(1.0f);
+        glm::vec3 velocity = glm::vec3(0.0f);
+        float mass = 0.0f;
+    };
+    
+    struct Emitter {
+        int count;
+        bool hasRegion = false;
+        glm::vec3 regionMin = glm::vec3(0.0f);
+        glm::vec3 regionMax = glm::vec3(0.0f);
+        float speed = 1.0f;
+        float size = 0.05f;
+        float rate = 0.0f;  // Particles per second after the first 'count'; 0 = spawn once
+        glm::vec3 velocity = glm::vec3(0.0f);
+    };
+    
+    bool hasBounds = false;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    int resolution = 64;
+    bool hasSeed = false;
+    uint32_t seed = 0;
+    bool adaptive = false;
+    float cflNumber = 0.5f;
+    float stepRate = 0.0f;  // 0 = keep the demo's default
+    bool sleeping = false;
+    float sleepVelocity = 0.0f;
+    int sleepSteps = 0;
+    int reorderInterval = 0;  // 0 = never
+    glm::vec3 objectGravity = glm::vec3(0.0f);
+    float restitution = 1.0f;
+    int solverIterations = 8;
+    size_t maxParticles = 0;  // 0 = no limit
+    std::vector<Asset> assets;
+    std::vector<Instance> instances;
+    std::vector<Emitter> emitters;
+    std::vector<KillZone> killZones;
+};
+
+struct SceneLoadStats {
+    size_t assets = 0;       // Distinct meshes/SDFs used by the scene
+    size_t objects = 0;
+    size_t particles = 0;
+    double parseMs = 0.0;
+    double bakeMs = 0.0;     // Loading and baking assets not already cached
+    double instantiateMs = 0.0;
+};
+
+// Parses 'path' into 'scene'; reports the first error with its line number
+bool parseScene(const std::string& path, SceneDescription& scene);
+// Replaces the contents of 'simulation' with the scene. Assets are deduplicated through
+// 'assets' and the missing ones are baked in parallel before any object is created.
+bool instantiateScene(const SceneDescription& scene, Simulation& simulation, AssetCache& assets, SceneLoadStats* stats = nullptr);
+// parseScene followed by instantiateScene
+bool loadScene(const std::string& path, Simulation& simulation, AssetCache& assets, SceneDescription& scene, SceneLoadStats* stats = nullptr);
@@ -1,7 +1,9 @@
 #include "sdf.h"
+#include "parallel.h"
 #include <iostream>
 #include <limits>
 #include <cmath>
+#include <algorithm>
 
 SDF::SDF(int resolution) : resolution(resolution) {
     data.resize(resolution * resolution * resolution);
@@ -27,35 +29,41 @@ void SDF::generateFromMesh(const Mesh& mesh) {
     
     const auto& triangles = mesh.getTriangles();
     
-    for (int z = 0; z < resolution; ++z) {
-        if (z % 10 == 0) {
-            std::cout << "Progress: " << (100 * z / resolution) << "%" << std::endl;
-        }
-        
-        for (int y = 0; y < resolution; ++y) {
-            for (int x = 0; x < resolution; ++x) {
-                glm::vec3 worldPos = minBounds + glm::vec3(x, y, z) * cellSize;
-                
-                // Use BVH for fast distance calculation
-                float minDistance = bvh.findClosestDistance(worldPos, triangles);
-                
-                // Determine sign (inside/outside) using BVH accelerated ray casting
-                glm::vec3 rayDir(1, 0, 0);
-                int intersections = bvh.countIntersections(worldPos, rayDir, triangles);
-                bool inside = (intersections % 2) == 1;
-                
-                if (inside) {
-                    minDistance = -minDistance;
+    // z-slices are independent; the BVH queries are read-only
+    parallelFor(resolution, 1, [&](size_t begin, size_t end) {
+        for (int z = static_cast<int>(begin); z < static_cast<int>(end); ++z) {
+            for (int y = 0; y < resolution; ++y) {
+                for (int x = 0; x < resolution; ++x) {
+                    glm::vec3 worldPos = minBounds + glm::vec3(x, y, z) * cellSize;
+                    
+                    // Use BVH for fast distance calculation
+                    float minDistance = bvh.findClosestDistance(worldPos, triangles);
+                    
+                    // Determine sign (inside/outside) using BVH accelerated ray casting
+                    glm::vec3 rayDir(1, 0, 0);
+                    int intersections = bvh.countIntersections(worldPos, rayDir, triangles);
+                    bool inside = (intersections % 2) == 1;
+                    
+                    if (inside) {
+                        minDistance = -minDistance;
+                    }
+                    
+                    data[getIndex(x, y, z)] = minDistance;
                 }
-                
-                data[getIndex(x, y, z)] = minDistance;
             }
         }
-    }
+    });
     
     std::cout << "SDF generation complete" << std::endl;
 }
 
+void SDF::setGrid(const glm::vec3& minBounds, const glm::vec3& maxBounds, const float* values) {
+    this->minBounds = minBounds;
+    this->maxBounds = maxBounds;
+    cellSize = (maxBounds - minBounds) / float(resolution - 1);
+    std::copy(values, values + data.size(), data.begin());
+}
+
 float SDF::sample(const glm::vec3& position) const {
     glm::vec3 gridPos = worldToGrid(position);
     
@@ -10,12 +10,19 @@ public:
     SDF(int resolution);
     
     void generateFromMesh(const Mesh& mesh);
+    // Adopts a previously baked grid of resolution^3 values spanning [minBounds, maxBounds]
+    void setGrid(const glm::vec3& minBounds, const glm::vec3& maxBounds, const float* values);
     float sample(const glm::vec3& position) const;
     glm::vec3 gradient(const glm::vec3& position) const;
     
     int getResolution() const { return resolution; }
     glm::vec3 getMin() const { return minBounds; }
     glm::vec3 getMax() const { return maxBounds; }
+    glm::vec3 getCellSize() const { return cellSize; }
+    // Raw distance stored at grid point (x, y, z), located at getMin() + (x, y, z) * getCellSize()
+    float getGridValue(int x, int y, int z) const { return data[getIndex(x, y, z)]; }
+    // All grid values, x fastest
+    const std::vector<float>& getGridData() const { return data; }
     
 private:
     int resolution;
@@ -0,0 +1,120 @@
+#include "shader_program.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+ShaderProgram::ShaderProgram() : program(0) {
+}
+
+ShaderProgram::~ShaderProgram() {
+    destroy();
+}
+
+bool ShaderProgram::create(const char* vertexSource, const char* fragmentSource) {
+    destroy();
+    
+    GLuint vertexShader = compileShader(vertexSource, GL_VERTEX_SHADER);
+    GLuint fragmentShader = compileShader(fragmentSource, GL_FRAGMENT_SHADER);
+    
+    if (vertexShader == 0 || fragmentShader == 0) {
+        if (vertexShader) glDeleteShader(vertexShader);
+        if (fragmentShader) glDeleteShader(fragmentShader);
+        return false;
+    }
+    
+    program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "Shader program linking failed: " << infoLog << std::endl;
+        destroy();
+        return false;
+    }
+    
+    cacheUniformLocations();
+    return true;
+}
+
+void ShaderProgram::destroy() {
+    if (program) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+    uniformLocations.clear();
+}
+
+GLint ShaderProgram::getUniformLocation(const std::string& name) const {
+    auto it = uniformLocations.find(name);
+    if (it == uniformLocations.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+bool ShaderProgram::bindUniformBlock(const char* blockName, GLuint bindingPoint) const {
+    GLuint blockIndex = glGetUniformBlockIndex(program, blockName);
+    if (blockIndex == GL_INVALID_INDEX) {
+        return false;
+    }
+    glUniformBlockBinding(program, blockIndex, bindingPoint);
+    return true;
+}
+
+void ShaderProgram::setMat4(GLint location, const glm::mat4& value) {
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::setVec3(GLint location, const glm::vec3& value) {
+    glUniform3f(location, value.x, value.y, value.z);
+}
+
+GLuint ShaderProgram::compileShader(const char* source, GLenum type) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "Shader compilation failed: " << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    
+    return shader;
+}
+
+void ShaderProgram::cacheUniformLocations() {
+    GLint uniformCount = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    
+    std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+    for (GLint i = 0; i < uniformCount; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()),
+                           &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+        
+        // Uniforms inside blocks report -1 and are addressed through the block instead
+        GLint location = glGetUniformLocation(program, name.c_str());
+        if (location >= 0) {
+            uniformLocations[name] = location;
+        }
+    }
+}
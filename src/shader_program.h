@@ -0,0 +1,39 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+
+// Compiled and linked GLSL program. All active uniform locations are resolved
+// once at link time, so callers look a name up during setup and keep the GLint.
+class ShaderProgram {
+public:
+    ShaderProgram();
+    ~ShaderProgram();
+    
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+    
+    bool create(const char* vertexSource, const char* fragmentSource);
+    void destroy();
+    
+    GLuint getId() const { return program; }
+    bool isValid() const { return program != 0; }
+    
+    // Location of an active uniform, or -1 if the name is unknown (setup-time lookup)
+    GLint getUniformLocation(const std::string& name) const;
+    // Attach a named uniform block to a buffer binding point; returns false if the block is absent
+    bool bindUniformBlock(const char* blockName, GLuint bindingPoint) const;
+    
+    // Uniform setters for locations resolved up front (program must be in use)
+    static void setMat4(GLint location, const glm::mat4& value);
+    static void setVec3(GLint location, const glm::vec3& value);
+
+private:
+    GLuint program;
+    std::unordered_map<std::string, GLint> uniformLocations;
+    
+    GLuint compileShader(const char* source, GLenum type);
+    void cacheUniformLocations();
+};
@@ -1,9 +1,45 @@
 #include "simulation.h"
+#include "asset_cache.h"
+#include "checkpoint.h"
+#include "parallel.h"
+#include "spatial_sort.h"
 #include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <numeric>
+
+// Particles per parallel chunk; results do not depend on it
+static const size_t ParticleChunkSize = 2048;
+
+// Object contact detection and solver tuning, in world units and seconds
+static const float ObjectContactMargin = 0.02f;   // Surfaces closer than this are in contact
+static const float PenetrationSlop = 0.005f;      // Overlap left alone to keep contacts alive
+static const float BaumgarteFactor = 0.2f;        // Fraction of the overlap removed per step
+static const float ManifoldMatchDistance = 0.05f; // Cached point reused within this distance
+
+// Marks an entry of the sleep grid whose particle has woken up
+static const uint32_t RemovedSleeper = std::numeric_limits<uint32_t>::max();
+
+static bool isInsideBox(const glm::vec3& point, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    return point.x >= boxMin.x && point.y >= boxMin.y && point.z >= boxMin.z &&
+           point.x <= boxMax.x && point.y <= boxMax.y && point.z <= boxMax.z;
+}
+
+// Key of an object pair in the contact manifold cache
+static uint64_t makePairKey(uint32_t first, uint32_t second) {
+    return (static_cast<uint64_t>(first) << 32) | second;
+}
 
 Simulation::Simulation(const glm::vec3& boxMin, const glm::vec3& boxMax) 
-    : boundsMin(boxMin), boundsMax(boxMax), particleSystem(100) {
+    : boundsMin(boxMin), boundsMax(boxMax), particleSystem(100), stepCount(0), simulationTime(0.0),
+      adaptiveSubstepping(false), perIslandSubstepping(true), cflNumber(0.5f), maxAdaptiveSubsteps(16),
+      particlesBeforeFlow(0), particlesBeforeEmission(0), particleSleeping(false), sleepVelocity(0.01f),
+      sleepSteps(30), firstAwakeParticle(0), sleepGridCount(0), sleepGridRemoved(0), sleepGridSize(0),
+      sleepCellSize(1.0f), maxSleepingRadius(0.0f), sleepGridDirty(true), reorderInterval(0),
+      reorderedLastUpdate(false), reorderStart(0), solverIterations(8), warmStarting(true), restitution(1.0f),
+      objectGravity(0.0f) {
 }
 
 Simulation::~Simulation() {
@@ -11,42 +47,579 @@ Simulation::~Simulation() {
 }
 
 void Simulation::initialize(int numParticles, float particleSpeed, float particleSize) {
-    particleSystem = ParticleSystem(numParticles);
-    particleSystem.initialize(boundsMin, boundsMax, particleSpeed);
-    particleSystem.setParticleSize(particleSize);
+    particleSystem.setParticleCount(numParticles);
+    particleSystem.initialize(boundsMin, boundsMax, particleSpeed, particleSize);
+    firstAwakeParticle = 0;
+    reorderedLastUpdate = false;
+    sleepGridDirty = true;
+}
+
+void Simulation::addParticles(int count, const glm::vec3& regionMin, const glm::vec3& regionMax, float speed, float size,
+                              const glm::vec3& velocity) {
+    particleSystem.addParticles(count, regionMin, regionMax, speed, size, velocity);
+}
+
+void Simulation::addEmitter(const ParticleEmitter& emitter) {
+    emitters.push_back(emitter);
+    emissionCredit.push_back(0.0f);
+}
+
+void Simulation::clearEmitters() {
+    emitters.clear();
+    emissionCredit.clear();
+}
+
+void Simulation::applyKillZones() {
+    if (killZones.empty()) {
+        return;
+    }
+    // Sleeping particles do not move, so only awake ones can have entered a zone
+    const Particle* awake = getAwakeParticles();
+    size_t awakeCount = getAwakeParticleCount();
+    size_t chunkCount = (awakeCount + ParticleChunkSize - 1) / ParticleChunkSize;
+    if (killLists.size() < chunkCount) {
+        killLists.resize(chunkCount);
+    }
+    parallelFor(awakeCount, ParticleChunkSize, [&](size_t begin, size_t end) {
+        std::vector<uint32_t>& killed = killLists[begin / ParticleChunkSize];
+        killed.clear();
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 pos = awake[i].getPosition();
+            for (const auto& zone : killZones) {
+                if (isInsideBox(pos, zone.regionMin, zone.regionMax)) {
+                    killed.push_back(static_cast<uint32_t>(firstAwakeParticle + i));
+                    break;
+                }
+            }
+        }
+    });
+    
+    // Highest index first: the particle moved into a freed slot then comes from beyond
+    // every index still to be removed, so it is never one that is marked itself
+    std::vector<Particle>& particles = particleSystem.getParticles();
+    size_t countBefore = particles.size();
+    for (size_t chunk = chunkCount; chunk-- > 0;) {
+        const std::vector<uint32_t>& killed = killLists[chunk];
+        for (size_t k = killed.size(); k-- > 0;) {
+            uint32_t last = static_cast<uint32_t>(particles.size() - 1);
+            if (killed[k] != last) {
+                particleMoves.push_back({last, killed[k], false});
+            }
+            particleSystem.removeParticle(killed[k]);
+        }
+    }
+    flowStats.killed += countBefore - particles.size();
+}
+
+void Simulation::emitParticles(float deltaTime) {
+    for (size_t i = 0; i < emitters.size(); ++i) {
+        const ParticleEmitter& emitter = emitters[i];
+        emissionCredit[i] += emitter.rate * deltaTime;
+        int count = static_cast<int>(emissionCredit[i]);
+        if (count == 0) {
+            continue;
+        }
+        emissionCredit[i] -= count;
+        int added = particleSystem.addParticles(count, emitter.regionMin, emitter.regionMax, emitter.speed,
+                                                emitter.size, emitter.velocity);
+        flowStats.emitted += added;
+        flowStats.dropped += count - added;
+    }
+}
+
+void Simulation::setParticleSleeping(bool enabled) {
+    particleSleeping = enabled;
+    if (!enabled) {
+        wakeAllParticles();
+    }
+}
+
+void Simulation::setSleepThreshold(float velocity, int steps) {
+    sleepVelocity = std::max(velocity, 0.0f);
+    sleepSteps = static_cast<uint32_t>(std::max(steps, 1));
+}
+
+void Simulation::wakeAllParticles() {
+    std::vector<Particle>& particles = particleSystem.getParticles();
+    for (size_t i = 0; i < firstAwakeParticle; ++i) {
+        particles[i].setRestSteps(0);
+    }
+    firstAwakeParticle = 0;
+    sleepGridDirty = true;
+}
+
+void Simulation::putRestingParticlesToSleep() {
+    Particle* awake = getAwakeParticles();
+    size_t awakeCount = getAwakeParticleCount();
+    size_t chunkCount = (awakeCount + ParticleChunkSize - 1) / ParticleChunkSize;
+    if (sleepLists.size() < chunkCount) {
+        sleepLists.resize(chunkCount);
+    }
+    float thresholdSquared = sleepVelocity * sleepVelocity;
+    parallelFor(awakeCount, ParticleChunkSize, [&](size_t begin, size_t end) {
+        std::vector<uint32_t>& resting = sleepLists[begin / ParticleChunkSize];
+        resting.clear();
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 velocity = awake[i].getVelocity();
+            if (glm::dot(velocity, velocity) >= thresholdSquared) {
+                awake[i].setRestSteps(0);
+                continue;
+            }
+            uint32_t steps = awake[i].getRestSteps() + 1;
+            awake[i].setRestSteps(steps);
+            if (steps >= sleepSteps) {
+                resting.push_back(static_cast<uint32_t>(firstAwakeParticle + i));
+            }
+        }
+    });
+    
+    // In index order each new sleeper swaps with the first awake particle, which is never
+    // one still to be moved: those all sit at or after the current index
+    std::vector<Particle>& particles = particleSystem.getParticles();
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        for (uint32_t index : sleepLists[chunk]) {
+            particles[index].setVelocity(glm::vec3(0.0f));
+            maxSleepingRadius = std::max(maxSleepingRadius, particles[index].getSize());
+            if (index != firstAwakeParticle) {
+                std::swap(particles[index], particles[firstAwakeParticle]);
+                particleMoves.push_back({index, static_cast<uint32_t>(firstAwakeParticle), true});
+            }
+            firstAwakeParticle++;
+        }
+    }
+}
+
+// Grids the sleepers [0, sleeping)
+void Simulation::rebuildSleepGrid(size_t sleeping) {
+    const std::vector<Particle>& particles = particleSystem.getParticles();
+    
+    // About four sleepers per cell, and at most 128 cells along the longest axis
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+    float cell = std::cbrt(extent.x * extent.y * extent.z * 4.0f / float(std::max<size_t>(sleeping, 1)));
+    cell = std::max(cell, std::max({extent.x, extent.y, extent.z}) / 128.0f);
+    sleepGridSize = glm::max(glm::ivec3(glm::ceil(extent / cell)), glm::ivec3(1));
+    sleepCellSize = extent / glm::vec3(sleepGridSize);
+    
+    // Counting sort of the sleepers by cell
+    size_t cellCount = size_t(sleepGridSize.x) * sleepGridSize.y * sleepGridSize.z;
+    sleepCellStart.assign(cellCount + 1, 0);
+    sleepCellParticles.resize(sleeping);
+    sleepGridEntry.resize(sleeping);
+    maxSleepingRadius = 0.0f;
+    auto cellOf = [&](const glm::vec3& pos) {
+        glm::ivec3 c = glm::clamp(glm::ivec3(glm::floor((pos - boundsMin) / sleepCellSize)), glm::ivec3(0), sleepGridSize - 1);
+        return (size_t(c.z) * sleepGridSize.y + c.y) * sleepGridSize.x + c.x;
+    };
+    for (size_t i = 0; i < sleeping; ++i) {
+        sleepCellStart[cellOf(particles[i].getPosition()) + 1]++;
+        maxSleepingRadius = std::max(maxSleepingRadius, particles[i].getSize());
+    }
+    for (size_t c = 0; c < cellCount; ++c) {
+        sleepCellStart[c + 1] += sleepCellStart[c];
+    }
+    for (size_t i = 0; i < sleeping; ++i) {
+        uint32_t entry = sleepCellStart[cellOf(particles[i].getPosition())]++;
+        sleepCellParticles[entry] = static_cast<uint32_t>(i);
+        sleepGridEntry[i] = entry;
+    }
+    // Filling advanced each start to the next cell's; shift them back
+    for (size_t c = cellCount; c > 0; --c) {
+        sleepCellStart[c] = sleepCellStart[c - 1];
+    }
+    sleepCellStart[0] = 0;
+    sleepGridCount = sleeping;
+    sleepGridRemoved = 0;
+    sleepGridDirty = false;
+}
+
+// Moves a sleeping particle to the front of the awake range. A particle in the grid first
+// swaps with the grid's last particle, so grid particles stay in one range.
+void Simulation::wakeParticle(uint32_t index) {
+    std::vector<Particle>& particles = particleSystem.getParticles();
+    particles[index].setRestSteps(0);
+    if (index < sleepGridCount) {
+        uint32_t lastInGrid = static_cast<uint32_t>(sleepGridCount - 1);
+        sleepCellParticles[sleepGridEntry[index]] = RemovedSleeper;
+        if (index != lastInGrid) {
+            std::swap(particles[index], particles[lastInGrid]);
+            particleMoves.push_back({index, lastInGrid, true});
+            sleepGridEntry[index] = sleepGridEntry[lastInGrid];
+            sleepCellParticles[sleepGridEntry[index]] = index;
+            index = lastInGrid;
+        }
+        sleepGridCount--;
+        sleepGridRemoved++;
+    }
+    uint32_t lastSleeping = static_cast<uint32_t>(firstAwakeParticle - 1);
+    if (index != lastSleeping) {
+        std::swap(particles[index], particles[lastSleeping]);
+        particleMoves.push_back({index, lastSleeping, true});
+    }
+    firstAwakeParticle--;
+}
+
+void Simulation::wakeParticlesNearMovingObjects(float deltaTime) {
+    // Rebuilding costs a pass over all sleepers, so it waits until the particles tested one by
+    // one or the removed entries are a sizeable fraction of the grid
+    size_t ungridded = firstAwakeParticle - std::min(sleepGridCount, firstAwakeParticle);
+    if (sleepGridDirty || sleepGridCount > firstAwakeParticle || ungridded > std::max<size_t>(256, sleepGridCount / 8)
+        || sleepGridRemoved > sleepGridCount / 4) {
+        rebuildSleepGrid(firstAwakeParticle);
+    }
+    std::vector<Particle>& particles = particleSystem.getParticles();
+    wakeList.clear();
+    for (const auto& obj : collisionObjects) {
+        if (!obj || !obj->isValid() || obj->isStatic()) {
+            continue;
+        }
+        // Everything the object can reach this step, in any direction since collisions
+        // during the step may turn it
+        float reach = glm::length(obj->getVelocity()) * deltaTime;
+        if (reach <= 0.0f) {
+            continue;
+        }
+        glm::vec3 reachMin = obj->getWorldMin() - glm::vec3(reach);
+        glm::vec3 reachMax = obj->getWorldMax() + glm::vec3(reach);
+        auto testParticle = [&](uint32_t index) {
+            glm::vec3 radius(particles[index].getSize());
+            if (isInsideBox(particles[index].getPosition(), reachMin - radius, reachMax + radius)) {
+                wakeList.push_back(index);
+            }
+        };
+        glm::ivec3 cellMin = glm::clamp(glm::ivec3(glm::floor((reachMin - maxSleepingRadius - boundsMin) / sleepCellSize)),
+                                        glm::ivec3(0), sleepGridSize - 1);
+        glm::ivec3 cellMax = glm::clamp(glm::ivec3(glm::floor((reachMax + maxSleepingRadius - boundsMin) / sleepCellSize)),
+                                        glm::ivec3(0), sleepGridSize - 1);
+        for (int z = cellMin.z; z <= cellMax.z; ++z) {
+            for (int y = cellMin.y; y <= cellMax.y; ++y) {
+                for (int x = cellMin.x; x <= cellMax.x; ++x) {
+                    size_t cell = (size_t(z) * sleepGridSize.y + y) * sleepGridSize.x + x;
+                    for (uint32_t k = sleepCellStart[cell]; k < sleepCellStart[cell + 1]; ++k) {
+                        if (sleepCellParticles[k] != RemovedSleeper) {
+                            testParticle(sleepCellParticles[k]);
+                        }
+                    }
+                }
+            }
+        }
+        for (size_t i = sleepGridCount; i < firstAwakeParticle; ++i) {
+            testParticle(static_cast<uint32_t>(i));
+        }
+    }
+    
+    // Highest index first: every swap then takes a particle from beyond the current index,
+    // which is never one still to be woken
+    std::sort(wakeList.begin(), wakeList.end(), std::greater<uint32_t>());
+    wakeList.erase(std::unique(wakeList.begin(), wakeList.end()), wakeList.end());
+    for (uint32_t index : wakeList) {
+        wakeParticle(index);
+    }
+}
+
+void Simulation::reorderParticles() {
+    std::vector<Particle>& particles = particleSystem.getParticles();
+    const Particle* awake = getAwakeParticles();
+    size_t awakeCount = getAwakeParticleCount();
+    reorderKeys.resize(awakeCount);
+    reorderSource.resize(awakeCount);
+    parallelFor(awakeCount, ParticleChunkSize, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            reorderKeys[i] = mortonCode(awake[i].getPosition(), boundsMin, boundsMax);
+            reorderSource[i] = static_cast<uint32_t>(firstAwakeParticle + i);
+        }
+    });
+    radixSortPairs(reorderKeys, reorderSource, 30, reorderScratch);
+    
+    reorderBuffer.resize(awakeCount);
+    parallelFor(awakeCount, ParticleChunkSize, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            reorderBuffer[i] = particles[reorderSource[i]];
+        }
+    });
+    std::copy(reorderBuffer.begin(), reorderBuffer.end(), particles.begin() + firstAwakeParticle);
+    reorderStart = firstAwakeParticle;
+    reorderedLastUpdate = true;
+}
+
+void Simulation::accumulateParticleRemap(std::vector<uint32_t>& remap) const {
+    // Replay the last update's slot changes on the entries it started with
+    remap.resize(particlesBeforeFlow, NewParticle);
+    for (const auto& move : particleMoves) {
+        if (move.exchange) {
+            std::swap(remap[move.to], remap[move.from]);
+        } else {
+            remap[move.to] = remap[move.from];
+        }
+    }
+    remap.resize(particlesBeforeEmission);
+    remap.resize(particleSystem.getParticles().size(), NewParticle);
+    
+    if (reorderedLastUpdate) {
+        std::vector<uint32_t> beforeReorder(remap.begin() + reorderStart, remap.end());
+        for (size_t i = 0; i < reorderSource.size(); ++i) {
+            remap[reorderStart + i] = beforeReorder[reorderSource[i] - reorderStart];
+        }
+    }
 }
 
 void Simulation::update(float deltaTime) {
-    // Update collision object physics (position based on velocity)
-    for (auto& obj : collisionObjects) {
-        if (obj && obj->isValid()) {
-            obj->updatePhysics(deltaTime);
+    particlesBeforeFlow = particleSystem.getParticles().size();
+    particleMoves.clear();
+    reorderedLastUpdate = false;
+    contactStats = ContactStats();
+    if (firstAwakeParticle > 0) {
+        wakeParticlesNearMovingObjects(deltaTime);
+    }
+    
+    if (adaptiveSubstepping) {
+        updateAdaptive(deltaTime);
+    } else {
+        // Objects and particles do not affect each other until particle-object collisions,
+        // so the two integration phases run concurrently
+        TaskGraph phases;
+        int objectPhase = phases.addTask([this, deltaTime]() { integrateCollisionObjects(deltaTime); });
+        int particlePhase = phases.addTask([this, deltaTime]() { integrateParticles(deltaTime); });
+        phases.addTask([this]() { handleMultipleCollisionObjectCollisions(); }, {objectPhase, particlePhase});
+        phases.run();
+    }
+    
+    applyKillZones();
+    if (particleSleeping) {
+        putRestingParticlesToSleep();
+    }
+    particlesBeforeEmission = particleSystem.getParticles().size();
+    emitParticles(deltaTime);
+    stepCount++;
+    simulationTime += deltaTime;
+    if (reorderInterval > 0 && stepCount % reorderInterval == 0) {
+        reorderParticles();
+    }
+}
+
+void Simulation::captureSnapshot(SimulationSnapshot& snapshot) const {
+    // Assignment reuses the snapshot's existing capacity
+    snapshot.particles = particleSystem.getParticles();
+    
+    // Kills, sleeping, waking and emissions in the last update moved particles between slots.
+    // If the previous positions were taken before that update, move them along; new
+    // particles start in place.
+    std::vector<glm::vec3>& previous = snapshot.previousParticlePositions;
+    if (previous.size() == particlesBeforeFlow) {
+        for (const auto& move : particleMoves) {
+            if (move.exchange) {
+                std::swap(previous[move.to], previous[move.from]);
+            } else {
+                previous[move.to] = previous[move.from];
+            }
+        }
+        previous.resize(particlesBeforeEmission);
+        if (reorderedLastUpdate) {
+            // Awake particles were then sorted; emitted ones have no previous position yet
+            std::vector<glm::vec3> beforeReorder(previous.begin() + reorderStart, previous.end());
+            previous.resize(snapshot.particles.size());
+            for (size_t i = 0; i < reorderSource.size(); ++i) {
+                uint32_t source = reorderSource[i];
+                size_t index = reorderStart + i;
+                previous[index] = source < particlesBeforeEmission ? beforeReorder[source - reorderStart]
+                                                                   : snapshot.particles[index].getPosition();
+            }
+        } else {
+            for (size_t i = particlesBeforeEmission; i < snapshot.particles.size(); ++i) {
+                previous.push_back(snapshot.particles[i].getPosition());
+            }
         }
     }
     
-    // Check collision object bounds and bounce if needed
-    updateCollisionObjectBounds();
+    snapshot.objects.clear();
+    for (const auto& obj : collisionObjects) {
+        if (!obj || !obj->isValid()) {
+            continue;
+        }
+        SimulationSnapshot::ObjectState state;
+        state.mesh = &obj->getMesh();
+        state.surfaceLodCount = obj->getSurfaceLodCount();
+        for (int level = 0; level < MaxSurfaceLods; ++level) {
+            state.surfaceLods[level] = level < state.surfaceLodCount ? &obj->getSurfaceLod(level) : nullptr;
+        }
+        state.transform = obj->getTransformMatrix();
+        state.position = obj->getPosition();
+        state.rotation = obj->getRotation();
+        state.scale = obj->getScale();
+        state.velocity = obj->getVelocity();
+        snapshot.objects.push_back(state);
+    }
     
-    // Handle mesh-to-mesh collisions
-    handleMeshToMeshCollisions();
+    snapshot.boundsMin = boundsMin;
+    snapshot.boundsMax = boundsMax;
+    snapshot.stepCount = stepCount;
+    snapshot.simulationTime = simulationTime;
+    snapshot.substeps = substepStats;
+    snapshot.contacts = contactStats;
+    snapshot.sleepingParticles = firstAwakeParticle;
+}
+
+void Simulation::captureCheckpoint(SimulationCheckpoint& checkpoint) const {
+    checkpoint.boundsMin = boundsMin;
+    checkpoint.boundsMax = boundsMax;
+    checkpoint.stepCount = stepCount;
+    checkpoint.simulationTime = simulationTime;
+    checkpoint.adaptiveSubstepping = adaptiveSubstepping;
+    checkpoint.perIslandSubstepping = perIslandSubstepping;
+    checkpoint.cflNumber = cflNumber;
+    checkpoint.maxAdaptiveSubsteps = maxAdaptiveSubsteps;
+    checkpoint.particleSleeping = particleSleeping;
+    checkpoint.sleepVelocity = sleepVelocity;
+    checkpoint.sleepSteps = static_cast<int>(sleepSteps);
+    checkpoint.sleepingParticles = firstAwakeParticle;
+    checkpoint.griddedSleepers = std::min(sleepGridCount, firstAwakeParticle);
+    checkpoint.sleepGridRemoved = sleepGridRemoved;
+    checkpoint.sleepGridDirty = sleepGridDirty || sleepGridCount > firstAwakeParticle;
+    checkpoint.reorderInterval = static_cast<int>(reorderInterval);
+    checkpoint.solverIterations = solverIterations;
+    checkpoint.warmStarting = warmStarting;
+    checkpoint.restitution = restitution;
+    checkpoint.objectGravity = objectGravity;
+    checkpoint.particleCapacity = particleSystem.getCapacity();
+    checkpoint.emitters = emitters;
+    checkpoint.emissionCredit = emissionCredit;
+    checkpoint.killZones = killZones;
+    checkpoint.flowStats = flowStats;
+    checkpoint.randomState = particleSystem.getRandomState();
     
-    // Update particle positions
-    particleSystem.update(deltaTime);
+    checkpoint.objects.clear();
+    for (const auto& obj : collisionObjects) {
+        if (!obj || !obj->isValid()) {
+            continue;
+        }
+        SimulationCheckpoint::ObjectRecord record;
+        record.assetKey = obj->getAssetKey();
+        record.position = obj->getPosition();
+        record.rotation = obj->getRotation();
+        record.scale = obj->getScale();
+        record.velocity = obj->getVelocity();
+        record.mass = obj->getMass();
+        checkpoint.objects.push_back(record);
+    }
+    
+    // Cached contacts in pair order, so equal states give equal files
+    std::vector<uint64_t> pairs;
+    for (const auto& entry : contactManifolds) {
+        pairs.push_back(entry.first);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    checkpoint.contacts.clear();
+    for (uint64_t pair : pairs) {
+        const ContactManifold& manifold = contactManifolds.at(pair);
+        for (int k = 0; k < manifold.pointCount; ++k) {
+            checkpoint.contacts.push_back({static_cast<uint32_t>(pair >> 32), static_cast<uint32_t>(pair),
+                                           manifold.offsets[k], manifold.impulses[k], manifold.deltaTime});
+        }
+    }
+    
+    // Assignment reuses the checkpoint's existing capacity
+    checkpoint.particles = particleSystem.getParticles();
+}
+
+bool Simulation::restoreCheckpoint(SimulationCheckpoint& checkpoint, AssetCache& assets) {
+    // Build everything that can fail before touching the current state
+    std::vector<std::unique_ptr<CollisionObject>> objects;
+    for (const auto& record : checkpoint.objects) {
+        std::unique_ptr<CollisionObject> obj = record.assetKey.empty() ? nullptr : assets.instantiate(record.assetKey);
+        if (!obj) {
+            std::cerr << "Cannot restore collision object '" << record.assetKey << "'" << std::endl;
+            return false;
+        }
+        obj->setPosition(record.position);
+        obj->setRotation(record.rotation);
+        obj->setScale(record.scale);
+        obj->setVelocity(record.velocity);
+        obj->setMass(record.mass);
+        objects.push_back(std::move(obj));
+    }
+    if (!particleSystem.setRandomState(checkpoint.randomState)) {
+        std::cerr << "Cannot restore random number generator state" << std::endl;
+        return false;
+    }
     
-    // Handle wall collisions
-    handleWallCollisions();
+    collisionObjects = std::move(objects);
+    contactManifolds.clear();
+    for (const auto& contact : checkpoint.contacts) {
+        if (contact.first >= collisionObjects.size() || contact.second >= collisionObjects.size()) {
+            continue;
+        }
+        ContactManifold& manifold = contactManifolds[makePairKey(contact.first, contact.second)];
+        if (manifold.pointCount < MaxManifoldPoints) {
+            manifold.offsets[manifold.pointCount] = contact.offset;
+            manifold.impulses[manifold.pointCount] = contact.impulse;
+            manifold.pointCount++;
+        }
+        manifold.step = checkpoint.stepCount;
+        manifold.deltaTime = contact.deltaTime;
+    }
+    particleSystem.getParticles().swap(checkpoint.particles);
+    particleSystem.setParticleCount(static_cast<int>(particleSystem.getParticles().size()));
+    // Sleepers are stored first and keep their rest steps
+    firstAwakeParticle = std::min(checkpoint.sleepingParticles, particleSystem.getParticles().size());
+    reorderedLastUpdate = false;
+    particleSleeping = checkpoint.particleSleeping;
+    setSleepThreshold(checkpoint.sleepVelocity, checkpoint.sleepSteps);
+    setSpatialReorderInterval(checkpoint.reorderInterval);
+    setSolverIterations(checkpoint.solverIterations);
+    setWarmStarting(checkpoint.warmStarting);
+    setRestitution(checkpoint.restitution);
+    setObjectGravity(checkpoint.objectGravity);
+    particleSystem.setCapacity(checkpoint.particleCapacity);
+    emitters = checkpoint.emitters;
+    emissionCredit = checkpoint.emissionCredit;
+    emissionCredit.resize(emitters.size(), 0.0f);
+    killZones = checkpoint.killZones;
+    flowStats = checkpoint.flowStats;
+    boundsMin = checkpoint.boundsMin;
+    boundsMax = checkpoint.boundsMax;
+    stepCount = checkpoint.stepCount;
+    simulationTime = checkpoint.simulationTime;
+    adaptiveSubstepping = checkpoint.adaptiveSubstepping;
+    perIslandSubstepping = checkpoint.perIslandSubstepping;
+    cflNumber = checkpoint.cflNumber;
+    maxAdaptiveSubsteps = checkpoint.maxAdaptiveSubsteps;
+    // Wake-ups swap with the last gridded sleeper, so the grid must cover the same sleepers
+    // as when the checkpoint was taken for the particle order to continue unchanged
+    if (checkpoint.sleepGridDirty) {
+        sleepGridDirty = true;
+    } else {
+        rebuildSleepGrid(std::min(checkpoint.griddedSleepers, firstAwakeParticle));
+        sleepGridRemoved = checkpoint.sleepGridRemoved;
+    }
+    return true;
+}
+
+void Simulation::capturePreviousState(SimulationSnapshot& snapshot) const {
+    const std::vector<Particle>& particles = particleSystem.getParticles();
+    snapshot.previousParticlePositions.resize(particles.size());
+    for (size_t i = 0; i < particles.size(); ++i) {
+        snapshot.previousParticlePositions[i] = particles[i].getPosition();
+    }
     
-    // Handle collisions with all collision objects
-    handleMultipleCollisionObjectCollisions();
+    snapshot.previousObjectPoses.clear();
+    for (const auto& obj : collisionObjects) {
+        if (!obj || !obj->isValid()) {
+            continue;
+        }
+        SimulationSnapshot::ObjectPose pose;
+        pose.position = obj->getPosition();
+        pose.rotation = obj->getRotation();
+        pose.scale = obj->getScale();
+        snapshot.previousObjectPoses.push_back(pose);
+    }
 }
 
 void Simulation::addCollisionObject(std::unique_ptr<CollisionObject> collisionObject) {
-    std::cout << "Inside addCollisionObject. Is collisionObject valid? " << (collisionObject && collisionObject->isValid() ? "Yes" : "No") << std::endl;
+    // Scenes add objects one by one, so only a rejected object is reported
     if (collisionObject && collisionObject->isValid()) {
         collisionObjects.push_back(std::move(collisionObject));
-        std::cout << "Collision object added to vector. Vector size: " << collisionObjects.size() << std::endl;
+        wakeAllParticles();
     } else {
-        std::cout << "Collision object NOT added to vector." << std::endl;
+        std::cerr << "Collision object is not valid and was not added" << std::endl;
     }
 }
 
@@ -54,6 +627,8 @@ void Simulation::addCollisionObject(std::unique_ptr<CollisionObject> collisionOb
 
 void Simulation::clearCollisionObjects() {
     collisionObjects.clear();
+    contactManifolds.clear();
+    wakeAllParticles();
 }
 
 const std::vector<Particle>& Simulation::getParticles() const {
@@ -62,6 +637,39 @@ const std::vector<Particle>& Simulation::getParticles() const {
 
 void Simulation::setParticleSize(float size) {
     particleSystem.setParticleSize(size);
+    sleepGridDirty = true;
+}
+
+void Simulation::integrateCollisionObjects(float deltaTime) {
+    // New velocities first: gravity, then the contacts found at the current poses
+    for (auto& obj : collisionObjects) {
+        if (obj && obj->isValid() && !obj->isStatic()) {
+            obj->setVelocity(obj->getVelocity() + objectGravity * deltaTime);
+        }
+    }
+    handleMeshToMeshCollisions(deltaTime);
+    
+    // Update collision object physics (position based on velocity)
+    for (auto& obj : collisionObjects) {
+        if (obj && obj->isValid()) {
+            obj->updatePhysics(deltaTime);
+        }
+    }
+    
+    // Check collision object bounds and bounce if needed
+    updateCollisionObjectBounds();
+    pruneContactManifolds();
+}
+
+void Simulation::integrateParticles(float deltaTime) {
+    // Particles are independent until they meet an object: move each one and bounce it off the walls
+    Particle* particles = getAwakeParticles();
+    parallelFor(getAwakeParticleCount(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            particles[i].update(deltaTime);
+            resolveParticleWallCollision(particles[i]);
+        }
+    });
 }
 
 void Simulation::handleWallCollisions() {
@@ -69,26 +677,30 @@ void Simulation::handleWallCollisions() {
     std::vector<Particle>& particles = particleSystem.getParticles();
     
     for (auto& particle : particles) {
-        glm::vec3 normal;
-        if (checkWallCollision(particle, normal)) {
-            // Reflect velocity
-            glm::vec3 newVelocity = reflectVelocity(particle.getVelocity(), normal);
-            particle.setVelocity(newVelocity);
-            
-            // Correct position to prevent penetration
-            glm::vec3 pos = particle.getPosition();
-            float radius = particle.getSize();
-            
-            // Push particle back inside bounds
-            if (pos.x - radius < boundsMin.x) pos.x = boundsMin.x + radius;
-            if (pos.x + radius > boundsMax.x) pos.x = boundsMax.x - radius;
-            if (pos.y - radius < boundsMin.y) pos.y = boundsMin.y + radius;
-            if (pos.y + radius > boundsMax.y) pos.y = boundsMax.y - radius;
-            if (pos.z - radius < boundsMin.z) pos.z = boundsMin.z + radius;
-            if (pos.z + radius > boundsMax.z) pos.z = boundsMax.z - radius;
-            
-            particle.setPosition(pos);
-        }
+        resolveParticleWallCollision(particle);
+    }
+}
+
+void Simulation::resolveParticleWallCollision(Particle& particle) {
+    glm::vec3 normal;
+    if (checkWallCollision(particle, normal)) {
+        // Reflect velocity
+        glm::vec3 newVelocity = reflectVelocity(particle.getVelocity(), normal);
+        particle.setVelocity(newVelocity);
+        
+        // Correct position to prevent penetration
+        glm::vec3 pos = particle.getPosition();
+        float radius = particle.getSize();
+        
+        // Push particle back inside bounds
+        if (pos.x - radius < boundsMin.x) pos.x = boundsMin.x + radius;
+        if (pos.x + radius > boundsMax.x) pos.x = boundsMax.x - radius;
+        if (pos.y - radius < boundsMin.y) pos.y = boundsMin.y + radius;
+        if (pos.y + radius > boundsMax.y) pos.y = boundsMax.y - radius;
+        if (pos.z - radius < boundsMin.z) pos.z = boundsMin.z + radius;
+        if (pos.z + radius > boundsMax.z) pos.z = boundsMax.z - radius;
+        
+        particle.setPosition(pos);
     }
 }
 
@@ -143,40 +755,134 @@ bool Simulation::checkWallCollision(const Particle& particle, glm::vec3& normal)
 void Simulation::handleMultipleCollisionObjectCollisions() {
     if (collisionObjects.empty()) return;
     
-    std::vector<Particle>& particles = particleSystem.getParticles();
+    Particle* particles = getAwakeParticles();
+    size_t particleCount = getAwakeParticleCount();
+    beginParticleContacts(particleCount);
+    parallelFor(particleCount, ParticleChunkSize, [&](size_t begin, size_t end) {
+        ContactBuffer& contacts = particleChunkContacts[begin / ParticleChunkSize];
+        for (size_t i = begin; i < end; ++i) {
+            detectParticleContacts(particles[i], static_cast<uint32_t>(i), contacts);
+        }
+    });
+    resolveParticleContacts(particles, particleCount);
+}
+
+void Simulation::refreshObjectTransforms() {
+    // Refresh every cached transform so the parallel SDF queries only read shared state
+    for (const auto& obj : collisionObjects) {
+        if (obj && obj->isValid()) {
+            obj->getInverseTransformMatrix();
+        }
+    }
+}
+
+void Simulation::beginParticleContacts(size_t particleCount) {
+    refreshObjectTransforms();
+    // Only grows, so buffers keep their storage while emitters and kill zones change the count
+    size_t chunkCount = (particleCount + ParticleChunkSize - 1) / ParticleChunkSize;
+    if (particleChunkContacts.size() < chunkCount) {
+        particleChunkContacts.resize(chunkCount);
+    }
+    // Room for one contact per particle, the usual case, so chunks rarely grow mid-pass
+    for (auto& contacts : particleChunkContacts) {
+        contacts.clear();
+        contacts.reserve(ParticleChunkSize);
+    }
+}
+
+void Simulation::detectParticleContacts(const Particle& particle, uint32_t index, ContactBuffer& contacts) const {
+    glm::vec3 pos = particle.getPosition();
+    float radius = particle.getSize();
     
-    for (auto& particle : particles) {
-        glm::vec3 pos = particle.getPosition();
-        float radius = particle.getSize();
-          // Check collision with each collision object
-        for (auto& obj : collisionObjects) {
-            if (!obj || !obj->isValid()) continue;
-            
-            // Sample SDF at particle position
-            float distance = obj->getSignedDistance(pos);
-            
-            // Check for collision (particle inside or very close to mesh surface)
-            if (distance < radius) {
-                // Get surface normal using SDF gradient
-                glm::vec3 normal = obj->getNormal(pos);
-                  // Normalize if not zero
-                if (glm::length(normal) > 0.001f) {
-                    normal = glm::normalize(normal);
-                    
-                    // Calculate collision response considering masses
-                    glm::vec3 newVelocity = calculateCollisionResponse(particle, *obj, normal);
-                    particle.setVelocity(newVelocity);
-                    
-                    // Push particle outside mesh surface
-                    glm::vec3 correctedPos = pos + normal * (radius - distance + 0.001f);
-                    particle.setPosition(correctedPos);
-                    
-                    // Break after first collision to avoid double corrections
-                    break;
+    for (size_t k = 0; k < collisionObjects.size(); ++k) {
+        const auto& obj = collisionObjects[k];
+        if (!obj || !obj->isValid()) continue;
+        
+        // Particle inside or within its radius of the surface
+        float distance = obj->getSignedDistance(pos);
+        if (distance >= radius) {
+            continue;
+        }
+        // Surface normal from the SDF gradient; skipped where the gradient vanishes
+        glm::vec3 normal = obj->getNormal(pos);
+        if (glm::length(normal) <= 0.001f) {
+            continue;
+        }
+        normal = glm::normalize(normal);
+        contacts.add(index, static_cast<uint32_t>(k), pos - normal * distance, normal, radius - distance);
+    }
+}
+
+// A contact with a static object only changes the particle, so particles whose contacts are
+// all static are resolved in parallel. A contact with a dynamic object also changes the
+// object's velocity, which later contacts see, so particles touching one are resolved
+// serially in particle order. Either way the result is that of a serial loop over the
+// contacts, for any thread count.
+void Simulation::resolveParticleContacts(Particle* particles, size_t particleCount) {
+    size_t chunkCount = (particleCount + ParticleChunkSize - 1) / ParticleChunkSize;
+    particleContacts.clear();
+    particleChunkOffsets.resize(chunkCount + 1);
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        particleChunkOffsets[chunk] = particleContacts.size();
+        particleContacts.append(particleChunkContacts[chunk]);
+    }
+    particleChunkOffsets[chunkCount] = particleContacts.size();
+    if (particleContacts.empty()) {
+        return;
+    }
+    
+    // A particle's contacts are adjacent; returns the end of the group starting at 'begin'
+    // and whether any of them is with a dynamic object
+    auto particleGroup = [this](size_t begin, bool& dynamic) {
+        uint32_t particle = particleContacts.getFirst(begin);
+        size_t end = begin;
+        dynamic = false;
+        while (end < particleContacts.size() && particleContacts.getFirst(end) == particle) {
+            dynamic = dynamic || !collisionObjects[particleContacts.getSecond(end)]->isStatic();
+            end++;
+        }
+        return end;
+    };
+    
+    parallelFor(chunkCount, 1, [&](size_t chunkBegin, size_t chunkEnd) {
+        for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+            size_t contact = particleChunkOffsets[chunk];
+            while (contact < particleChunkOffsets[chunk + 1]) {
+                bool dynamic;
+                size_t groupEnd = particleGroup(contact, dynamic);
+                for (; contact < groupEnd; ++contact) {
+                    if (!dynamic) {
+                        resolveParticleContact(particles[particleContacts.getFirst(contact)], contact);
+                    }
                 }
             }
         }
+    });
+    
+    size_t dynamicContacts = 0;
+    for (size_t contact = 0; contact < particleContacts.size();) {
+        bool dynamic;
+        size_t groupEnd = particleGroup(contact, dynamic);
+        for (; contact < groupEnd; ++contact) {
+            if (dynamic) {
+                resolveParticleContact(particles[particleContacts.getFirst(contact)], contact);
+                dynamicContacts++;
+            }
+        }
     }
+    contactStats.particleContacts += particleContacts.size();
+    contactStats.dynamicParticleContacts += dynamicContacts;
+}
+
+void Simulation::resolveParticleContact(Particle& particle, size_t contact) {
+    CollisionObject& object = *collisionObjects[particleContacts.getSecond(contact)];
+    const glm::vec3& normal = particleContacts.getNormal(contact);
+    
+    // Calculate collision response considering masses
+    particle.setVelocity(calculateCollisionResponse(particle, object, normal));
+    
+    // Push particle outside mesh surface
+    particle.setPosition(particle.getPosition() + normal * (particleContacts.getDepth(contact) + 0.001f));
 }
 
 glm::vec3 Simulation::calculateCollisionResponse(const Particle& particle, CollisionObject& object, const glm::vec3& normal) {
@@ -199,9 +905,6 @@ glm::vec3 Simulation::calculateCollisionResponse(const Particle& particle, Colli
     if (velocityAlongNormal > 0) {
         return v1;
     }
-      // Restitution coefficient (0 = perfectly inelastic, 1 = perfectly elastic)
-    float restitution = 1.0f;  // Perfect elastic collision
-    
     // Calculate impulse scalar
     float j = -(1 + restitution) * velocityAlongNormal;
     j /= (particle.getInverseMass() + object.getInverseMass());
@@ -223,207 +926,520 @@ void Simulation::updateCollisionObjectBounds() {
         if (!obj || obj->isStatic()) {
             continue;  // Skip static objects
         }
-        
-        glm::vec3 position = obj->getPosition();
-        glm::vec3 velocity = obj->getVelocity();
-        bool bounced = false;
-        
-        // Get object bounds in world space
-        glm::vec3 objMin = obj->getWorldMin();
-        glm::vec3 objMax = obj->getWorldMax();
-        
-        // Check X bounds
-        if (objMin.x <= boundsMin.x) {
-            velocity.x = glm::abs(velocity.x);  // Force positive velocity
-            position.x = boundsMin.x + (position.x - objMin.x);  // Adjust position
-            bounced = true;
-        } else if (objMax.x >= boundsMax.x) {
-            velocity.x = -glm::abs(velocity.x);  // Force negative velocity
-            position.x = boundsMax.x - (objMax.x - position.x);  // Adjust position
-            bounced = true;
-        }
-        
-        // Check Y bounds
-        if (objMin.y <= boundsMin.y) {
-            velocity.y = glm::abs(velocity.y);  // Force positive velocity
-            position.y = boundsMin.y + (position.y - objMin.y);  // Adjust position
-            bounced = true;
-        } else if (objMax.y >= boundsMax.y) {
-            velocity.y = -glm::abs(velocity.y);  // Force negative velocity
-            position.y = boundsMax.y - (objMax.y - position.y);  // Adjust position
-            bounced = true;
-        }
-        
-        // Check Z bounds
-        if (objMin.z <= boundsMin.z) {
-            velocity.z = glm::abs(velocity.z);  // Force positive velocity
-            position.z = boundsMin.z + (position.z - objMin.z);  // Adjust position
-            bounced = true;
-        } else if (objMax.z >= boundsMax.z) {
-            velocity.z = -glm::abs(velocity.z);  // Force negative velocity
-            position.z = boundsMax.z - (objMax.z - position.z);  // Adjust position
-            bounced = true;
+        constrainObjectToBounds(*obj);
+    }
+}
+
+void Simulation::constrainObjectToBounds(CollisionObject& obj) {
+    glm::vec3 position = obj.getPosition();
+    glm::vec3 velocity = obj.getVelocity();
+    bool bounced = false;
+    
+    // Get object bounds in world space
+    glm::vec3 objMin = obj.getWorldMin();
+    glm::vec3 objMax = obj.getWorldMax();
+    
+    // Check X bounds
+    if (objMin.x <= boundsMin.x) {
+        velocity.x = restitution * glm::abs(velocity.x);  // Force positive velocity
+        position.x = boundsMin.x + (position.x - objMin.x);  // Adjust position
+        bounced = true;
+    } else if (objMax.x >= boundsMax.x) {
+        velocity.x = -restitution * glm::abs(velocity.x);  // Force negative velocity
+        position.x = boundsMax.x - (objMax.x - position.x);  // Adjust position
+        bounced = true;
+    }
+    
+    // Check Y bounds
+    if (objMin.y <= boundsMin.y) {
+        velocity.y = restitution * glm::abs(velocity.y);  // Force positive velocity
+        position.y = boundsMin.y + (position.y - objMin.y);  // Adjust position
+        bounced = true;
+    } else if (objMax.y >= boundsMax.y) {
+        velocity.y = -restitution * glm::abs(velocity.y);  // Force negative velocity
+        position.y = boundsMax.y - (objMax.y - position.y);  // Adjust position
+        bounced = true;
+    }
+    
+    // Check Z bounds
+    if (objMin.z <= boundsMin.z) {
+        velocity.z = restitution * glm::abs(velocity.z);  // Force positive velocity
+        position.z = boundsMin.z + (position.z - objMin.z);  // Adjust position
+        bounced = true;
+    } else if (objMax.z >= boundsMax.z) {
+        velocity.z = -restitution * glm::abs(velocity.z);  // Force negative velocity
+        position.z = boundsMax.z - (objMax.z - position.z);  // Adjust position
+        bounced = true;
+    }
+    
+    // Update velocity and position if bounced
+    if (bounced) {
+        obj.setVelocity(velocity);
+        obj.setPosition(position);
+    }
+}
+
+void Simulation::handleMeshToMeshCollisions(float deltaTime) {
+    // Each chunk of first objects detects its pairs into its own buffer; merged in chunk
+    // order, the contacts are in the usual pair order
+    const size_t objectsPerChunk = 16;
+    size_t count = collisionObjects.size();
+    size_t chunkCount = (count + objectsPerChunk - 1) / objectsPerChunk;
+    if (objectChunkContacts.size() < chunkCount) {
+        objectChunkContacts.resize(chunkCount);
+    }
+    refreshObjectTransforms();
+    parallelFor(count, objectsPerChunk, [&](size_t begin, size_t end) {
+        ContactBuffer& contacts = objectChunkContacts[begin / objectsPerChunk];
+        contacts.clear();
+        // One contact per pair of this chunk, capped since the pair count is quadratic in
+        // the object count; touching pairs with several points still grow it
+        size_t pairCount = 0;
+        for (size_t i = begin; i < end; ++i) {
+            pairCount += count - 1 - i;
         }
-        
-        // Update velocity and position if bounced
-        if (bounced) {
-            obj->setVelocity(velocity);
-            obj->setPosition(position);
+        contacts.reserve(std::min<size_t>(pairCount, 1024));
+        for (size_t i = begin; i < end; ++i) {
+            for (size_t j = i + 1; j < count; ++j) {
+                const auto& obj1 = collisionObjects[i];
+                const auto& obj2 = collisionObjects[j];
+                
+                if (!obj1 || !obj2 || !obj1->isValid() || !obj2->isValid()) {
+                    continue;
+                }
+                
+                // Skip if both objects are static
+                if (obj1->isStatic() && obj2->isStatic()) {
+                    continue;
+                }
+                
+                detectObjectContact(i, j, contacts);
+            }
         }
+    });
+    
+    objectContacts.clear();
+    size_t contactCount = 0;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        contactCount += objectChunkContacts[chunk].size();
+    }
+    objectContacts.reserve(contactCount);
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        objectContacts.append(objectChunkContacts[chunk]);
     }
+    resolveObjectContacts(deltaTime);
 }
 
-void Simulation::handleMeshToMeshCollisions() {
-    // Check all pairs of collision objects for mesh-to-mesh collisions
-    for (size_t i = 0; i < collisionObjects.size(); ++i) {
-        for (size_t j = i + 1; j < collisionObjects.size(); ++j) {
-            auto& obj1 = collisionObjects[i];
-            auto& obj2 = collisionObjects[j];
-            
-            if (!obj1 || !obj2 || !obj1->isValid() || !obj2->isValid()) {
+void Simulation::detectObjectContact(size_t first, size_t second, ContactBuffer& contacts) const {
+    const CollisionObject& obj1 = *collisionObjects[first];
+    const CollisionObject& obj2 = *collisionObjects[second];
+    
+    // Bounding boxes, grown by the contact margin, must overlap; only samples inside the
+    // overlap can touch the other object
+    glm::vec3 margin(ObjectContactMargin);
+    glm::vec3 overlapMin = glm::max(obj1.getWorldMin(), obj2.getWorldMin()) - margin;
+    glm::vec3 overlapMax = glm::min(obj1.getWorldMax(), obj2.getWorldMax()) + margin;
+    if (overlapMin.x > overlapMax.x || overlapMin.y > overlapMax.y || overlapMin.z > overlapMax.z) {
+        return;
+    }
+    
+    // Surface samples of each object within the margin of the other one's SDF. A sample
+    // near a kept point replaces it if deeper; otherwise it takes a free slot or replaces
+    // the shallowest point, so the manifold keeps the deepest, spread-out points. Depths
+    // within the slop of each other count as equal, so on flat contacts the same samples
+    // win every step and warm starting finds its points again.
+    glm::vec3 extent1 = obj1.getWorldMax() - obj1.getWorldMin();
+    glm::vec3 extent2 = obj2.getWorldMax() - obj2.getWorldMin();
+    float mergeDistance = 0.2f * std::min(std::max({extent1.x, extent1.y, extent1.z}),
+                                          std::max({extent2.x, extent2.y, extent2.z}));
+    glm::vec3 points[MaxManifoldPoints], normals[MaxManifoldPoints];
+    float depths[MaxManifoldPoints];
+    int pointCount = 0;
+    auto addPoint = [&](const glm::vec3& point, const glm::vec3& normal, float depth) {
+        int slot = -1;
+        for (int k = 0; k < pointCount; ++k) {
+            if (glm::length(points[k] - point) < mergeDistance) {
+                if (depth <= depths[k] + PenetrationSlop) {
+                    return;
+                }
+                slot = k;
+                break;
+            }
+        }
+        if (slot < 0 && pointCount < MaxManifoldPoints) {
+            slot = pointCount++;
+        } else if (slot < 0) {
+            slot = int(std::min_element(depths, depths + pointCount) - depths);
+            if (depth <= depths[slot] + PenetrationSlop) {
+                return;
+            }
+        }
+        points[slot] = point;
+        normals[slot] = normal;
+        depths[slot] = depth;
+    };
+    // Normals point from obj2 towards obj1, so samples of obj2 flip obj1's outward normal
+    auto testSamples = [&](const CollisionObject& source, const CollisionObject& target, float normalSign) {
+        glm::mat4 transform = source.getTransformMatrix();
+        for (const glm::vec3& sample : source.getContactSamples()) {
+            glm::vec3 point = glm::vec3(transform * glm::vec4(sample, 1.0f));
+            if (!isInsideBox(point, overlapMin, overlapMax)) {
                 continue;
             }
-            
-            // Skip if both objects are static
-            if (obj1->isStatic() && obj2->isStatic()) {
+            float distance = target.getSignedDistance(point);
+            if (distance >= ObjectContactMargin) {
                 continue;
             }
-            
-            checkAndResolveObjectCollision(*obj1, *obj2);
+            glm::vec3 normal = target.getNormal(point);
+            if (glm::length(normal) <= 0.001f) {
+                continue;
+            }
+            addPoint(point, normalSign * glm::normalize(normal), -distance);
         }
+    };
+    // The smaller object's samples are denser in world space, so they go first and win ties
+    if (glm::length(extent1) <= glm::length(extent2)) {
+        testSamples(obj1, obj2, 1.0f);
+        testSamples(obj2, obj1, -1.0f);
+    } else {
+        testSamples(obj2, obj1, -1.0f);
+        testSamples(obj1, obj2, 1.0f);
+    }
+    
+    for (int k = 0; k < pointCount; ++k) {
+        contacts.add(static_cast<uint32_t>(first), static_cast<uint32_t>(second), points[k], normals[k], depths[k]);
     }
 }
 
-void Simulation::checkAndResolveObjectCollision(CollisionObject& obj1, CollisionObject& obj2) {
-    // Simple bounding box collision detection first
-    glm::vec3 obj1Min = obj1.getWorldMin();
-    glm::vec3 obj1Max = obj1.getWorldMax();
-    glm::vec3 obj2Min = obj2.getWorldMin();
-    glm::vec3 obj2Max = obj2.getWorldMax();
-    
-    // Check if bounding boxes overlap
-    bool overlap = (obj1Min.x <= obj2Max.x && obj1Max.x >= obj2Min.x) &&
-                  (obj1Min.y <= obj2Max.y && obj1Max.y >= obj2Min.y) &&
-                  (obj1Min.z <= obj2Max.z && obj1Max.z >= obj2Min.z);
-    
-    if (!overlap) {
+// Sequential impulses: every contact point is a constraint that the objects' relative
+// velocity along its normal reaches the contact's bias (a bounce, or the speed that removes
+// part of the overlap), with the accumulated impulse never pulling. Each pass solves the
+// contacts one after another in pair order, so the result is deterministic.
+void Simulation::resolveObjectContacts(float deltaTime) {
+    size_t count = objectContacts.size();
+    contactStats.objectContacts += count;
+    if (count == 0) {
         return;
     }
+    contactMass.resize(count);
+    contactBias.resize(count);
+    contactImpulse.resize(count);
     
-    // More detailed collision detection using SDF
-    glm::vec3 obj1Center = obj1.getPosition();
-    glm::vec3 obj2Center = obj2.getPosition();
+    auto velocityOf = [](const CollisionObject& obj) { return obj.isStatic() ? glm::vec3(0.0f) : obj.getVelocity(); };
+    auto normalVelocity = [&](size_t contact) {
+        const CollisionObject& obj1 = *collisionObjects[objectContacts.getFirst(contact)];
+        const CollisionObject& obj2 = *collisionObjects[objectContacts.getSecond(contact)];
+        return glm::dot(velocityOf(obj1) - velocityOf(obj2), objectContacts.getNormal(contact));
+    };
     
-    // Sample obj2's SDF at obj1's center and vice versa
-    float distance1 = obj2.getSignedDistance(obj1Center);
-    float distance2 = obj1.getSignedDistance(obj2Center);
+    float bounceThreshold = 2.0f * glm::length(objectGravity) * deltaTime;
+    for (size_t contact = 0; contact < count; ++contact) {
+        const CollisionObject& obj1 = *collisionObjects[objectContacts.getFirst(contact)];
+        const CollisionObject& obj2 = *collisionObjects[objectContacts.getSecond(contact)];
+        float inverseMassSum = obj1.getInverseMass() + obj2.getInverseMass();
+        contactMass[contact] = inverseMassSum > 0.0f ? 1.0f / inverseMassSum : 0.0f;
+        
+        float approach = -normalVelocity(contact);
+        // A separated point may close its gap this step but no more; overlap beyond the slop
+        // is pushed out over a few steps
+        float depth = objectContacts.getDepth(contact);
+        float push = depth < 0.0f ? depth / deltaTime
+                                  : BaumgarteFactor / deltaTime * std::max(depth - PenetrationSlop, 0.0f);
+        // Only a hit bounces: the gap must close within this step, and slow approaches, such
+        // as a resting object gaining gravity, do not count
+        bool hits = approach > bounceThreshold && approach * deltaTime >= -depth;
+        contactBias[contact] = hits ? std::max(restitution * approach, push) : push;
+    }
     
-    // Also check multiple sample points for better accuracy
-    float threshold = 0.02f; // Small positive threshold for surface contact
+    // Warm start: each point takes the impulse of the nearest unused cached point of its pair
+    // within the match distance. A pair's points are adjacent in the buffer.
+    std::fill(contactImpulse.begin(), contactImpulse.end(), 0.0f);
+    for (size_t begin = 0; begin < count && warmStarting;) {
+        uint32_t first = objectContacts.getFirst(begin);
+        uint32_t second = objectContacts.getSecond(begin);
+        size_t end = begin + 1;
+        while (end < count && objectContacts.getFirst(end) == first && objectContacts.getSecond(end) == second) {
+            end++;
+        }
+        auto cached = contactManifolds.find(makePairKey(first, second));
+        if (cached != contactManifolds.end()) {
+            const ContactManifold& manifold = cached->second;
+            // An impulse is a force times the step it acted over; adaptive substepping changes
+            // the step between solves, so the cached impulses are rescaled to this one
+            float impulseScale = manifold.deltaTime > 0.0f ? deltaTime / manifold.deltaTime : 0.0f;
+            bool used[MaxManifoldPoints] = {};
+            for (size_t contact = begin; contact < end; ++contact) {
+                glm::vec3 offset = objectContacts.getPoint(contact) - collisionObjects[first]->getPosition();
+                int match = -1;
+                float matchDistance = ManifoldMatchDistance;
+                for (int k = 0; k < manifold.pointCount; ++k) {
+                    float distance = glm::length(offset - manifold.offsets[k]);
+                    if (!used[k] && distance < matchDistance) {
+                        match = k;
+                        matchDistance = distance;
+                    }
+                }
+                if (match >= 0) {
+                    used[match] = true;
+                    float impulse = manifold.impulses[match] * impulseScale;
+                    contactImpulse[contact] = impulse;
+                    applyObjectImpulse(contact, impulse);
+                    contactStats.warmStartedContacts++;
+                }
+            }
+        }
+        begin = end;
+    }
     
-    bool collision = (distance1 < threshold) || (distance2 < threshold);
+    for (int iteration = 0; iteration < solverIterations; ++iteration) {
+        for (size_t contact = 0; contact < count; ++contact) {
+            float delta = contactMass[contact] * (contactBias[contact] - normalVelocity(contact));
+            float impulse = std::max(contactImpulse[contact] + delta, 0.0f);
+            applyObjectImpulse(contact, impulse - contactImpulse[contact]);
+            contactImpulse[contact] = impulse;
+        }
+    }
     
-    if (collision) {
-        std::cout << "Collision detected! Distances: " << distance1 << ", " << distance2 << std::endl;
-        resolveObjectCollision(obj1, obj2, obj1Center, obj2Center);
+    // Cache this step's points and impulses; a pair's points are adjacent in the buffer
+    for (size_t contact = 0; contact < count; ++contact) {
+        uint32_t first = objectContacts.getFirst(contact);
+        uint32_t second = objectContacts.getSecond(contact);
+        ContactManifold& manifold = contactManifolds[makePairKey(first, second)];
+        bool startsPair = contact == 0 || objectContacts.getFirst(contact - 1) != first ||
+                          objectContacts.getSecond(contact - 1) != second;
+        if (startsPair) {
+            manifold.pointCount = 0;
+            manifold.step = stepCount;
+            manifold.deltaTime = deltaTime;
+        }
+        if (manifold.pointCount < MaxManifoldPoints) {
+            manifold.offsets[manifold.pointCount] = objectContacts.getPoint(contact) - collisionObjects[first]->getPosition();
+            manifold.impulses[manifold.pointCount] = contactImpulse[contact];
+            manifold.pointCount++;
+        }
     }
 }
 
-void Simulation::resolveObjectCollision(CollisionObject& obj1, CollisionObject& obj2, 
-                                       const glm::vec3& pos1, const glm::vec3& pos2) {
-    std::cout << "Starting collision resolution..." << std::endl;
-    
-    // Calculate collision normal (from obj1 to obj2)
-    glm::vec3 normal = pos2 - pos1;
-    float distance = glm::length(normal);
-    
-    if (distance < 0.001f) {
-        // Objects are at the same position, use default separation
-        normal = glm::vec3(1.0f, 0.0f, 0.0f);
-        distance = 0.001f;
-    } else {
-        normal = glm::normalize(normal);
+void Simulation::applyObjectImpulse(size_t contact, float impulse) {
+    CollisionObject& obj1 = *collisionObjects[objectContacts.getFirst(contact)];
+    CollisionObject& obj2 = *collisionObjects[objectContacts.getSecond(contact)];
+    glm::vec3 normalImpulse = objectContacts.getNormal(contact) * impulse;
+    if (!obj1.isStatic()) {
+        obj1.setVelocity(obj1.getVelocity() + normalImpulse * obj1.getInverseMass());
     }
+    if (!obj2.isStatic()) {
+        obj2.setVelocity(obj2.getVelocity() - normalImpulse * obj2.getInverseMass());
+    }
+}
+
+void Simulation::pruneContactManifolds() {
+    for (auto it = contactManifolds.begin(); it != contactManifolds.end();) {
+        if (it->second.step != stepCount) {
+            it = contactManifolds.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+int Simulation::computeSubsteps(float displacement, float featureSize) const {
+    float limit = cflNumber * featureSize;
+    if (limit <= 0.0f || displacement <= limit) {
+        return 1;
+    }
+    float substeps = std::ceil(displacement / limit);
+    return substeps >= float(maxAdaptiveSubsteps) ? maxAdaptiveSubsteps : int(substeps);
+}
+
+void Simulation::updateAdaptive(float deltaTime) {
+    substepStats = SubstepStats();
+    updateObjectIslands(deltaTime);
+    updateParticlesAdaptive(deltaTime);
+}
+
+void Simulation::updateObjectIslands(float deltaTime) {
+    size_t count = collisionObjects.size();
     
-    // Calculate actual penetration depth using SDF
-    float penetrationDepth = 0.0f;
-    float dist1 = obj2.getSignedDistance(pos1);
-    float dist2 = obj1.getSignedDistance(pos2);
-    
-    // If distance is negative, objects are penetrating
-    if (dist1 < 0.0f) penetrationDepth = glm::max(penetrationDepth, -dist1);
-    if (dist2 < 0.0f) penetrationDepth = glm::max(penetrationDepth, -dist2);
-    
-    // If no penetration detected but we're here, use small separation
-    if (penetrationDepth == 0.0f) {
-        penetrationDepth = 0.05f; // Small default separation
+    // Swept world bounds: anything this object can touch during the step lies inside
+    std::vector<glm::vec3> sweptMin(count), sweptMax(count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto& obj = collisionObjects[i];
+        if (!obj || !obj->isValid()) {
+            continue;
+        }
+        glm::vec3 reach = glm::abs(obj->getVelocity()) * deltaTime;
+        sweptMin[i] = obj->getWorldMin() - reach;
+        sweptMax[i] = obj->getWorldMax() + reach;
     }
     
-    // Use separation based on penetration
-    float separation = glm::max(0.02f, penetrationDepth * 1.2f);  // 20% buffer
-    glm::vec3 separationVector = normal * separation * 0.5f;
+    // Union-find over dynamic objects whose swept bounds overlap. Static objects never join
+    // an island, so one wall does not merge every object resting against it.
+    std::vector<size_t> parent(count);
+    std::iota(parent.begin(), parent.end(), size_t(0));
+    auto find = [&parent](size_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
     
-    // Store original positions for smoother adjustment
-    glm::vec3 originalPos1 = pos1;
-    glm::vec3 originalPos2 = pos2;
+    auto isDynamic = [this](size_t i) {
+        const auto& obj = collisionObjects[i];
+        return obj && obj->isValid() && !obj->isStatic();
+    };
+    auto overlaps = [&sweptMin, &sweptMax](size_t a, size_t b) {
+        return sweptMin[a].x <= sweptMax[b].x && sweptMax[a].x >= sweptMin[b].x &&
+               sweptMin[a].y <= sweptMax[b].y && sweptMax[a].y >= sweptMin[b].y &&
+               sweptMin[a].z <= sweptMax[b].z && sweptMax[a].z >= sweptMin[b].z;
+    };
     
-    if (!obj1.isStatic()) {
-        obj1.setPosition(originalPos1 - separationVector);
+    for (size_t i = 0; i < count; ++i) {
+        if (!isDynamic(i)) {
+            continue;
+        }
+        for (size_t j = i + 1; j < count; ++j) {
+            if (isDynamic(j) && (!perIslandSubstepping || overlaps(i, j))) {
+                parent[find(j)] = find(i);
+            }
+        }
     }
-    if (!obj2.isStatic()) {
-        obj2.setPosition(originalPos2 + separationVector);
-    }
-    
-    // Calculate collision response
-    glm::vec3 v1 = obj1.getVelocity();
-    glm::vec3 v2 = obj2.getVelocity();
-    
-    float m1 = obj1.getMass();
-    float m2 = obj2.getMass();
-    
-    std::cout << "Collision response - Masses: " << m1 << ", " << m2 
-              << ", Penetration: " << penetrationDepth << ", Distance: " << distance << std::endl;
-    std::cout << "Velocities before: v1=(" << v1.x << "," << v1.y << "," << v1.z 
-              << ") v2=(" << v2.x << "," << v2.y << "," << v2.z << ")" << std::endl;
-      // Handle static objects
-    if (obj1.isStatic()) {
-        // obj1 is static, only obj2 bounces
-        glm::vec3 newV2 = reflectVelocity(v2, -normal);
-        obj2.setVelocity(newV2);  // No damping - perfect reflection
-        std::cout << "Static collision resolved (obj1 static)" << std::endl;
-        return;
+    
+    // Step each island with as many substeps as its fastest member needs
+    for (size_t root = 0; root < count; ++root) {
+        if (!isDynamic(root) || find(root) != root) {
+            continue;
+        }
+        
+        std::vector<size_t> members;
+        int substeps = 1;
+        for (size_t i = root; i < count; ++i) {
+            if (isDynamic(i) && find(i) == root) {
+                members.push_back(i);
+                const auto& obj = collisionObjects[i];
+                float displacement = glm::length(obj->getVelocity()) * deltaTime;
+                substeps = std::max(substeps, computeSubsteps(displacement, obj->getWorldCellSize()));
+            }
+        }
+        
+        float substepTime = deltaTime / float(substeps);
+        for (int step = 0; step < substeps; ++step) {
+            for (size_t i : members) {
+                CollisionObject& obj = *collisionObjects[i];
+                obj.setVelocity(obj.getVelocity() + objectGravity * substepTime);
+            }
+            
+            // Pairs inside the island plus contacts with static objects, in the usual pair order
+            objectContacts.clear();
+            for (size_t i : members) {
+                for (size_t j = 0; j < count; ++j) {
+                    if (j == i || !collisionObjects[j] || !collisionObjects[j]->isValid()) {
+                        continue;
+                    }
+                    bool sameIsland = j > i && isDynamic(j) && find(j) == root;
+                    if (sameIsland || collisionObjects[j]->isStatic()) {
+                        detectObjectContact(std::min(i, j), std::max(i, j), objectContacts);
+                    }
+                }
+            }
+            resolveObjectContacts(substepTime);
+            
+            for (size_t i : members) {
+                collisionObjects[i]->updatePhysics(substepTime);
+                constrainObjectToBounds(*collisionObjects[i]);
+            }
+        }
+        
+        substepStats.objectIslands++;
+        substepStats.maxObjectSubsteps = std::max(substepStats.maxObjectSubsteps, substeps);
     }
-    if (obj2.isStatic()) {
-        // obj2 is static, only obj1 bounces
-        glm::vec3 newV1 = reflectVelocity(v1, normal);
-        obj1.setVelocity(newV1);  // No damping - perfect reflection
-        std::cout << "Static collision resolved (obj2 static)" << std::endl;
+    pruneContactManifolds();
+}
+
+void Simulation::updateParticlesAdaptive(float deltaTime) {
+    Particle* particles = getAwakeParticles();
+    size_t particleCount = getAwakeParticleCount();
+    if (particleCount == 0) {
         return;
     }
-      // Both objects are dynamic - calculate collision response
-    glm::vec3 relativeVelocity = v1 - v2;
-    float velocityAlongNormal = glm::dot(relativeVelocity, normal);
-    
-    std::cout << "Relative velocity along normal: " << velocityAlongNormal << std::endl;
-      // Always apply collision response for interpenetrating objects
-    
-    // Restitution coefficient (bounce) - perfect elastic collision
-    float restitution = 1.0f;
-    
-    // Calculate impulse scalar
-    float j = -(1 + restitution) * velocityAlongNormal;
-    j /= (obj1.getInverseMass() + obj2.getInverseMass());
     
-    // Apply impulse
-    glm::vec3 impulse = j * normal;
+    // Object bounds at their end-of-step pose; this also refreshes each object's cached
+    // transform so the parallel SDF queries below only read shared state
+    std::vector<glm::vec3> objectMin, objectMax;
+    std::vector<const CollisionObject*> objects;
+    for (const auto& obj : collisionObjects) {
+        if (obj && obj->isValid()) {
+            objects.push_back(obj.get());
+            objectMin.push_back(obj->getWorldMin());
+            objectMax.push_back(obj->getWorldMax());
+            obj->getInverseTransformMatrix();
+        }
+    }
     
-    glm::vec3 newV1 = v1 + obj1.getInverseMass() * impulse;
-    glm::vec3 newV2 = v2 - obj2.getInverseMass() * impulse;
+    // A particle only needs substeps if it is fast relative to its radius and close enough
+    // to a wall or surface to reach it this step
+    particleSubsteps.resize(particleCount);
+    parallelFor(particleCount, 2048, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Particle& particle = particles[i];
+            float radius = particle.getSize();
+            float displacement = glm::length(particle.getVelocity()) * deltaTime;
+            if (displacement <= cflNumber * radius) {
+                particleSubsteps[i] = 1;
+                continue;
+            }
+            
+            glm::vec3 pos = particle.getPosition();
+            glm::vec3 wallGap = glm::min(pos - boundsMin, boundsMax - pos);
+            float clearance = std::min({wallGap.x, wallGap.y, wallGap.z});
+            for (size_t k = 0; k < objects.size() && clearance > displacement; ++k) {
+                glm::vec3 reachMin = objectMin[k] - glm::vec3(displacement + radius);
+                glm::vec3 reachMax = objectMax[k] + glm::vec3(displacement + radius);
+                bool inReach = pos.x >= reachMin.x && pos.x <= reachMax.x &&
+                               pos.y >= reachMin.y && pos.y <= reachMax.y &&
+                               pos.z >= reachMin.z && pos.z <= reachMax.z;
+                if (inReach) {
+                    clearance = std::min(clearance, objects[k]->getSignedDistance(pos));
+                }
+            }
+            clearance -= radius;
+            
+            particleSubsteps[i] = displacement < clearance ? 1 : computeSubsteps(displacement, radius);
+        }
+    });
     
-    obj1.setVelocity(newV1);
-    obj2.setVelocity(newV2);
+    // Substeps run in rounds: in round r every particle with more than r substeps takes its
+    // r-th substep and detects its contacts, then the round's contacts are resolved
+    int maxSubsteps = 1;
+    for (size_t i = 0; i < particleCount; ++i) {
+        maxSubsteps = std::max(maxSubsteps, particleSubsteps[i]);
+    }
+    for (int round = 0; round < maxSubsteps; ++round) {
+        beginParticleContacts(particleCount);
+        parallelFor(particleCount, ParticleChunkSize, [&](size_t begin, size_t end) {
+            ContactBuffer& contacts = particleChunkContacts[begin / ParticleChunkSize];
+            for (size_t i = begin; i < end; ++i) {
+                int substeps = particleSubsteps[i];
+                if (round >= substeps) {
+                    continue;
+                }
+                Particle& particle = particles[i];
+                particle.update(deltaTime / float(substeps));
+                resolveParticleWallCollision(particle);
+                detectParticleContacts(particle, static_cast<uint32_t>(i), contacts);
+            }
+        });
+        resolveParticleContacts(particles, particleCount);
+    }
     
-    std::cout << "Dynamic mesh collision resolved! Final velocities: (" 
-              << newV1.x << "," << newV1.y << "," << newV1.z << ") and ("
-              << newV2.x << "," << newV2.y << "," << newV2.z << ")" << std::endl;
+    size_t totalSubsteps = 0;
+    for (size_t i = 0; i < particleCount; ++i) {
+        int substeps = particleSubsteps[i];
+        totalSubsteps += size_t(substeps);
+        if (substeps > 1) {
+            substepStats.particlesSubstepped++;
+        }
+        substepStats.maxParticleSubsteps = std::max(substepStats.maxParticleSubsteps, substeps);
+    }
+    substepStats.averageParticleSubsteps = float(double(totalSubsteps) / double(particleCount));
 }
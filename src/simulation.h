@@ -1,11 +1,43 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <memory>
+#include <unordered_map>
 #include "particle.h"
 #include "collision_object.h"
+#include "simulation_snapshot.h"
+#include "contact_buffer.h"
+#include "spatial_sort.h"
+
+struct SimulationCheckpoint;
+class AssetCache;
+
+// Continuous particle source: spawns 'rate' particles per second in a box, moving at
+// 'velocity' plus 'speed' in a random direction
+struct ParticleEmitter {
+    glm::vec3 regionMin = glm::vec3(0.0f);
+    glm::vec3 regionMax = glm::vec3(0.0f);
+    float rate = 0.0f;
+    glm::vec3 velocity = glm::vec3(0.0f);
+    float speed = 0.0f;
+    float size = 0.05f;
+};
+
+// Particles are removed once they are inside a kill zone at the end of a step
+struct KillZone {
+    glm::vec3 regionMin;
+    glm::vec3 regionMax;
+};
+
+// Running totals of particles emitted and removed
+struct ParticleFlowStats {
+    uint64_t emitted = 0;
+    uint64_t killed = 0;
+    uint64_t dropped = 0;  // Emissions skipped because the particle capacity was reached
+};
 
 class Simulation {
 public:
@@ -15,6 +47,44 @@ public:
     void initialize(int numParticles = 100, float particleSpeed = 2.0f, float particleSize = 0.05f);
     void update(float deltaTime);
     
+    // Adds particles inside [regionMin, regionMax] without touching the existing ones
+    void addParticles(int count, const glm::vec3& regionMin, const glm::vec3& regionMax, float speed, float size,
+                      const glm::vec3& velocity = glm::vec3(0.0f));
+    void setBounds(const glm::vec3& boxMin, const glm::vec3& boxMax) { boundsMin = boxMin; boundsMax = boxMax; wakeAllParticles(); }
+    
+    // Open-flow runs: emitters and kill zones are applied at the end of each update. Killing
+    // moves the last particle into the freed slot, so particle indices are not stable. Set a
+    // capacity to reserve the particle storage; emission then never allocates.
+    void addEmitter(const ParticleEmitter& emitter);
+    void addKillZone(const KillZone& zone) { killZones.push_back(zone); }
+    void clearEmitters();
+    void clearKillZones() { killZones.clear(); }
+    void setParticleCapacity(size_t capacity) { particleSystem.setCapacity(capacity); }
+    const ParticleFlowStats& getParticleFlowStats() const { return flowStats; }
+    
+    // Particle sleeping: a particle slower than sleepVelocity for sleepSteps consecutive steps
+    // stops and is skipped by every particle pass until a moving dynamic object comes within
+    // reach of it. Sleeping particles are kept at the front of the particle array, so
+    // falling asleep and waking move particles between slots.
+    void setParticleSleeping(bool enabled);
+    bool isParticleSleeping() const { return particleSleeping; }
+    void setSleepThreshold(float velocity, int steps);
+    size_t getSleepingParticleCount() const { return firstAwakeParticle; }
+    // Wakes every particle, e.g. after particles or objects were changed directly
+    void wakeAllParticles();
+    
+    // Spatial reordering: every 'steps' steps the awake particles are sorted by the Morton
+    // code of their position, so particles that are close in space are processed together
+    // and hit the same SDF cells and objects. 0 turns it off.
+    void setSpatialReorderInterval(int steps) { reorderInterval = static_cast<uint32_t>(std::max(steps, 0)); }
+    int getSpatialReorderInterval() const { return static_cast<int>(reorderInterval); }
+    // For consumers that track particles by index over several updates. 'remap' holds, for
+    // each particle at the start of the last update, its index at some earlier point or
+    // NewParticle; this carries it through that update's kills, sleeping, waking, emission
+    // and reordering. Start from the identity and call it after every update.
+    static constexpr uint32_t NewParticle = SimulationSnapshot::NewParticle;
+    void accumulateParticleRemap(std::vector<uint32_t>& remap) const;
+    
     // CollisionObject management
     void addCollisionObject(std::unique_ptr<CollisionObject> collisionObject);
     void clearCollisionObjects();
@@ -24,24 +94,181 @@ public:
     size_t getCollisionObjectCount() const { return collisionObjects.size(); }
     const glm::vec3& getBoundsMin() const { return boundsMin; }
     const glm::vec3& getBoundsMax() const { return boundsMax; }
+    uint64_t getStepCount() const { return stepCount; }
+    double getSimulationTime() const { return simulationTime; }
+    
+    // Copy the current state into 'snapshot', reusing its storage
+    void captureSnapshot(SimulationSnapshot& snapshot) const;
+    // Record positions/poses into the snapshot's previous-state fields (call before the last step)
+    void capturePreviousState(SimulationSnapshot& snapshot) const;
+    
+    // Full resumable state (see checkpoint.h), reusing the checkpoint's storage
+    void captureCheckpoint(SimulationCheckpoint& checkpoint) const;
+    // Replaces the current state; particles are moved out of 'checkpoint' and object geometry
+    // is looked up in 'assets' by key. Leaves the simulation unchanged on failure.
+    bool restoreCheckpoint(SimulationCheckpoint& checkpoint, AssetCache& assets);
+    
+    // Seeds the particles spawned by initialize() and addParticles()
+    void setRandomSeed(uint64_t seed) { particleSystem.setSeed(seed); }
     
     void setParticleSize(float size);
     
+    // Adaptive substepping: each update is split so that no particle moves more than
+    // cflNumber particle radii and no object more than cflNumber SDF cells per substep.
+    // Particles with enough SDF clearance to their surroundings take the full step.
+    void setAdaptiveSubstepping(bool enabled) { adaptiveSubstepping = enabled; }
+    bool isAdaptiveSubstepping() const { return adaptiveSubstepping; }
+    void setCflNumber(float cfl) { cflNumber = std::max(cfl, 0.01f); }
+    float getCflNumber() const { return cflNumber; }
+    void setMaxAdaptiveSubsteps(int substeps) { maxAdaptiveSubsteps = std::max(substeps, 1); }
+    int getMaxAdaptiveSubsteps() const { return maxAdaptiveSubsteps; }
+    // Subdivide each group of possibly touching objects separately instead of all objects together
+    void setPerIslandSubstepping(bool enabled) { perIslandSubstepping = enabled; }
+    const SubstepStats& getSubstepStats() const { return substepStats; }
+    const ContactStats& getContactStats() const { return contactStats; }
+    
+    // Object contacts are solved with sequential impulses: 'iterations' passes over the
+    // contacts per step, starting from the impulses found in the previous step for the same
+    // object pair and contact point when warm starting is on. Restitution applies to
+    // object-object, particle-object and object-wall hits; contacts approaching slower than two steps of
+    // gravity never bounce, so objects can come to rest on each other.
+    void setSolverIterations(int iterations) { solverIterations = std::max(iterations, 1); }
+    int getSolverIterations() const { return solverIterations; }
+    void setWarmStarting(bool enabled) { warmStarting = enabled; }
+    bool isWarmStarting() const { return warmStarting; }
+    void setRestitution(float value) { restitution = std::min(std::max(value, 0.0f), 1.0f); }
+    float getRestitution() const { return restitution; }
+    // Acceleration of dynamic objects; particles are not affected
+    void setObjectGravity(const glm::vec3& gravity) { objectGravity = gravity; }
+    const glm::vec3& getObjectGravity() const { return objectGravity; }
+    
     // Update collision object methods
     void updateCollisionObjectBounds();
     
-    // Mesh-to-mesh collision methods
-    void handleMeshToMeshCollisions();
-    
+    // Mesh-to-mesh collision methods: detects object contacts and solves them for velocities
+    void handleMeshToMeshCollisions(float deltaTime);
+
 private:
     ParticleSystem particleSystem;
     std::vector<std::unique_ptr<CollisionObject>> collisionObjects;
     glm::vec3 boundsMin, boundsMax;
+    uint64_t stepCount;
+    double simulationTime;
+    
+    bool adaptiveSubstepping;
+    bool perIslandSubstepping;
+    float cflNumber;
+    int maxAdaptiveSubsteps;
+    SubstepStats substepStats;
+    std::vector<int> particleSubsteps;  // Reused per update
+    
+    // Collisions run in two stages: detection fills contact buffers in parallel, then the
+    // contacts are resolved. Each chunk of particles or objects detects into its own buffer,
+    // and the buffers are merged in chunk order, so contacts are in particle or pair order.
+    std::vector<ContactBuffer> particleChunkContacts;  // One buffer per particle chunk, reused
+    std::vector<size_t> particleChunkOffsets;          // Start of each chunk in particleContacts
+    ContactBuffer particleContacts;                    // Particle index (awake), object index
+    std::vector<ContactBuffer> objectChunkContacts;
+    ContactBuffer objectContacts;                      // Object index pairs, lower index first
+    ContactStats contactStats;
+    
+    // Contact points of an object pair kept from one step to the next for warm starting
+    static constexpr int MaxManifoldPoints = 4;
+    struct ContactManifold {
+        int pointCount = 0;
+        glm::vec3 offsets[MaxManifoldPoints];  // Contact point relative to the first object
+        float impulses[MaxManifoldPoints];     // Accumulated normal impulse at the end of the solve
+        uint64_t step = 0;                     // Last step the pair was in contact
+        float deltaTime = 0.0f;                // Time step the impulses were solved for
+    };
+    std::unordered_map<uint64_t, ContactManifold> contactManifolds;  // Keyed by (first << 32) | second
+    // Per object contact solver state, reused
+    std::vector<float> contactMass;     // 1 / (sum of inverse masses)
+    std::vector<float> contactBias;     // Separating speed the contact must reach
+    std::vector<float> contactImpulse;  // Accumulated normal impulse
+    int solverIterations;
+    bool warmStarting;
+    float restitution;
+    glm::vec3 objectGravity;
+    
+    std::vector<ParticleEmitter> emitters;
+    std::vector<float> emissionCredit;  // Fractional particles owed by each emitter
+    std::vector<KillZone> killZones;
+    std::vector<std::vector<uint32_t>> killLists;  // One list per particle chunk, reused
+    ParticleFlowStats flowStats;
+    // Slot changes made by the last update's kills, sleeping and waking, so captureSnapshot()
+    // can line up previous positions: particles in 'from' moved to 'to', or the two swapped
+    struct ParticleMove {
+        uint32_t from;
+        uint32_t to;
+        bool exchange;
+    };
+    std::vector<ParticleMove> particleMoves;
+    size_t particlesBeforeFlow;       // Particle count at the start of the last update
+    size_t particlesBeforeEmission;   // ... and before its emitters ran
+    
+    bool particleSleeping;
+    float sleepVelocity;
+    uint32_t sleepSteps;
+    size_t firstAwakeParticle;   // Particles before this index are asleep
+    std::vector<std::vector<uint32_t>> sleepLists;  // One list per particle chunk, reused
+    std::vector<uint32_t> wakeList;
+    // Uniform grid over the bounds listing the sleeping particles [0, sleepGridCount) per
+    // cell. Particles that fell asleep since the last rebuild sit after those and are tested
+    // one by one; woken particles leave a removed entry. Rebuilt once either set grows large.
+    std::vector<uint32_t> sleepCellStart;
+    std::vector<uint32_t> sleepCellParticles;
+    std::vector<uint32_t> sleepGridEntry;  // Position of each grid particle in sleepCellParticles
+    size_t sleepGridCount;
+    size_t sleepGridRemoved;
+    glm::ivec3 sleepGridSize;
+    glm::vec3 sleepCellSize;
+    float maxSleepingRadius;
+    bool sleepGridDirty;
+    
+    uint32_t reorderInterval;
+    bool reorderedLastUpdate;
+    size_t reorderStart;  // First particle the last reorder sorted
+    std::vector<uint32_t> reorderKeys;
+    std::vector<uint32_t> reorderSource;  // Index before the last reorder of each sorted particle
+    RadixSortScratch reorderScratch;
+    std::vector<Particle> reorderBuffer;
+    
+    // Fixed-step phases: objects (motion, bounds, object pairs) and particles (motion, walls)
+    void integrateCollisionObjects(float deltaTime);
+    void integrateParticles(float deltaTime);
     void handleWallCollisions();
     void handleMultipleCollisionObjectCollisions();
-    void checkAndResolveObjectCollision(CollisionObject& obj1, CollisionObject& obj2);
-    void resolveObjectCollision(CollisionObject& obj1, CollisionObject& obj2, 
-                               const glm::vec3& pos1, const glm::vec3& pos2);
+    void resolveParticleWallCollision(Particle& particle);
+    void refreshObjectTransforms();
+    // Particle contacts: clear the chunk buffers, detect one particle's contacts with every
+    // object (thread-safe), then merge and resolve the buffers
+    void beginParticleContacts(size_t particleCount);
+    void detectParticleContacts(const Particle& particle, uint32_t index, ContactBuffer& contacts) const;
+    void resolveParticleContacts(Particle* particles, size_t particleCount);
+    void resolveParticleContact(Particle& particle, size_t contact);
+    void constrainObjectToBounds(CollisionObject& obj);
+    // Awake particles, [firstAwakeParticle, size); the only ones the particle passes visit
+    Particle* getAwakeParticles() { return particleSystem.getParticles().data() + firstAwakeParticle; }
+    size_t getAwakeParticleCount() const { return particleSystem.getParticles().size() - firstAwakeParticle; }
+    void wakeParticlesNearMovingObjects(float deltaTime);
+    void putRestingParticlesToSleep();
+    void rebuildSleepGrid(size_t sleeping);
+    void wakeParticle(uint32_t index);
+    void applyKillZones();
+    void reorderParticles();
+    void emitParticles(float deltaTime);
+    void updateAdaptive(float deltaTime);
+    void updateObjectIslands(float deltaTime);
+    void updateParticlesAdaptive(float deltaTime);
+    int computeSubsteps(float displacement, float featureSize) const;
+    // Object contacts: up to MaxManifoldPoints points between collisionObjects[first] and
+    // collisionObjects[second], first < second, added together
+    void detectObjectContact(size_t first, size_t second, ContactBuffer& contacts) const;
+    void resolveObjectContacts(float deltaTime);
+    void applyObjectImpulse(size_t contact, float impulse);
+    // Drops the manifolds of pairs that were not in contact this step
+    void pruneContactManifolds();
     glm::vec3 reflectVelocity(const glm::vec3& velocity, const glm::vec3& normal) const;
     glm::vec3 calculateCollisionResponse(const Particle& particle, CollisionObject& object, const glm::vec3& normal);
     bool checkWallCollision(const Particle& particle, glm::vec3& normal) const;
@@ -0,0 +1,48 @@
+#include "simulation_snapshot.h"
+#include "parallel.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+void interpolateSnapshot(const SimulationSnapshot& snapshot, float alpha, SimulationSnapshot& result) {
+    alpha = glm::clamp(alpha, 0.0f, 1.0f);
+    
+    result.particles = snapshot.particles;
+    result.objects = snapshot.objects;
+    result.previousParticlePositions.clear();
+    result.previousObjectPoses.clear();
+    result.particleRemap = snapshot.particleRemap;
+    result.boundsMin = snapshot.boundsMin;
+    result.boundsMax = snapshot.boundsMax;
+    result.stepCount = snapshot.stepCount;
+    result.simulationTime = snapshot.simulationTime - (1.0f - alpha) * snapshot.stepSize;
+    result.stepSize = snapshot.stepSize;
+    result.publishTime = snapshot.publishTime;
+    result.substeps = snapshot.substeps;
+    result.contacts = snapshot.contacts;
+    result.sleepingParticles = snapshot.sleepingParticles;
+    
+    // Particles: only blend when the previous state lines up index for index
+    if (snapshot.previousParticlePositions.size() == snapshot.particles.size()) {
+        parallelFor(result.particles.size(), 8192, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                glm::vec3 previous = snapshot.previousParticlePositions[i];
+                glm::vec3 current = snapshot.particles[i].getPosition();
+                result.particles[i].setPosition(glm::mix(previous, current, alpha));
+            }
+        });
+    }
+    
+    // Collision objects: blend pose and rebuild the transform (T * R * S)
+    if (snapshot.previousObjectPoses.size() == snapshot.objects.size()) {
+        for (size_t i = 0; i < result.objects.size(); ++i) {
+            const SimulationSnapshot::ObjectPose& previous = snapshot.previousObjectPoses[i];
+            SimulationSnapshot::ObjectState& object = result.objects[i];
+            
+            object.position = glm::mix(previous.position, object.position, alpha);
+            object.rotation = glm::slerp(previous.rotation, object.rotation, alpha);
+            object.scale = glm::mix(previous.scale, object.scale, alpha);
+            object.transform = glm::translate(glm::mat4(1.0f), object.position) *
+                               glm::mat4_cast(object.rotation) *
+                               glm::scale(glm::mat4(1.0f), object.scale);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <vector>
+#include "particle.h"
+#include "mesh.h"
+#include "collision_object.h"
+
+// How the last adaptive update was subdivided (all ones when adaptive substepping is off)
+struct SubstepStats {
+    int objectIslands = 0;              // Groups of dynamic objects that could touch this step
+    int maxObjectSubsteps = 1;          // Most substeps taken by any island
+    int maxParticleSubsteps = 1;        // Most substeps taken by any particle
+    float averageParticleSubsteps = 1.0f;
+    size_t particlesSubstepped = 0;     // Particles that needed more than one substep
+};
+
+// Contacts resolved during the last update, summed over substeps
+struct ContactStats {
+    size_t particleContacts = 0;         // Particle-object contacts
+    size_t dynamicParticleContacts = 0;  // ... of which with dynamic objects, resolved serially
+    size_t objectContacts = 0;           // Object-object contact points
+    size_t warmStartedContacts = 0;      // ... that started from the previous step's impulse
+};
+
+// Immutable copy of the simulation state published for rendering and output.
+// Mesh pointers refer to shared geometry owned by the simulation's collision
+// objects, which is never modified or freed while the simulation runs.
+struct SimulationSnapshot {
+    // Marks particles in 'particleRemap' that did not exist in the previous snapshot
+    static constexpr uint32_t NewParticle = 0xFFFFFFFFu;
+    
+    struct ObjectState {
+        const Mesh* mesh;
+        const Mesh* surfaceLods[MaxSurfaceLods];  // Meshes extracted from the SDF, finest first
+        int surfaceLodCount;
+        glm::mat4 transform;
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+        glm::vec3 velocity;
+    };
+    
+    struct ObjectPose {
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+    
+    std::vector<Particle> particles;
+    std::vector<ObjectState> objects;
+    
+    // State one step earlier, for render interpolation (empty if unavailable)
+    std::vector<glm::vec3> previousParticlePositions;
+    std::vector<ObjectPose> previousObjectPoses;
+    // Index each particle had in the previously published snapshot, or NewParticle. Kills,
+    // sleeping, waking and reordering move particles between slots. Empty if unknown.
+    std::vector<uint32_t> particleRemap;
+    
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    uint64_t stepCount = 0;
+    double simulationTime = 0.0;
+    float stepSize = 0.0f;      // Simulated time between the previous and current state
+    double publishTime = 0.0;   // Steady-clock seconds when the snapshot was published
+    SubstepStats substeps;
+    ContactStats contacts;
+    size_t sleepingParticles = 0;  // Stored first in 'particles'
+};
+
+// Blends the previous and current state of 'snapshot' by alpha (0 = previous, 1 = current)
+// into 'result', reusing its storage. Entities without a matching previous state are copied as-is.
+void interpolateSnapshot(const SimulationSnapshot& snapshot, float alpha, SimulationSnapshot& result);
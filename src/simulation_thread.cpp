@@ -0,0 +1,112 @@
+#include "simulation_thread.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+SimulationThread::SimulationThread(Simulation& simulation)
+    : simulation(simulation), recorder(nullptr), checkpointWriter(nullptr), checkpointRequested(false), running(false), measuredStepRate(0.0), droppedSteps(0) {
+}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start() {
+    if (running.load()) {
+        return;
+    }
+    
+    // Publish the initial state so the renderer has something to draw immediately
+    snapshots.getWriteBuffer().previousParticlePositions.clear();
+    snapshots.getWriteBuffer().previousObjectPoses.clear();
+    snapshots.getWriteBuffer().particleRemap.clear();
+    publish();
+    
+    scheduler.reset();
+    running.store(true);
+    thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+    running.store(false);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+const SimulationSnapshot& SimulationThread::acquireSnapshot() {
+    snapshots.acquire();
+    return snapshots.getReadBuffer();
+}
+
+float SimulationThread::computeInterpolationAlpha(const SimulationSnapshot& snapshot) {
+    if (snapshot.stepSize <= 0.0f) {
+        return 1.0f;
+    }
+    // The current state is shown at its publish time plus one step, the previous state one step earlier
+    float alpha = static_cast<float>((now() - snapshot.publishTime) / snapshot.stepSize);
+    return std::min(std::max(alpha, 0.0f), 1.0f);
+}
+
+void SimulationThread::run() {
+    double lastTime = now();
+    double rateWindowStart = lastTime;
+    uint64_t stepsAtWindowStart = scheduler.getExecutedSteps();
+    
+    while (running.load()) {
+        double currentTime = now();
+        int steps = scheduler.advance(currentTime - lastTime);
+        lastTime = currentTime;
+        
+        if (steps > 0) {
+            SimulationSnapshot& snapshot = snapshots.getWriteBuffer();
+            // Follow the particles of the last published snapshot through the whole batch
+            snapshot.particleRemap.resize(simulation.getParticles().size());
+            std::iota(snapshot.particleRemap.begin(), snapshot.particleRemap.end(), 0u);
+            for (int i = 0; i < steps; ++i) {
+                // Keep the state before the final step so the renderer can interpolate
+                if (i == steps - 1) {
+                    simulation.capturePreviousState(snapshot);
+                }
+                simulation.update(scheduler.getStepSize());
+                simulation.accumulateParticleRemap(snapshot.particleRemap);
+            }
+            publish();
+            droppedSteps.store(scheduler.getDroppedSteps());
+        }
+        
+        // Only the state copy happens here; the writer thread does the I/O
+        if (checkpointRequested.load() && checkpointWriter && checkpointWriter->save(simulation, checkpointPath)) {
+            checkpointRequested.store(false);
+        }
+        
+        // Measure the achieved step rate once per second
+        if (currentTime - rateWindowStart >= 1.0) {
+            uint64_t executed = scheduler.getExecutedSteps();
+            measuredStepRate.store((executed - stepsAtWindowStart) / (currentTime - rateWindowStart));
+            stepsAtWindowStart = executed;
+            rateWindowStart = currentTime;
+        }
+        
+        // Sleep until the next step is due instead of spinning
+        double wait = scheduler.getTimeUntilNextStep() - (now() - currentTime);
+        if (wait > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+    }
+}
+
+void SimulationThread::publish() {
+    SimulationSnapshot& snapshot = snapshots.getWriteBuffer();
+    simulation.captureSnapshot(snapshot);
+    snapshot.stepSize = scheduler.getStepSize();
+    snapshot.publishTime = now();
+    if (recorder) {
+        recorder->record(snapshot);
+    }
+    snapshots.publish();
+}
+
+double SimulationThread::now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "simulation.h"
+#include "simulation_snapshot.h"
+#include "triple_buffer.h"
+#include "fixed_step_scheduler.h"
+#include "trajectory_recorder.h"
+#include "checkpoint.h"
+
+// Runs Simulation::update on its own thread with a fixed step size and publishes a
+// snapshot after every batch of steps. The render thread reads the newest snapshot
+// and never touches the live simulation, so each side runs at its own rate.
+class SimulationThread {
+public:
+    explicit SimulationThread(Simulation& simulation);
+    ~SimulationThread();
+    
+    // Configuration (call before start)
+    void setStepRate(float stepsPerSecond) { scheduler.setStepRate(stepsPerSecond); }
+    void setMaxSubsteps(int maxSubsteps) { scheduler.setMaxSubsteps(maxSubsteps); }
+    float getStepRate() const { return scheduler.getStepRate(); }
+    // Every published snapshot is also handed to 'recorder' (not owned; null disables recording)
+    void setTrajectoryRecorder(TrajectoryRecorder* recorder) { this->recorder = recorder; }
+    // Checkpoints requested with requestCheckpoint() are saved to 'path' through 'writer' (not owned)
+    void setCheckpointWriter(CheckpointWriter* writer, const std::string& path) { checkpointWriter = writer; checkpointPath = path; }
+    
+    void start();
+    void stop();
+    bool isRunning() const { return running.load(); }
+    
+    // Any thread: the simulation thread copies its state after the current batch of steps
+    // and hands it to the checkpoint writer (retrying while a previous write is in progress)
+    void requestCheckpoint() { checkpointRequested.store(true); }
+    
+    // Render side: swaps in the newest published snapshot and returns it
+    const SimulationSnapshot& acquireSnapshot();
+    // Interpolation factor for rendering 'snapshot' one step behind real time
+    static float computeInterpolationAlpha(const SimulationSnapshot& snapshot);
+    
+    // Steps actually executed per second over the last measurement interval
+    double getMeasuredStepRate() const { return measuredStepRate.load(); }
+    // Steps discarded because a frame needed more than the substep budget
+    uint64_t getDroppedSteps() const { return droppedSteps.load(); }
+
+private:
+    Simulation& simulation;
+    TripleBuffer<SimulationSnapshot> snapshots;
+    FixedStepScheduler scheduler;  // Only touched by the simulation thread once started
+    TrajectoryRecorder* recorder;
+    CheckpointWriter* checkpointWriter;
+    std::string checkpointPath;
+    std::atomic<bool> checkpointRequested;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<double> measuredStepRate;
+    std::atomic<uint64_t> droppedSteps;
+    
+    void run();
+    void publish();
+    static double now();
+};
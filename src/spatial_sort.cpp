@@ -0,0 +1,71 @@
+#include "spatial_sort.h"
+#include "parallel.h"
+#include <algorithm>
+
+static const int RadixBits = 10;
+static const uint32_t RadixBuckets = 1u << RadixBits;
+static const size_t RadixChunkSize = 16384;
+
+// Spreads the low 10 bits of 'value' so that two zero bits follow each one
+static uint32_t spreadBits(uint32_t value) {
+    value &= 0x3FF;
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+uint32_t mortonCode(const glm::vec3& point, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    glm::vec3 extent = glm::max(boxMax - boxMin, glm::vec3(1e-6f));
+    glm::vec3 cell = glm::clamp((point - boxMin) / extent * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+    return (spreadBits(uint32_t(cell.z)) << 2) | (spreadBits(uint32_t(cell.y)) << 1) | spreadBits(uint32_t(cell.x));
+}
+
+void radixSortPairs(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, int keyBits, RadixSortScratch& scratch) {
+    size_t count = keys.size();
+    size_t chunkCount = (count + RadixChunkSize - 1) / RadixChunkSize;
+    scratch.keys.resize(count);
+    scratch.values.resize(count);
+    scratch.counts.resize(chunkCount * RadixBuckets);
+    
+    for (int shift = 0; shift < keyBits; shift += RadixBits) {
+        // Histogram of this digit per chunk
+        parallelFor(count, RadixChunkSize, [&](size_t begin, size_t end) {
+            uint32_t* counts = &scratch.counts[(begin / RadixChunkSize) * RadixBuckets];
+            std::fill(counts, counts + RadixBuckets, 0u);
+            for (size_t i = begin; i < end; ++i) {
+                counts[(keys[i] >> shift) & (RadixBuckets - 1)]++;
+            }
+        });
+        
+        // Exclusive prefix sum in digit-major, chunk-minor order gives every chunk its write
+        // position per digit while keeping equal digits in input order
+        uint32_t offset = 0;
+        bool singleDigit = false;
+        for (uint32_t digit = 0; digit < RadixBuckets; ++digit) {
+            uint32_t digitStart = offset;
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                uint32_t& slot = scratch.counts[chunk * RadixBuckets + digit];
+                uint32_t chunkCountForDigit = slot;
+                slot = offset;
+                offset += chunkCountForDigit;
+            }
+            singleDigit = singleDigit || offset - digitStart == count;
+        }
+        if (singleDigit) {
+            continue;
+        }
+        
+        parallelFor(count, RadixChunkSize, [&](size_t begin, size_t end) {
+            uint32_t* offsets = &scratch.counts[(begin / RadixChunkSize) * RadixBuckets];
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t position = offsets[(keys[i] >> shift) & (RadixBuckets - 1)]++;
+                scratch.keys[position] = keys[i];
+                scratch.values[position] = values[i];
+            }
+        });
+        keys.swap(scratch.keys);
+        values.swap(scratch.values);
+    }
+}
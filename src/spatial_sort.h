@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// 30-bit Morton code of a point in [boxMin, boxMax], 10 bits per axis. Points that are close
+// in space mostly get close codes, so sorting by code groups them in memory.
+uint32_t mortonCode(const glm::vec3& point, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+// Buffers reused across sorts
+struct RadixSortScratch {
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> values;
+    std::vector<uint32_t> counts;  // Digit histogram per chunk
+};
+
+// Stable parallel LSD radix sort of keys (only the low 'keyBits' bits are used) together with
+// their values. Each pass counts digits per fixed-size chunk in parallel, turns the counts into
+// per-chunk write offsets and scatters in parallel, so the result never depends on the thread
+// count. Passes whose digit is the same for every key are skipped.
+void radixSortPairs(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, int keyBits, RadixSortScratch& scratch);
@@ -0,0 +1,276 @@
+#include "sphere_tracer.h"
+#include "image_io.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+static const glm::vec3 BackgroundColor(0.1f, 0.1f, 0.1f);
+static const glm::vec3 ObjectColor(0.3f, 0.8f, 0.3f);
+static const glm::vec3 ParticleColor(1.0f, 0.3f, 0.3f);
+static const glm::vec3 KeyLight = glm::normalize(glm::vec3(0.4f, 1.0f, 0.3f));
+
+// Points closer to the camera plane than this are treated as behind it
+static const float NearPlane = 1e-3f;
+
+static glm::vec3 shade(const glm::vec3& baseColor, const glm::vec3& normal, const glm::vec3& rayDirection) {
+    // Ambient + key light + headlight so surfaces facing away from the key light stay readable
+    float key = std::max(glm::dot(normal, KeyLight), 0.0f);
+    float head = std::max(-glm::dot(normal, rayDirection), 0.0f);
+    return baseColor * (0.15f + 0.6f * key + 0.25f * head);
+}
+
+static bool intersectBounds(const glm::vec3& origin, const glm::vec3& inverseDirection,
+                            const glm::vec3& boundsMin, const glm::vec3& boundsMax, float& tNear, float& tFar) {
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 tMin = glm::min(t0, t1);
+    glm::vec3 tMax = glm::max(t0, t1);
+    tNear = std::max({tMin.x, tMin.y, tMin.z, 0.0f});
+    tFar = std::min({tMax.x, tMax.y, tMax.z});
+    return tNear <= tFar;
+}
+
+SphereTracer::SphereTracer(int width, int height)
+    : width(width), height(height), tileSize(16), maxSteps(128),
+      image(static_cast<size_t>(width) * height * 3, 0) {
+    setCamera(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+void SphereTracer::setCamera(const glm::vec3& position, const glm::vec3& target, const glm::vec3& up, float fovDegrees) {
+    cameraPosition = position;
+    cameraForward = glm::normalize(target - position);
+    cameraRight = glm::normalize(glm::cross(cameraForward, up));
+    cameraUp = glm::cross(cameraRight, cameraForward);
+    tanHalfFov = std::tan(glm::radians(fovDegrees) * 0.5f);
+}
+
+bool SphereTracer::projectBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::ivec4& tileRect) const {
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+    float aspect = float(width) / float(height);
+    
+    glm::vec2 pixelMin(std::numeric_limits<float>::max());
+    glm::vec2 pixelMax(-std::numeric_limits<float>::max());
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 point((corner & 1) ? boundsMax.x : boundsMin.x,
+                        (corner & 2) ? boundsMax.y : boundsMin.y,
+                        (corner & 4) ? boundsMax.z : boundsMin.z);
+        glm::vec3 offset = point - cameraPosition;
+        float depth = glm::dot(offset, cameraForward);
+        if (depth <= NearPlane) {
+            // Box straddles the camera plane: its projection is unbounded, so cover the screen
+            tileRect = glm::ivec4(0, 0, tilesX - 1, tilesY - 1);
+            return true;
+        }
+        float u = glm::dot(offset, cameraRight) / (depth * tanHalfFov * aspect);
+        float v = glm::dot(offset, cameraUp) / (depth * tanHalfFov);
+        glm::vec2 pixel((u * 0.5f + 0.5f) * width, (0.5f - v * 0.5f) * height);
+        pixelMin = glm::min(pixelMin, pixel);
+        pixelMax = glm::max(pixelMax, pixel);
+    }
+    
+    if (pixelMax.x < 0.0f || pixelMax.y < 0.0f || pixelMin.x >= width || pixelMin.y >= height) {
+        return false;
+    }
+    tileRect.x = std::max(int(pixelMin.x) / tileSize, 0);
+    tileRect.y = std::max(int(pixelMin.y) / tileSize, 0);
+    tileRect.z = std::min(int(pixelMax.x) / tileSize, tilesX - 1);
+    tileRect.w = std::min(int(pixelMax.y) / tileSize, tilesY - 1);
+    return true;
+}
+
+bool SphereTracer::projectSphere(const glm::vec3& center, float radius, glm::ivec4& tileRect) const {
+    glm::vec3 offset = center - cameraPosition;
+    float depth = glm::dot(offset, cameraForward);
+    if (depth + radius <= NearPlane) {
+        return false;
+    }
+    if (depth - radius <= NearPlane) {
+        return projectBounds(center - glm::vec3(radius), center + glm::vec3(radius), tileRect);
+    }
+    
+    // Conservative screen radius: the sphere never extends past radius / (depth - radius) in tangent space
+    float aspect = float(width) / float(height);
+    float tangentRadius = radius / (depth - radius);
+    float u = glm::dot(offset, cameraRight) / depth;
+    float v = glm::dot(offset, cameraUp) / depth;
+    float scaleX = 0.5f * width / (tanHalfFov * aspect);
+    float scaleY = 0.5f * height / tanHalfFov;
+    
+    float minX = 0.5f * width + (u - tangentRadius) * scaleX;
+    float maxX = 0.5f * width + (u + tangentRadius) * scaleX;
+    float minY = 0.5f * height - (v + tangentRadius) * scaleY;
+    float maxY = 0.5f * height - (v - tangentRadius) * scaleY;
+    if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height) {
+        return false;
+    }
+    
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+    tileRect.x = std::max(int(minX) / tileSize, 0);
+    tileRect.y = std::max(int(minY) / tileSize, 0);
+    tileRect.z = std::min(int(maxX) / tileSize, tilesX - 1);
+    tileRect.w = std::min(int(maxY) / tileSize, tilesY - 1);
+    return true;
+}
+
+void SphereTracer::render(const Simulation& simulation) {
+    auto start = std::chrono::high_resolution_clock::now();
+    stats = SphereTraceStats();
+    
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+    size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+    tileObjects.resize(tileCount);
+    tileParticles.resize(tileCount);
+    for (size_t i = 0; i < tileCount; ++i) {
+        tileObjects[i].clear();
+        tileParticles[i].clear();
+    }
+    
+    // Querying the world bounds and inverse transform refreshes each object's cached
+    // matrices, so the tracing threads below only read shared state
+    objects.clear();
+    for (const auto& obj : simulation.getCollisionObjects()) {
+        if (!obj || !obj->isValid()) {
+            continue;
+        }
+        ObjectInfo info;
+        info.object = obj.get();
+        info.boundsMin = obj->getWorldMin();
+        info.boundsMax = obj->getWorldMax();
+        info.hitDistance = std::max(0.5f * obj->getWorldCellSize(), 1e-5f);
+        obj->getInverseTransformMatrix();
+        objects.push_back(info);
+    }
+    
+    // Bin objects and particles into the tiles their projections touch
+    glm::ivec4 rect;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        if (projectBounds(objects[i].boundsMin, objects[i].boundsMax, rect)) {
+            for (int y = rect.y; y <= rect.w; ++y) {
+                for (int x = rect.x; x <= rect.z; ++x) {
+                    tileObjects[y * tilesX + x].push_back(static_cast<uint32_t>(i));
+                }
+            }
+        }
+    }
+    const std::vector<Particle>& particles = simulation.getParticles();
+    for (size_t i = 0; i < particles.size(); ++i) {
+        if (projectSphere(particles[i].getPosition(), particles[i].getSize(), rect)) {
+            for (int y = rect.y; y <= rect.w; ++y) {
+                for (int x = rect.x; x <= rect.z; ++x) {
+                    tileParticles[y * tilesX + x].push_back(static_cast<uint32_t>(i));
+                }
+            }
+        }
+    }
+    
+    std::atomic<uint64_t> sdfQueries(0), sphereTests(0);
+    std::atomic<int> emptyTiles(0);
+    parallelFor(tileCount, 1, [&](size_t begin, size_t end) {
+        uint64_t localQueries = 0, localTests = 0;
+        for (size_t tile = begin; tile < end; ++tile) {
+            if (tileObjects[tile].empty() && tileParticles[tile].empty()) {
+                emptyTiles++;
+            }
+            traceTile(int(tile % tilesX), int(tile / tilesX), particles, localQueries, localTests);
+        }
+        sdfQueries += localQueries;
+        sphereTests += localTests;
+    });
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.rays = static_cast<uint64_t>(width) * height;
+    stats.sdfQueries = sdfQueries.load();
+    stats.sphereTests = sphereTests.load();
+    stats.tiles = static_cast<int>(tileCount);
+    stats.emptyTiles = emptyTiles.load();
+    stats.renderTimeMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void SphereTracer::traceTile(int tileX, int tileY, const std::vector<Particle>& particles,
+                             uint64_t& sdfQueries, uint64_t& sphereTests) {
+    int tilesX = (width + tileSize - 1) / tileSize;
+    const std::vector<uint32_t>& candidateObjects = tileObjects[tileY * tilesX + tileX];
+    const std::vector<uint32_t>& candidateParticles = tileParticles[tileY * tilesX + tileX];
+    float aspect = float(width) / float(height);
+    
+    int x0 = tileX * tileSize, x1 = std::min(x0 + tileSize, width);
+    int y0 = tileY * tileSize, y1 = std::min(y0 + tileSize, height);
+    for (int py = y0; py < y1; ++py) {
+        for (int px = x0; px < x1; ++px) {
+            glm::vec3 color = BackgroundColor;
+            
+            if (!candidateObjects.empty() || !candidateParticles.empty()) {
+                float u = ((px + 0.5f) / width * 2.0f - 1.0f) * tanHalfFov * aspect;
+                float v = (1.0f - (py + 0.5f) / height * 2.0f) * tanHalfFov;
+                glm::vec3 direction = glm::normalize(cameraForward + u * cameraRight + v * cameraUp);
+                float nearestT = std::numeric_limits<float>::max();
+                
+                // Particles first: analytic hits are cheap and shorten the SDF march below
+                int hitParticle = -1;
+                for (uint32_t index : candidateParticles) {
+                    const Particle& particle = particles[index];
+                    float radius = particle.getSize();
+                    glm::vec3 oc = cameraPosition - particle.getPosition();
+                    float b = glm::dot(oc, direction);
+                    float h = b * b - (glm::dot(oc, oc) - radius * radius);
+                    sphereTests++;
+                    if (h >= 0.0f) {
+                        float t = -b - std::sqrt(h);
+                        if (t > 0.0f && t < nearestT) {
+                            nearestT = t;
+                            hitParticle = static_cast<int>(index);
+                        }
+                    }
+                }
+                
+                // March each object only inside its bounds and only up to the nearest hit so far
+                const CollisionObject* hitObject = nullptr;
+                glm::vec3 inverseDirection = 1.0f / direction;
+                for (uint32_t index : candidateObjects) {
+                    const ObjectInfo& info = objects[index];
+                    float t, tFar;
+                    if (!intersectBounds(cameraPosition, inverseDirection, info.boundsMin, info.boundsMax, t, tFar)) {
+                        continue;
+                    }
+                    tFar = std::min(tFar, nearestT);
+                    for (int step = 0; step < maxSteps && t < tFar; ++step) {
+                        float distance = info.object->getSignedDistance(cameraPosition + direction * t);
+                        sdfQueries++;
+                        if (distance < info.hitDistance) {
+                            nearestT = t;
+                            hitObject = info.object;
+                            break;
+                        }
+                        t += std::max(distance, info.hitDistance);
+                    }
+                }
+                
+                glm::vec3 hitPoint = cameraPosition + direction * nearestT;
+                if (hitObject) {
+                    glm::vec3 normal = hitObject->getNormal(hitPoint);
+                    float length = glm::length(normal);
+                    normal = length > 1e-6f ? normal / length : -direction;
+                    color = shade(ObjectColor, normal, direction);
+                } else if (hitParticle >= 0) {
+                    glm::vec3 normal = glm::normalize(hitPoint - particles[hitParticle].getPosition());
+                    color = shade(ParticleColor, normal, direction);
+                }
+            }
+            
+            unsigned char* pixel = image.data() + (static_cast<size_t>(py) * width + px) * 3;
+            pixel[0] = static_cast<unsigned char>(glm::clamp(color.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+            pixel[1] = static_cast<unsigned char>(glm::clamp(color.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+            pixel[2] = static_cast<unsigned char>(glm::clamp(color.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+bool SphereTracer::writeImage(const std::string& path) const {
+    return writePPM(path, width, height, image.data());
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "simulation.h"
+
+// Counters for the last render() call
+struct SphereTraceStats {
+    uint64_t rays = 0;
+    uint64_t sdfQueries = 0;      // SDF samples taken while marching
+    uint64_t sphereTests = 0;     // Analytic ray-particle intersections
+    int tiles = 0;
+    int emptyTiles = 0;           // Tiles with nothing projected onto them, filled without tracing
+    double renderTimeMs = 0.0;
+};
+
+// CPU renderer for headless previews: collision objects are sphere-traced through their
+// SDFs (with transforms) and particles are intersected as analytic spheres. The image is
+// split into tiles traced in parallel. Objects and particles are binned into the tiles
+// their screen bounds touch, and each ray stops marching once it passes the nearest hit.
+class SphereTracer {
+public:
+    SphereTracer(int width, int height);
+    
+    void setCamera(const glm::vec3& position, const glm::vec3& target, const glm::vec3& up, float fovDegrees = 45.0f);
+    void setTileSize(int size) { tileSize = std::max(size, 4); }
+    void setMaxSteps(int steps) { maxSteps = std::max(steps, 1); }
+    
+    // Traces the current state of 'simulation' into the image
+    void render(const Simulation& simulation);
+    
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    // RGB, 3 bytes per pixel, rows top to bottom
+    const std::vector<unsigned char>& getImage() const { return image; }
+    bool writeImage(const std::string& path) const;
+    
+    const SphereTraceStats& getStats() const { return stats; }
+
+private:
+    struct ObjectInfo {
+        const CollisionObject* object;
+        glm::vec3 boundsMin, boundsMax;
+        float hitDistance;  // Surface threshold, half an SDF cell
+    };
+    
+    int width, height;
+    int tileSize;
+    int maxSteps;
+    std::vector<unsigned char> image;
+    SphereTraceStats stats;
+    
+    // Camera basis; primary ray direction = forward + u * right + v * up
+    glm::vec3 cameraPosition;
+    glm::vec3 cameraForward, cameraRight, cameraUp;
+    float tanHalfFov;
+    
+    // Per-frame scene data and tile bins, reused between frames
+    std::vector<ObjectInfo> objects;
+    std::vector<std::vector<uint32_t>> tileObjects;
+    std::vector<std::vector<uint32_t>> tileParticles;
+    
+    bool projectBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::ivec4& tileRect) const;
+    bool projectSphere(const glm::vec3& center, float radius, glm::ivec4& tileRect) const;
+    void traceTile(int tileX, int tileY, const std::vector<Particle>& particles,
+                   uint64_t& sdfQueries, uint64_t& sphereTests);
+};
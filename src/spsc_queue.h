@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free single-producer / single-consumer FIFO.
+// push and pop never wait: they fail when the queue is full or empty, so the
+// producer can decide to drop work instead of blocking on a slow consumer.
+template <typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity = 16) : head(0), tail(0) {
+        reset(capacity);
+    }
+    
+    // Empties the queue and resizes it; only valid while neither side is using it
+    void reset(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots.clear();
+        slots.resize(size);
+        mask = size - 1;
+        head.store(0);
+        tail.store(0);
+    }
+    
+    // Producer side: moves 'value' in; returns false (leaving it untouched) if full
+    bool tryPush(T& value) {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        slots[currentTail & mask] = std::move(value);
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Consumer side: moves the oldest value into 'value'; returns false if empty
+    bool tryPop(T& value) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(slots[currentHead & mask]);
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+    
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+    size_t capacity() const { return mask + 1; }
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+    
+    // Kept on separate cache lines so producer and consumer do not false-share
+    alignas(64) std::atomic<size_t> head;  // Next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail;  // Next slot to push, written by the producer
+};
@@ -0,0 +1,143 @@
+#include "stream_buffer.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+StreamBuffer::StreamBuffer()
+    : target(GL_ARRAY_BUFFER), buffer(0), segmentSize(0), segmentCount(0), currentSegment(0),
+      persistent(false), mapped(false), persistentPtr(nullptr) {
+    for (int i = 0; i < MaxSegments; ++i) {
+        fences[i] = nullptr;
+    }
+}
+
+StreamBuffer::~StreamBuffer() {
+    destroy();
+}
+
+bool StreamBuffer::create(GLenum target, size_t segmentSize, int segmentCount) {
+    destroy();
+    this->target = target;
+    this->segmentSize = std::max<size_t>(segmentSize, 256);
+    this->segmentCount = std::min(std::max(segmentCount, 1), MaxSegments);
+    return allocate();
+}
+
+void StreamBuffer::destroy() {
+    for (int i = 0; i < MaxSegments; ++i) {
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+    if (buffer) {
+        if (persistentPtr) {
+            glBindBuffer(target, buffer);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    persistentPtr = nullptr;
+    mapped = false;
+    currentSegment = 0;
+}
+
+bool StreamBuffer::allocate() {
+    GLsizeiptr totalSize = static_cast<GLsizeiptr>(segmentSize * segmentCount);
+    
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    
+    // Prefer immutable storage that stays mapped for the lifetime of the buffer
+    persistent = GLEW_ARB_buffer_storage != 0;
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, totalSize, nullptr, flags);
+        persistentPtr = static_cast<char*>(glMapBufferRange(target, 0, totalSize, flags));
+        if (!persistentPtr) {
+            std::cerr << "StreamBuffer: persistent mapping failed, falling back to glMapBufferRange" << std::endl;
+            glBindBuffer(target, 0);
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(target, buffer);
+            persistent = false;
+        }
+    }
+    if (!persistent) {
+        glBufferData(target, totalSize, nullptr, GL_STREAM_DRAW);
+    }
+    
+    glBindBuffer(target, 0);
+    return buffer != 0;
+}
+
+void* StreamBuffer::map(size_t size) {
+    if (size > segmentSize) {
+        // Reallocate with room to spare; the old buffer stays alive until the GPU is done with it
+        size_t newSegmentSize = std::max(size, segmentSize * 2);
+        int count = segmentCount;
+        destroy();
+        segmentSize = newSegmentSize;
+        segmentCount = count;
+        allocate();
+        stats.reallocations++;
+    }
+    
+    waitForSegment(currentSegment);
+    
+    GLintptr offset = static_cast<GLintptr>(segmentSize * currentSegment);
+    mapped = true;
+    if (persistent) {
+        return persistentPtr + offset;
+    }
+    
+    // The fence already guarantees the GPU is done with this range, so skip driver synchronization
+    glBindBuffer(target, buffer);
+    void* ptr = glMapBufferRange(target, offset, static_cast<GLsizeiptr>(size),
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(target, 0);
+    return ptr;
+}
+
+GLintptr StreamBuffer::unmap(size_t bytesWritten) {
+    if (mapped && !persistent) {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        glBindBuffer(target, 0);
+    }
+    mapped = false;
+    stats.bytesUploaded += bytesWritten;
+    return static_cast<GLintptr>(segmentSize * currentSegment);
+}
+
+void StreamBuffer::fence() {
+    if (fences[currentSegment]) {
+        glDeleteSync(fences[currentSegment]);
+    }
+    fences[currentSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    currentSegment = (currentSegment + 1) % segmentCount;
+}
+
+void StreamBuffer::waitForSegment(int segment) {
+    GLsync sync = fences[segment];
+    if (!sync) {
+        return;
+    }
+    
+    // Fast path: the GPU finished with this segment long ago
+    GLenum result = glClientWaitSync(sync, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        auto start = std::chrono::high_resolution_clock::now();
+        do {
+            result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);  // 1 ms
+        } while (result == GL_TIMEOUT_EXPIRED);
+        auto end = std::chrono::high_resolution_clock::now();
+        stats.waitTimeMs += std::chrono::duration<double, std::milli>(end - start).count();
+        stats.stalls++;
+    }
+    
+    glDeleteSync(sync);
+    fences[segment] = nullptr;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+
+// Upload statistics accumulated since the last resetStats()
+struct StreamBufferStats {
+    size_t bytesUploaded = 0;
+    double waitTimeMs = 0.0;  // CPU time spent waiting for the GPU to release a segment
+    int stalls = 0;           // Number of maps that had to wait on a fence
+    int reallocations = 0;
+};
+
+// Ring of N fixed-size segments inside one GL buffer for per-frame streaming data.
+// Each map() hands out the next segment; a fence placed after the draw that reads
+// it guarantees the CPU never overwrites data the GPU has not consumed yet.
+// Uses a persistently mapped buffer when ARB_buffer_storage is available, otherwise
+// falls back to unsynchronized glMapBufferRange on the same ring.
+class StreamBuffer {
+public:
+    StreamBuffer();
+    ~StreamBuffer();
+    
+    bool create(GLenum target, size_t segmentSize, int segmentCount = 3);
+    void destroy();
+    
+    // Returns a write pointer to at least 'size' bytes (grows the ring if needed)
+    void* map(size_t size);
+    // Finishes writing 'bytesWritten' bytes; returns the byte offset of the segment in getBuffer()
+    GLintptr unmap(size_t bytesWritten);
+    // Call after the draw that consumes the current segment, then advances the ring
+    void fence();
+    
+    GLuint getBuffer() const { return buffer; }
+    size_t getSegmentSize() const { return segmentSize; }
+    bool isPersistent() const { return persistent; }
+    
+    const StreamBufferStats& getStats() const { return stats; }
+    void resetStats() { stats = StreamBufferStats(); }
+
+private:
+    static constexpr int MaxSegments = 4;
+    
+    GLenum target;
+    GLuint buffer;
+    size_t segmentSize;
+    int segmentCount;
+    int currentSegment;
+    bool persistent;
+    bool mapped;
+    char* persistentPtr;
+    GLsync fences[MaxSegments];
+    
+    StreamBufferStats stats;
+    
+    bool allocate();
+    void waitForSegment(int segment);
+};
@@ -0,0 +1,175 @@
+#include "surface_extractor.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+
+// Cell edges as corner pairs; corner c sits at offset (c & 1, (c >> 1) & 1, (c >> 2) & 1)
+static const int CellEdges[12][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7},  // along x
+    {0, 2}, {1, 3}, {4, 6}, {5, 7},  // along y
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}   // along z
+};
+
+SurfaceExtractor::SurfaceExtractor() : isoValue(0.0f), level(0) {
+}
+
+void SurfaceExtractor::extract(const SDF& sdf, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices) {
+    auto start = std::chrono::high_resolution_clock::now();
+    vertices.clear();
+    indices.clear();
+    stats = SurfaceExtractionStats();
+    
+    // Lattice point i samples grid point i * step; the last one is clamped to the grid
+    // edge so coarse levels still cover the whole field and stay closed
+    int step = 1 << level;
+    int lastGrid = sdf.getResolution() - 1;
+    int points = (lastGrid + step - 1) / step + 1;
+    int cells = points - 1;
+    stats.gridPoints = points;
+    if (cells < 1) {
+        return;
+    }
+    
+    glm::vec3 origin = sdf.getMin();
+    glm::vec3 cellSize = sdf.getCellSize();
+    auto grid = [step, lastGrid](int i) {
+        return std::min(i * step, lastGrid);
+    };
+    auto value = [&](int x, int y, int z) {
+        return sdf.getGridValue(grid(x), grid(y), grid(z)) - isoValue;
+    };
+    auto cellIndex = [cells](int x, int y, int z) {
+        return (static_cast<size_t>(z) * cells + y) * cells + x;
+    };
+    
+    // Pass 1: one vertex per cell the surface crosses, at the mean of its edge crossings
+    cellVertex.assign(static_cast<size_t>(cells) * cells * cells, -1);
+    slabVertices.resize(cells);
+    parallelFor(cells, 1, [&](size_t begin, size_t end) {
+        for (size_t slab = begin; slab < end; ++slab) {
+            int z = static_cast<int>(slab);
+            std::vector<glm::vec3>& out = slabVertices[slab];
+            out.clear();
+            for (int y = 0; y < cells; ++y) {
+                for (int x = 0; x < cells; ++x) {
+                    float corner[8];
+                    glm::vec3 cornerGrid[8];
+                    int insideMask = 0;
+                    for (int c = 0; c < 8; ++c) {
+                        int cx = x + (c & 1), cy = y + ((c >> 1) & 1), cz = z + ((c >> 2) & 1);
+                        corner[c] = value(cx, cy, cz);
+                        cornerGrid[c] = glm::vec3(float(grid(cx)), float(grid(cy)), float(grid(cz)));
+                        if (corner[c] < 0.0f) {
+                            insideMask |= 1 << c;
+                        }
+                    }
+                    if (insideMask == 0 || insideMask == 0xFF) {
+                        continue;
+                    }
+                    
+                    glm::vec3 sum(0.0f);
+                    int crossings = 0;
+                    for (const auto& edge : CellEdges) {
+                        int a = edge[0], b = edge[1];
+                        if (((insideMask >> a) & 1) != ((insideMask >> b) & 1)) {
+                            float t = corner[a] / (corner[a] - corner[b]);
+                            sum += glm::mix(cornerGrid[a], cornerGrid[b], t);
+                            crossings++;
+                        }
+                    }
+                    
+                    cellVertex[cellIndex(x, y, z)] = static_cast<int>(out.size());
+                    out.push_back(origin + sum / float(crossings) * cellSize);
+                }
+            }
+        }
+    });
+    
+    // Turn slab-local vertex numbers into global ones
+    std::vector<size_t> slabOffsets(cells);
+    size_t vertexCount = 0;
+    for (int z = 0; z < cells; ++z) {
+        slabOffsets[z] = vertexCount;
+        vertexCount += slabVertices[z].size();
+    }
+    vertices.resize(vertexCount);
+    parallelFor(cells, 1, [&](size_t begin, size_t end) {
+        for (size_t slab = begin; slab < end; ++slab) {
+            std::copy(slabVertices[slab].begin(), slabVertices[slab].end(), vertices.begin() + slabOffsets[slab]);
+            int* slabCells = cellVertex.data() + slab * cells * cells;
+            for (size_t i = 0; i < static_cast<size_t>(cells) * cells; ++i) {
+                if (slabCells[i] >= 0) {
+                    slabCells[i] += static_cast<int>(slabOffsets[slab]);
+                }
+            }
+        }
+    });
+    
+    // Pass 2: each sign-changing lattice edge joins the vertices of the four cells around it.
+    // (u, v) are the other two axes in cyclic order, so the quad winds around +axis.
+    slabIndices.resize(points);
+    parallelFor(points, 1, [&](size_t begin, size_t end) {
+        for (size_t slab = begin; slab < end; ++slab) {
+            int z = static_cast<int>(slab);
+            std::vector<unsigned int>& out = slabIndices[slab];
+            out.clear();
+            for (int y = 0; y < points; ++y) {
+                for (int x = 0; x < points; ++x) {
+                    glm::ivec3 p(x, y, z);
+                    float v0 = value(x, y, z);
+                    for (int axis = 0; axis < 3; ++axis) {
+                        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                        if (p[axis] + 1 >= points || p[u] < 1 || p[u] > cells - 1 || p[v] < 1 || p[v] > cells - 1) {
+                            continue;
+                        }
+                        glm::ivec3 q = p;
+                        q[axis] += 1;
+                        float v1 = value(q.x, q.y, q.z);
+                        if ((v0 < 0.0f) == (v1 < 0.0f)) {
+                            continue;
+                        }
+                        
+                        int quad[4];
+                        const int du[4] = {-1, 0, 0, -1};
+                        const int dv[4] = {-1, -1, 0, 0};
+                        for (int k = 0; k < 4; ++k) {
+                            glm::ivec3 cell = p;
+                            cell[u] += du[k];
+                            cell[v] += dv[k];
+                            quad[k] = cellVertex[cellIndex(cell.x, cell.y, cell.z)];
+                        }
+                        
+                        // Face the outside: from the negative end of the edge toward the positive one
+                        if (v0 >= 0.0f) {
+                            std::swap(quad[1], quad[3]);
+                        }
+                        out.insert(out.end(), {
+                            unsigned(quad[0]), unsigned(quad[1]), unsigned(quad[2]),
+                            unsigned(quad[0]), unsigned(quad[2]), unsigned(quad[3])
+                        });
+                    }
+                }
+            }
+        }
+    });
+    
+    for (const auto& slab : slabIndices) {
+        indices.insert(indices.end(), slab.begin(), slab.end());
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.vertices = vertices.size();
+    stats.triangles = indices.size() / 3;
+    stats.timeMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool SurfaceExtractor::extract(const SDF& sdf, Mesh& mesh) {
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    extract(sdf, vertices, indices);
+    if (indices.empty()) {
+        return false;
+    }
+    mesh.setGeometry(vertices, indices);
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "sdf.h"
+#include "mesh.h"
+
+// Size of the indexed mesh from the last extraction; vertices are shared between triangles
+struct SurfaceExtractionStats {
+    size_t vertices = 0;
+    size_t triangles = 0;
+    int gridPoints = 0;  // Lattice points per axis at the chosen level
+    double timeMs = 0.0;
+};
+
+// Extracts the isosurface of an SDF grid as an indexed triangle mesh with dual contouring
+// (surface-nets vertex placement): each grid cell the surface passes through gets one
+// vertex at the average of its edge crossings, and every sign-changing grid edge emits a
+// quad joining the four cells around it. Vertices are therefore shared between faces by
+// construction, with no welding pass needed. 'level' decimates by sampling every 2^level
+// grid points. Both passes run over z-slabs in parallel.
+class SurfaceExtractor {
+public:
+    SurfaceExtractor();
+    
+    void setIsoValue(float value) { isoValue = value; }
+    void setLevel(int level) { this->level = glm::max(level, 0); }
+    
+    void extract(const SDF& sdf, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices);
+    // Extracts straight into 'mesh'; returns false if the surface is empty at this level
+    bool extract(const SDF& sdf, Mesh& mesh);
+    
+    const SurfaceExtractionStats& getStats() const { return stats; }
+
+private:
+    float isoValue;
+    int level;
+    SurfaceExtractionStats stats;
+    
+    // Scratch reused between extractions
+    std::vector<int> cellVertex;                          // Vertex index per cell, -1 if none
+    std::vector<std::vector<glm::vec3>> slabVertices;     // Pass 1 output per slab
+    std::vector<std::vector<unsigned int>> slabIndices;   // Pass 2 output per slab
+};
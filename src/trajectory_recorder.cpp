@@ -0,0 +1,475 @@
+#include "trajectory_recorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+static const char TrajectoryMagic[8] = {'S', 'D', 'F', 'T', 'R', 'A', 'J', '1'};
+static const uint32_t TrajectoryVersion = 2;
+static const uint32_t FrameTag = 0x454D5246;  // 'FRME'
+static const uint32_t FlagQuantized = 1;
+static const uint32_t FlagDelta = 2;
+static const uint8_t FrameKeyframe = 1;
+static const uint8_t FrameRemap = 2;
+
+// Magic, version, flags, two precisions, origin and keyframe interval
+static const size_t FileHeaderBytes = 8 + 4 + 4 + 4 + 4 + 12 + 4;
+// Fixed part of a frame chunk: tag + size, then step, time, counts and frame flags
+static const size_t ChunkHeaderBytes = 8;
+static const size_t FrameHeaderBytes = 8 + 8 + 4 + 4 + 1;
+static const size_t ObjectBytes = 10 * sizeof(float);
+static const size_t ParticleBytes = 6 * sizeof(float);
+
+// Values are written in host byte order, which is little endian on every supported platform
+template <typename T>
+static void appendValue(std::vector<unsigned char>& out, const T& value) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static bool readValue(const std::vector<unsigned char>& in, size_t& offset, T& value) {
+    if (offset + sizeof(T) > in.size()) {
+        return false;
+    }
+    std::memcpy(&value, in.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+// Zigzag maps small magnitudes of either sign to small unsigned values; varints then
+// store them in 7-bit groups, so slowly moving particles cost one byte per channel
+static void appendVarint(std::vector<unsigned char>& out, int64_t value) {
+    uint64_t zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    while (zigzag >= 0x80) {
+        out.push_back(static_cast<unsigned char>(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(zigzag));
+}
+
+static bool readVarint(const std::vector<unsigned char>& in, size_t& offset, int64_t& value) {
+    uint64_t zigzag = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (offset >= in.size()) {
+            return false;
+        }
+        unsigned char byte = in[offset++];
+        zigzag |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            value = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static int32_t quantizeValue(float value, float precision) {
+    double scaled = std::round(static_cast<double>(value) / precision);
+    scaled = std::min(std::max(scaled, double(std::numeric_limits<int32_t>::min())), double(std::numeric_limits<int32_t>::max()));
+    return static_cast<int32_t>(scaled);
+}
+
+// A remap must cover every particle and only refer to particles of the previous frame
+static bool isValidRemap(const std::vector<uint32_t>& remap, size_t particleCount, size_t previousCount) {
+    if (remap.size() != particleCount) {
+        return false;
+    }
+    for (uint32_t source : remap) {
+        if (source != SimulationSnapshot::NewParticle && source >= previousCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isIdentityRemap(const std::vector<uint32_t>& remap, size_t previousCount) {
+    if (remap.size() != previousCount) {
+        return false;
+    }
+    for (size_t i = 0; i < remap.size(); ++i) {
+        if (remap[i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Moves channel-major values of 'previousCount' particles to the slots given by 'remap';
+// new particles get zeros
+static void remapChannels(const std::vector<int32_t>& previous, size_t previousCount,
+                          const std::vector<uint32_t>& remap, std::vector<int32_t>& result) {
+    size_t count = remap.size();
+    result.resize(count * 6);
+    for (int channel = 0; channel < 6; ++channel) {
+        const int32_t* from = previous.data() + channel * previousCount;
+        int32_t* to = result.data() + channel * count;
+        for (size_t i = 0; i < count; ++i) {
+            to[i] = remap[i] == SimulationSnapshot::NewParticle ? 0 : from[remap[i]];
+        }
+    }
+}
+
+TrajectoryRecorder::TrajectoryRecorder()
+    : origin(0.0f), active(false), stopping(false), stagingDropped(false), framesEncoded(0), previousParticleCount(0),
+      framesRecorded(0), framesDropped(0), bytesWritten(0), rawBytes(0), lastFrameBytes(0) {
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    close();
+}
+
+bool TrajectoryRecorder::open(const std::string& path, const glm::vec3& origin, const TrajectoryOptions& options) {
+    close();
+    
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "TrajectoryRecorder: cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+    
+    this->origin = origin;
+    this->options = options;
+    this->options.keyframeInterval = std::max(options.keyframeInterval, 1);
+    if (this->options.velocityPrecision <= 0.0f) {
+        this->options.velocityPrecision = options.positionPrecision;
+    }
+    bool quantized = this->options.positionPrecision > 0.0f;
+    uint32_t flags = (quantized ? FlagQuantized : 0) | (quantized && options.deltaEncoding ? FlagDelta : 0);
+    
+    std::vector<unsigned char> header(TrajectoryMagic, TrajectoryMagic + sizeof(TrajectoryMagic));
+    appendValue(header, TrajectoryVersion);
+    appendValue(header, flags);
+    appendValue(header, this->options.positionPrecision);
+    appendValue(header, this->options.velocityPrecision);
+    appendValue(header, origin.x);
+    appendValue(header, origin.y);
+    appendValue(header, origin.z);
+    appendValue(header, static_cast<uint32_t>(this->options.keyframeInterval));
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    
+    // Recycled frames can never outnumber the frames handed to the writer
+    pending.reset(options.queueCapacity);
+    recycled.reset(pending.capacity() * 2);
+    staging = TrajectoryFrame();
+    stagingDropped = false;
+    previousQuantized.clear();
+    framesEncoded = 0;
+    previousParticleCount = 0;
+    framesRecorded = 0;
+    framesDropped = 0;
+    bytesWritten = header.size();
+    rawBytes = header.size();
+    lastFrameBytes = 0;
+    stopping = false;
+    active = true;
+    writer = std::thread(&TrajectoryRecorder::writerLoop, this);
+    return true;
+}
+
+void TrajectoryRecorder::close() {
+    if (!active) {
+        return;
+    }
+    
+    // The writer drains everything already queued before it exits
+    stopping = true;
+    writer.join();
+    file.close();
+    active = false;
+}
+
+void TrajectoryRecorder::record(const SimulationSnapshot& snapshot) {
+    if (!active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    
+    // Reuse storage the writer has finished with; allocation only happens while the pool warms up
+    if (staging.positions.capacity() == 0) {
+        recycled.tryPop(staging);
+    }
+    
+    staging.step = snapshot.stepCount;
+    staging.time = snapshot.simulationTime;
+    size_t particleCount = snapshot.particles.size();
+    staging.positions.resize(particleCount);
+    staging.velocities.resize(particleCount);
+    for (size_t i = 0; i < particleCount; ++i) {
+        staging.positions[i] = snapshot.particles[i].getPosition();
+        staging.velocities[i] = snapshot.particles[i].getVelocity();
+    }
+    staging.objects.resize(snapshot.objects.size());
+    for (size_t i = 0; i < snapshot.objects.size(); ++i) {
+        const SimulationSnapshot::ObjectState& object = snapshot.objects[i];
+        staging.objects[i] = {object.position, object.rotation, object.scale};
+    }
+    
+    // The snapshot's remap is relative to the previous snapshot. If that one was dropped,
+    // 'staging' still holds its remap, relative to the last frame the writer got, and the
+    // two compose.
+    const std::vector<uint32_t>& remap = snapshot.particleRemap;
+    if (!stagingDropped) {
+        staging.remap = remap;
+    } else if (staging.remap.empty() || remap.empty()) {
+        staging.remap.clear();
+    } else {
+        composedRemap.resize(remap.size());
+        for (size_t i = 0; i < remap.size(); ++i) {
+            uint32_t source = remap[i];
+            composedRemap[i] = source < staging.remap.size() ? staging.remap[source] : SimulationSnapshot::NewParticle;
+        }
+        staging.remap.swap(composedRemap);
+    }
+    
+    // On failure 'staging' keeps its storage for the next frame
+    stagingDropped = !pending.tryPush(staging);
+    if (!stagingDropped) {
+        framesRecorded.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        framesDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+TrajectoryStats TrajectoryRecorder::getStats() const {
+    TrajectoryStats stats;
+    stats.framesRecorded = framesRecorded.load();
+    stats.framesDropped = framesDropped.load();
+    stats.bytesWritten = bytesWritten.load();
+    stats.rawBytes = rawBytes.load();
+    stats.lastFrameBytes = lastFrameBytes.load();
+    return stats;
+}
+
+void TrajectoryRecorder::writerLoop() {
+    TrajectoryFrame frame;
+    while (true) {
+        if (pending.tryPop(frame)) {
+            writeFrame(frame);
+            recycled.tryPush(frame);
+            continue;
+        }
+        if (stopping.load()) {
+            if (pending.empty()) {
+                break;
+            }
+            continue;
+        }
+        // The queue is lock-free, so the writer polls instead of waiting on the producer
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    file.flush();
+}
+
+void TrajectoryRecorder::writeFrame(const TrajectoryFrame& frame) {
+    size_t particleCount = frame.positions.size();
+    bool quantized = options.positionPrecision > 0.0f;
+    
+    // A remap is stored when the particles changed slots since the previous frame. Deltas
+    // need the previous values of the same particles: either in the same slots or remapped.
+    bool remapped = framesEncoded > 0 && isValidRemap(frame.remap, particleCount, previousParticleCount)
+        && !isIdentityRemap(frame.remap, previousParticleCount);
+    bool keyframe = !quantized || !options.deltaEncoding
+        || framesEncoded % options.keyframeInterval == 0
+        || previousQuantized.size() != previousParticleCount * 6
+        || (!remapped && previousParticleCount != particleCount);
+    
+    payload.clear();
+    appendValue(payload, FrameTag);
+    appendValue(payload, uint32_t(0));  // Payload size, patched below
+    appendValue(payload, frame.step);
+    appendValue(payload, frame.time);
+    appendValue(payload, static_cast<uint32_t>(particleCount));
+    appendValue(payload, static_cast<uint32_t>(frame.objects.size()));
+    appendValue(payload, static_cast<uint8_t>((keyframe ? FrameKeyframe : 0) | (remapped ? FrameRemap : 0)));
+    
+    for (const auto& object : frame.objects) {
+        float values[10] = {
+            object.position.x, object.position.y, object.position.z,
+            object.rotation.w, object.rotation.x, object.rotation.y, object.rotation.z,
+            object.scale.x, object.scale.y, object.scale.z
+        };
+        appendValue(payload, values);
+    }
+    
+    if (remapped) {
+        for (size_t i = 0; i < particleCount; ++i) {
+            int64_t source = frame.remap[i] == SimulationSnapshot::NewParticle ? -1 : int64_t(frame.remap[i]);
+            appendVarint(payload, source - int64_t(i));
+        }
+    }
+    
+    if (!quantized) {
+        for (size_t i = 0; i < particleCount; ++i) {
+            appendValue(payload, frame.positions[i]);
+            appendValue(payload, frame.velocities[i]);
+        }
+    } else {
+        // Channel-major so each varint run covers one coordinate of all particles
+        currentQuantized.resize(particleCount * 6);
+        for (size_t i = 0; i < particleCount; ++i) {
+            glm::vec3 position = frame.positions[i] - origin;
+            glm::vec3 velocity = frame.velocities[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                currentQuantized[axis * particleCount + i] = quantizeValue(position[axis], options.positionPrecision);
+                currentQuantized[(3 + axis) * particleCount + i] = quantizeValue(velocity[axis], options.velocityPrecision);
+            }
+        }
+        if (!keyframe && remapped) {
+            remapChannels(previousQuantized, previousParticleCount, frame.remap, remappedQuantized);
+        }
+        const std::vector<int32_t>& base = remapped ? remappedQuantized : previousQuantized;
+        for (size_t i = 0; i < currentQuantized.size(); ++i) {
+            int64_t value = currentQuantized[i];
+            if (!keyframe) {
+                value -= base[i];
+            }
+            appendVarint(payload, value);
+        }
+        previousQuantized.swap(currentQuantized);
+    }
+    previousParticleCount = particleCount;
+    
+    uint32_t payloadBytes = static_cast<uint32_t>(payload.size() - ChunkHeaderBytes);
+    std::memcpy(payload.data() + 4, &payloadBytes, sizeof(payloadBytes));
+    file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    framesEncoded++;
+    
+    bytesWritten.fetch_add(payload.size());
+    rawBytes.fetch_add(ChunkHeaderBytes + FrameHeaderBytes + frame.objects.size() * ObjectBytes + particleCount * ParticleBytes);
+    lastFrameBytes.store(payload.size());
+}
+
+TrajectoryReader::TrajectoryReader()
+    : flags(0), positionPrecision(0.0f), velocityPrecision(0.0f), origin(0.0f), previousParticleCount(0) {
+}
+
+bool TrajectoryReader::open(const std::string& path) {
+    file.close();
+    file.clear();
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "TrajectoryReader: cannot open " << path << std::endl;
+        return false;
+    }
+    
+    std::vector<unsigned char> header(FileHeaderBytes);
+    file.read(reinterpret_cast<char*>(header.data()), header.size());
+    if (!file || std::memcmp(header.data(), TrajectoryMagic, sizeof(TrajectoryMagic)) != 0) {
+        std::cerr << "TrajectoryReader: " << path << " is not a trajectory file" << std::endl;
+        return false;
+    }
+    
+    size_t offset = sizeof(TrajectoryMagic);
+    uint32_t version = 0, keyframeInterval = 0;
+    readValue(header, offset, version);
+    readValue(header, offset, flags);
+    readValue(header, offset, positionPrecision);
+    readValue(header, offset, velocityPrecision);
+    readValue(header, offset, origin.x);
+    readValue(header, offset, origin.y);
+    readValue(header, offset, origin.z);
+    readValue(header, offset, keyframeInterval);
+    if (version != TrajectoryVersion) {
+        std::cerr << "TrajectoryReader: unsupported version " << version << " in " << path << std::endl;
+        return false;
+    }
+    previousQuantized.clear();
+    previousParticleCount = 0;
+    return true;
+}
+
+bool TrajectoryReader::readFrame(TrajectoryFrame& frame) {
+    while (true) {
+        uint32_t chunk[2];
+        if (!file.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+            return false;
+        }
+        payload.resize(chunk[1]);
+        if (!file.read(reinterpret_cast<char*>(payload.data()), payload.size())) {
+            return false;
+        }
+        // Skip chunk types this version does not know about
+        if (chunk[0] == FrameTag) {
+            break;
+        }
+    }
+    
+    size_t offset = 0;
+    uint32_t particleCount = 0, objectCount = 0;
+    uint8_t frameFlags = 0;
+    if (!readValue(payload, offset, frame.step) || !readValue(payload, offset, frame.time)
+        || !readValue(payload, offset, particleCount) || !readValue(payload, offset, objectCount)
+        || !readValue(payload, offset, frameFlags)) {
+        return false;
+    }
+    bool keyframe = (frameFlags & FrameKeyframe) != 0;
+    bool remapped = (frameFlags & FrameRemap) != 0;
+    
+    frame.objects.resize(objectCount);
+    for (auto& object : frame.objects) {
+        float values[10];
+        if (!readValue(payload, offset, values)) {
+            return false;
+        }
+        object.position = glm::vec3(values[0], values[1], values[2]);
+        object.rotation = glm::quat(values[3], values[4], values[5], values[6]);
+        object.scale = glm::vec3(values[7], values[8], values[9]);
+    }
+    
+    frame.remap.clear();
+    if (remapped) {
+        frame.remap.resize(particleCount);
+        for (uint32_t i = 0; i < particleCount; ++i) {
+            int64_t value = 0;
+            if (!readVarint(payload, offset, value)) {
+                return false;
+            }
+            int64_t source = value + i;
+            if (source < -1 || source >= int64_t(previousParticleCount)) {
+                return false;
+            }
+            frame.remap[i] = source < 0 ? SimulationSnapshot::NewParticle : static_cast<uint32_t>(source);
+        }
+    }
+    
+    frame.positions.resize(particleCount);
+    frame.velocities.resize(particleCount);
+    if (!isQuantized()) {
+        for (uint32_t i = 0; i < particleCount; ++i) {
+            if (!readValue(payload, offset, frame.positions[i]) || !readValue(payload, offset, frame.velocities[i])) {
+                return false;
+            }
+        }
+        previousParticleCount = particleCount;
+        return true;
+    }
+    
+    size_t valueCount = static_cast<size_t>(particleCount) * 6;
+    if (!keyframe && previousQuantized.size() != previousParticleCount * 6) {
+        return false;
+    }
+    if (!keyframe && remapped) {
+        remapChannels(previousQuantized, previousParticleCount, frame.remap, remappedQuantized);
+        previousQuantized.swap(remappedQuantized);
+    } else if (!keyframe && previousParticleCount != particleCount) {
+        return false;
+    }
+    previousQuantized.resize(valueCount);
+    for (size_t i = 0; i < valueCount; ++i) {
+        int64_t value = 0;
+        if (!readVarint(payload, offset, value)) {
+            return false;
+        }
+        previousQuantized[i] = static_cast<int32_t>(keyframe ? value : previousQuantized[i] + value);
+    }
+    for (uint32_t i = 0; i < particleCount; ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            frame.positions[i][axis] = origin[axis] + previousQuantized[axis * particleCount + i] * positionPrecision;
+            frame.velocities[i][axis] = previousQuantized[(3 + axis) * particleCount + i] * velocityPrecision;
+        }
+    }
+    previousParticleCount = particleCount;
+    return true;
+}
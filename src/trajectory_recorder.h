@@ -0,0 +1,138 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "simulation_snapshot.h"
+#include "spsc_queue.h"
+
+// Binary trajectory file layout (little endian):
+//
+//   Header: "SDFTRAJ1", u32 version, u32 flags (bit 0 = quantized, bit 1 = delta),
+//           f32 positionPrecision, f32 velocityPrecision, f32 origin[3], u32 keyframeInterval
+//   Chunk:  u32 tag ('FRME'), u32 payloadBytes, payload
+//   Frame payload:
+//           u64 step, f64 time, u32 particleCount, u32 objectCount, u8 flags (bit 0 = keyframe,
+//           bit 1 = remap)
+//           objects: objectCount x f32[10] (position, rotation wxyz, scale)
+//           remap (when flagged): particleCount zigzag varints, each the particle's index in
+//                                 the previous frame (-1 if new) minus its index in this one.
+//                                 Present when particles were killed, spawned or moved
+//                                 between slots since the previous frame.
+//           particles, raw:       particleCount x f32[6] (position, velocity)
+//           particles, quantized: six channels (px, py, pz, vx, vy, vz), each particleCount
+//                                 zigzag varints. Values are round((p - origin) / precision) and
+//                                 round(v / velocityPrecision), stored as differences from the
+//                                 previous frame unless the frame is a keyframe. With a remap,
+//                                 each particle's difference is from its own previous values,
+//                                 or from zero if it is new.
+
+struct TrajectoryOptions {
+    float positionPrecision = 0.0f;   // Quantization step for positions; 0 stores raw floats
+    float velocityPrecision = 0.0f;   // Quantization step for velocities; 0 uses positionPrecision
+    bool deltaEncoding = true;        // Store quantized channels relative to the previous frame
+    int keyframeInterval = 60;        // Frames between absolute (seekable) frames
+    size_t queueCapacity = 16;        // Frames buffered for the writer before recording drops
+};
+
+// Counters readable from any thread
+struct TrajectoryStats {
+    uint64_t framesRecorded = 0;
+    uint64_t framesDropped = 0;       // Queue full: the writer could not keep up
+    uint64_t bytesWritten = 0;
+    uint64_t rawBytes = 0;            // Size the same frames would take as raw floats
+    uint64_t lastFrameBytes = 0;
+};
+
+// One decoded frame
+struct TrajectoryFrame {
+    uint64_t step = 0;
+    double time = 0.0;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
+    std::vector<SimulationSnapshot::ObjectPose> objects;
+    // Index of each particle in the previous frame, or SimulationSnapshot::NewParticle.
+    // Empty when the particles kept their slots (or, when recording, if unknown).
+    std::vector<uint32_t> remap;
+};
+
+// Streams snapshots to a trajectory file. record() only copies the state into a recycled
+// frame and pushes it onto a lock-free queue; quantization, delta encoding and file I/O
+// happen on a background writer thread. When the queue is full the frame is dropped and
+// counted, so the calling (simulation) thread never blocks on disk.
+class TrajectoryRecorder {
+public:
+    TrajectoryRecorder();
+    ~TrajectoryRecorder();
+    
+    bool open(const std::string& path, const glm::vec3& origin, const TrajectoryOptions& options = TrajectoryOptions());
+    // Writes all queued frames and closes the file
+    void close();
+    bool isOpen() const { return active.load(); }
+    
+    // Producer side (one thread only)
+    void record(const SimulationSnapshot& snapshot);
+    
+    TrajectoryStats getStats() const;
+
+private:
+    std::ofstream file;
+    TrajectoryOptions options;
+    glm::vec3 origin;
+    std::atomic<bool> active;
+    std::atomic<bool> stopping;
+    std::thread writer;
+    
+    // Frames travel producer -> writer through 'pending' and come back through 'recycled'
+    SpscQueue<TrajectoryFrame> pending;
+    SpscQueue<TrajectoryFrame> recycled;
+    TrajectoryFrame staging;                 // Producer-side frame being filled
+    bool stagingDropped;                     // 'staging' holds a frame the queue rejected
+    std::vector<uint32_t> composedRemap;
+    
+    // Writer thread state
+    std::vector<int32_t> previousQuantized;  // Channel-major, for delta encoding
+    std::vector<int32_t> currentQuantized;
+    std::vector<int32_t> remappedQuantized;  // Previous values moved to the current slots
+    std::vector<unsigned char> payload;
+    uint64_t framesEncoded;
+    size_t previousParticleCount;
+    
+    std::atomic<uint64_t> framesRecorded;
+    std::atomic<uint64_t> framesDropped;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<uint64_t> rawBytes;
+    std::atomic<uint64_t> lastFrameBytes;
+    
+    void writerLoop();
+    void writeFrame(const TrajectoryFrame& frame);
+};
+
+// Sequential decoder for files written by TrajectoryRecorder
+class TrajectoryReader {
+public:
+    TrajectoryReader();
+    
+    bool open(const std::string& path);
+    // Decodes the next frame; returns false at end of file or on a malformed chunk
+    bool readFrame(TrajectoryFrame& frame);
+    
+    bool isQuantized() const { return (flags & 1) != 0; }
+    float getPositionPrecision() const { return positionPrecision; }
+
+private:
+    std::ifstream file;
+    uint32_t flags;
+    float positionPrecision;
+    float velocityPrecision;
+    glm::vec3 origin;
+    std::vector<unsigned char> payload;
+    std::vector<int32_t> previousQuantized;
+    std::vector<int32_t> remappedQuantized;
+    size_t previousParticleCount;
+};
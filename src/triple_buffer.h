@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free single-producer / single-consumer exchange of whole values.
+// The producer always owns one buffer, the consumer owns another, and the third
+// sits in the middle holding the most recently published value. Publishing and
+// acquiring are a single atomic exchange each, so neither side ever waits.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : writeIndex(0), middleIndex(1), readIndex(2) {}
+    
+    // Producer side: fill getWriteBuffer(), then publish() to make it the newest value
+    T& getWriteBuffer() { return buffers[writeIndex]; }
+    void publish() {
+        int previous = middleIndex.exchange(writeIndex | FreshBit, std::memory_order_acq_rel);
+        writeIndex = previous & IndexMask;
+    }
+    
+    // Consumer side: acquire() swaps in the newest published value if there is one.
+    // Returns true if getReadBuffer() changed.
+    bool acquire() {
+        if ((middleIndex.load(std::memory_order_acquire) & FreshBit) == 0) {
+            return false;
+        }
+        int previous = middleIndex.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & IndexMask;
+        return true;
+    }
+    const T& getReadBuffer() const { return buffers[readIndex]; }
+
+private:
+    static constexpr int IndexMask = 0x3;
+    static constexpr int FreshBit = 0x4;  // Middle buffer holds a value the consumer has not seen
+    
+    T buffers[3];
+    int writeIndex;                // Owned by the producer
+    std::atomic<int> middleIndex;  // Shared
+    int readIndex;                 // Owned by the consumer
+};